@@ -2,10 +2,11 @@
 #define ALL_ONES_BITVECTOR
 
 #include "Interfaces.hh"
+#include "model_container.hh"
 #include <stdexcept>
 #include <fstream>
 
-class All_Ones_Bitvector : public Bitvector{
+class All_Ones_Bitvector final : public Bitvector{
     
 private:
     
@@ -98,6 +99,15 @@ public:
         info >> description >> this->length;
     }
     
+    virtual void serialize(Model_Container_Writer& out, std::string name){
+        out.add_string(name + "_info", "all-ones " + to_string(this->length));
+    }
+    virtual void load(std::shared_ptr<Model_Container> in, std::string name){
+        stringstream info(in->get_string(name + "_info"));
+        string description;
+        info >> description >> this->length;
+    }
+    
     virtual std::string toString(){
         return "All ones";
     }
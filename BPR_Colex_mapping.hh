@@ -2,6 +2,7 @@
 #define BPR_COLEX_MAPPING
 
 #include "Interfaces.hh"
+#include "scoring_instrumentation.hh"
 
 
 class Full_Topology_Mapper : public Topology_Mapper{
@@ -65,18 +66,20 @@ public:
     
 };
 
-class Pruned_Topology_Mapper : public Topology_Mapper{
-// Also works if the topology is not pruned
+// Also works if the topology is not pruned.
+// bpr_t and pruning_t are the types of the bit vectors (see Parent_Support_Template)
+template<typename bpr_t, typename pruning_t>
+class Pruned_Topology_Mapper_Template : public Topology_Mapper{
     
 public:
     
     typedef int64_t node_t;
     
-    std::shared_ptr<Bitvector> rev_st_bpr;
-    std::shared_ptr<Bitvector> pruning_marks;
+    std::shared_ptr<bpr_t> rev_st_bpr;
+    std::shared_ptr<pruning_t> pruning_marks;
     
-    Pruned_Topology_Mapper() {}
-    Pruned_Topology_Mapper(std::shared_ptr<Bitvector> rev_st_bpr, std::shared_ptr<Bitvector> pruning_marks) :
+    Pruned_Topology_Mapper_Template() {}
+    Pruned_Topology_Mapper_Template(std::shared_ptr<bpr_t> rev_st_bpr, std::shared_ptr<pruning_t> pruning_marks) :
         rev_st_bpr(rev_st_bpr), pruning_marks(pruning_marks) {}
 
     
@@ -86,10 +89,15 @@ public:
         int64_t leftmost_1 = pruning_marks->rank(leaves.left+1); 
         int64_t leftmost_2 = pruning_marks->rank(leaves.right+1);
         
-        node_t leaf1 = rev_st_bpr->select_10(leftmost_1) - 1; // Select gives the closing paren, so -1 to get the open
-        node_t leaf2 = rev_st_bpr->select_10(leftmost_2) - 1; // Select gives the closing paren, so -1 to get the open
-        if(leaf1 == leaf2) return leaf1;
+        // Both ends in the same leaf: one select and no double_enclose. This is the common case
+        // while scoring, because the longest match usually occurs only a few times.
+        if(leftmost_1 == leftmost_2){
+            INSTRUMENT_SINGLE_LEAF();
+            return rev_st_bpr->select_10(leftmost_1) - 1; // Select gives the closing paren, so -1 to get the open
+        }
         
+        node_t leaf1 = rev_st_bpr->select_10(leftmost_1) - 1;
+        node_t leaf2 = rev_st_bpr->select_10(leftmost_2) - 1;
         return rev_st_bpr->double_enclose(leaf1, leaf2);
     }
     
@@ -124,4 +132,6 @@ public:
     
 };
 
+typedef Pruned_Topology_Mapper_Template<Bitvector, Bitvector> Pruned_Topology_Mapper;
+
 #endif
\ No newline at end of file
@@ -2,9 +2,24 @@
 #define BWT_ITERATION_HH
 
 #include "Interfaces.hh"
+#include <stack>
+#include <vector>
+#include <memory>
 
 // Iterators that give all nodes that should be included in the topology.
 
+// Thread-safe versions of BIBWT::is_left_maximal and BIBWT::is_right_maximal, which use scratch
+// space inside the index. Here the caller gives the scratch space.
+bool is_left_maximal(BIBWT* index, Interval_pair I, BIBWT::Interval_Data& scratch){
+    index->compute_bwt_interval_data(I.forward, scratch);
+    return scratch.n_distinct_symbols >= 2;
+}
+
+bool is_right_maximal(BIBWT* index, Interval_pair I, BIBWT::Interval_Data& scratch){
+    index->compute_rev_bwt_interval_data(I.reverse, scratch);
+    return scratch.n_distinct_symbols >= 2;
+}
+
 class Rev_ST_Iterator : public Iterator{
 
     public:
@@ -13,6 +28,7 @@ class Rev_ST_Iterator : public Iterator{
     Stack_frame top;
     BIBWT* index;
     typename BIBWT::Interval_Data interval_data;
+    typename BIBWT::Interval_Data maximality_data;
     
     Rev_ST_Iterator() {}
     Rev_ST_Iterator(BIBWT* index) : index(index) {}
@@ -26,16 +42,37 @@ class Rev_ST_Iterator : public Iterator{
     }
     
     virtual void init(){
+        // Start from the empty string 
+        init(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0,true)); // Suppose empty string is always a maxrep (special case)
+    }
+    
+    virtual void init(const Stack_frame& start){
         // Make space
         interval_data.symbols.resize(index->get_alphabet().size());
         interval_data.ranks_start.resize(index->get_alphabet().size());
         interval_data.ranks_end.resize(index->get_alphabet().size());
+        maximality_data.symbols.resize(index->get_alphabet().size());
+        maximality_data.ranks_start.resize(index->get_alphabet().size());
+        maximality_data.ranks_end.resize(index->get_alphabet().size());
         
         // Clear the stack
         while(!iteration_stack.empty()) iteration_stack.pop();
         
-        // Push the empty string 
-        iteration_stack.push(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0,true)); // Suppose empty string is always a maxrep (special case)
+        iteration_stack.push(start);
+    }
+    
+    virtual std::vector<Stack_frame> get_pending(){
+        std::vector<Stack_frame> pending;
+        std::stack<Stack_frame> copy = iteration_stack;
+        while(!copy.empty()){
+            pending.push_back(copy.top());
+            copy.pop();
+        }
+        return pending;
+    }
+    
+    virtual std::shared_ptr<Iterator> new_copy(){
+        return std::make_shared<Rev_ST_Iterator>(index);
     }
     
     virtual bool next(){
@@ -58,8 +95,8 @@ class Rev_ST_Iterator : public Iterator{
          // stack the last, so the iteration is done in lexicographic order
          for(int64_t i = interval_data.n_distinct_symbols-1; i >= 0; i--){
             Interval_pair I2 = index->right_extend(top.intervals,interval_data,i);
-            if(I2.forward.size() != 0 && index->is_left_maximal(I2)){
-                iteration_stack.push(Stack_frame(I2, top.depth+1, index->is_right_maximal(I2)));
+            if(I2.forward.size() != 0 && is_left_maximal(index, I2, maximality_data)){
+                iteration_stack.push(Stack_frame(I2, top.depth+1, is_right_maximal(index, I2, maximality_data)));
             }
         }
         
@@ -85,6 +122,7 @@ public:
     std::stack<Stack_frame> iteration_stack;
     Stack_frame top;
     typename BIBWT::Interval_Data interval_data;
+    typename BIBWT::Interval_Data maximality_data;
     BIBWT* index;
     int64_t depth_bound;
     string label; // debug
@@ -101,6 +139,11 @@ public:
     }
         
     virtual void init(){
+        // Start from the empty string (suppose it is a maxrep (holds as long as the text is not an empty string?)
+        init(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0, true));
+    }
+    
+    virtual void init(const Stack_frame& start){
         
         label = ""; // debug
         
@@ -108,12 +151,28 @@ public:
         interval_data.symbols.resize(index->get_alphabet().size());
         interval_data.ranks_start.resize(index->get_alphabet().size());
         interval_data.ranks_end.resize(index->get_alphabet().size());
+        maximality_data.symbols.resize(index->get_alphabet().size());
+        maximality_data.ranks_start.resize(index->get_alphabet().size());
+        maximality_data.ranks_end.resize(index->get_alphabet().size());
         
         // Clear the stack
         while(!iteration_stack.empty()) iteration_stack.pop();
         
-        // Push the empty string (suppose it is a maxrep (holds as long as the text is not an empty string?)
-        iteration_stack.push(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0, true));
+        iteration_stack.push(start);
+    }
+    
+    virtual std::vector<Stack_frame> get_pending(){
+        std::vector<Stack_frame> pending;
+        std::stack<Stack_frame> copy = iteration_stack;
+        while(!copy.empty()){
+            pending.push_back(copy.top());
+            copy.pop();
+        }
+        return pending;
+    }
+    
+    virtual std::shared_ptr<Iterator> new_copy(){
+        return std::make_shared<Depth_Bounded_SLT_Iterator>(index, depth_bound);
     }
     
     virtual bool next(){
@@ -132,8 +191,8 @@ public:
             // stack the last, so the iteration is done in lexicographic DFS order
             for(int64_t i = interval_data.n_distinct_symbols-1; i >= 0; i--){
                 Interval_pair I2 = index->left_extend(top.intervals,interval_data,i);
-                if(I2.forward.size() != 0 && index->is_right_maximal(I2)){
-                    iteration_stack.push(Stack_frame(I2, top.depth+1, index->is_left_maximal(I2)));
+                if(I2.forward.size() != 0 && is_right_maximal(index, I2, maximality_data)){
+                    iteration_stack.push(Stack_frame(I2, top.depth+1, is_left_maximal(index, I2, maximality_data)));
                 }
             }
          }
@@ -161,6 +220,7 @@ class Rev_ST_Depth_Bounded_Maxrep_Iterator : public Iterator{
     Stack_frame top;
     BIBWT* index;
     typename BIBWT::Interval_Data interval_data;
+    typename BIBWT::Interval_Data maximality_data;
     int64_t depth_bound;
     
     Rev_ST_Depth_Bounded_Maxrep_Iterator(int64_t depth_bound) : depth_bound(depth_bound) {}
@@ -175,16 +235,31 @@ class Rev_ST_Depth_Bounded_Maxrep_Iterator : public Iterator{
     }
 
     virtual void init(){
+        // Start from the empty string (suppose it is a maxrep)
+        init(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0, true));
+    }
+    
+    virtual void init(const Stack_frame& start){
         // Make space
         interval_data.symbols.resize(index->get_alphabet().size());
         interval_data.ranks_start.resize(index->get_alphabet().size());
         interval_data.ranks_end.resize(index->get_alphabet().size());
+        maximality_data.symbols.resize(index->get_alphabet().size());
+        maximality_data.ranks_start.resize(index->get_alphabet().size());
+        maximality_data.ranks_end.resize(index->get_alphabet().size());
         
         // Clear the stack
         while(!iteration_stack.empty()) iteration_stack.pop_back();
         
-        // Push the empty string (suppose it is a maxrep)
-        iteration_stack.push_back(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0, true));
+        iteration_stack.push_back(start);
+    }
+    
+    virtual std::vector<Stack_frame> get_pending(){
+        return std::vector<Stack_frame>(iteration_stack.rbegin(), iteration_stack.rend());
+    }
+    
+    virtual std::shared_ptr<Iterator> new_copy(){
+        return std::make_shared<Rev_ST_Depth_Bounded_Maxrep_Iterator>(index, depth_bound);
     }
     
     bool next(){
@@ -198,7 +273,7 @@ class Rev_ST_Depth_Bounded_Maxrep_Iterator : public Iterator{
          index->compute_bwt_interval_data(top.intervals.forward, interval_data);
          
          bool leftmax = interval_data.n_distinct_symbols >= 2;
-         bool rightmax = index->is_right_maximal(top.intervals);
+         bool rightmax = is_right_maximal(index, top.intervals, maximality_data);
          top.is_maxrep = leftmax && rightmax;
         
         if(!rightmax){
@@ -245,5 +320,96 @@ class Rev_ST_Maxrep_Iterator : public Rev_ST_Depth_Bounded_Maxrep_Iterator{
 };
 
 
+// Gives the nodes of both Depth_Bounded_SLT_Iterator and Rev_ST_Depth_Bounded_Maxrep_Iterator
+// with the same depth bound in a single traversal. The nodes of the SLT are given in the same
+// order as by Depth_Bounded_SLT_Iterator, and the flags in_slt and in_rev_st of the stack frames
+// tell which of the two iterators would give the node.
+class Fused_Maxrep_Iterator : public Iterator{
+
+    private:
+    std::vector<Stack_frame> iteration_stack;
+    
+    public:
+    
+    Stack_frame top;
+    BIBWT* index;
+    typename BIBWT::Interval_Data interval_data;
+    typename BIBWT::Interval_Data maximality_data;
+    int64_t depth_bound;
+    
+    Fused_Maxrep_Iterator(int64_t depth_bound) : depth_bound(depth_bound) {}
+    Fused_Maxrep_Iterator(BIBWT* index, int64_t depth_bound) : index(index), depth_bound(depth_bound) {}
+    
+    virtual void set_index(BIBWT* index){
+        this->index = index;
+    }
+    
+    virtual Iterator::Stack_frame get_top(){
+        return top;
+    }
+
+    virtual void init(){
+        // Start from the empty string (suppose it is a maxrep)
+        init(Stack_frame(Interval_pair(0,index->size()-1,0,index->size()-1),0, true));
+    }
+    
+    virtual void init(const Stack_frame& start){
+        // Make space
+        interval_data.symbols.resize(index->get_alphabet().size());
+        interval_data.ranks_start.resize(index->get_alphabet().size());
+        interval_data.ranks_end.resize(index->get_alphabet().size());
+        maximality_data.symbols.resize(index->get_alphabet().size());
+        maximality_data.ranks_start.resize(index->get_alphabet().size());
+        maximality_data.ranks_end.resize(index->get_alphabet().size());
+        
+        iteration_stack.clear();
+        iteration_stack.push_back(start);
+    }
+    
+    virtual std::vector<Stack_frame> get_pending(){
+        return std::vector<Stack_frame>(iteration_stack.rbegin(), iteration_stack.rend());
+    }
+    
+    virtual std::shared_ptr<Iterator> new_copy(){
+        return std::make_shared<Fused_Maxrep_Iterator>(index, depth_bound);
+    }
+    
+    bool next(){
+        if(iteration_stack.empty()) return false;
+        
+        top = iteration_stack.back();
+        iteration_stack.pop_back();
+        
+        if(!top.in_slt){
+            // Not right-maximal: a leaf of the rev st topology
+            top.is_maxrep = false;
+            return true;
+        }
+        
+        index->compute_bwt_interval_data(top.intervals.forward, interval_data);
+        bool leftmax = interval_data.n_distinct_symbols >= 2;
+        top.is_maxrep = leftmax;
+        
+        // A right-maximal node that is not left-maximal is in the rev st topology only if the
+        // depth bound stops the traversal before its left-saturation
+        top.in_rev_st = leftmax || top.depth == depth_bound;
+        
+        if(top.depth <= depth_bound - 1){
+            // Iterate alphabet in reverse lexicographic order, so the smallest is pushed to the
+            // stack the last, so the iteration is done in lexicographic DFS order
+            for(int64_t i = interval_data.n_distinct_symbols-1; i >= 0; i--){
+                Interval_pair I2 = index->left_extend(top.intervals, interval_data, i);
+                if(I2.forward.size() != 0){
+                    Stack_frame F(I2, top.depth+1, false); // is_maxrep will be computed when the frame is popped
+                    F.in_slt = is_right_maximal(index, I2, maximality_data);
+                    iteration_stack.push_back(F);
+                }
+            }
+        }
+        
+        return true;
+    }
+};
+
 #endif
 
@@ -3,9 +3,23 @@
 
 #include "sdsl/bit_vectors.hpp"
 #include "Interfaces.hh"
+#include "model_container.hh"
 
 // Wrapper for sdsl
-class Basic_bitvector : public Bitvector{
+class Basic_bitvector final : public Bitvector{
+    
+private:
+    
+    Basic_bitvector(const Basic_bitvector&); // Prevent copy-construction. bv may point into a memory mapping.
+    Basic_bitvector& operator=(const Basic_bitvector&);  // Prevent assignment
+    
+    std::shared_ptr<Model_Container> mapped_from; // Non-null if bv points into the mapping of this container
+    
+    std::string info_string(){
+        stringstream info;
+        info << "basic " << have_bps << " " << have_ss_10 << " " << have_rs_10 << " " << have_rs << " " << have_ss;
+        return info.str();
+    }
     
 public:
      
@@ -25,6 +39,10 @@ public:
     Basic_bitvector() : have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(false), have_ss(false) {}
     Basic_bitvector(sdsl::bit_vector bv) : bv(bv), have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(false), have_ss(false) {}
     
+    virtual ~Basic_bitvector(){
+        if(mapped_from != nullptr) Model_Container::release_int_vector(bv);
+    }
+    
     virtual int64_t size(){
         return bv.size();
     }
@@ -54,7 +72,7 @@ public:
         if(have_ss) store_check_error(ss, path + "_ss");
         
         ofstream info(path + "_info");
-        info << "basic " << have_bps << " " << have_ss_10 << " " << have_rs_10 << " " << have_rs << " " << have_ss << endl;
+        info << info_string() << endl;
         if(!info.good()){
             cerr << "Error writing to disk: " << path + "_info" << endl;
             exit(-1);
@@ -103,6 +121,35 @@ public:
         
     }
     
+    virtual void serialize(Model_Container_Writer& out, string name){
+        out.add_int_vector(name + "_bv", bv);
+        
+        if(have_bps) out.add_serializable(name + "_bps", bps);
+        if(have_ss_10) out.add_serializable(name + "_ss_10", ss_10);
+        if(have_rs_10) out.add_serializable(name + "_rs_10", rs_10);
+        if(have_rs) out.add_serializable(name + "_rs", rs);
+        if(have_ss) out.add_serializable(name + "_ss", ss);
+        
+        out.add_string(name + "_info", info_string());
+    }
+    
+    // The bit vector itself is not copied: it is used in place from the mapping. The supports are copied.
+    virtual void load(std::shared_ptr<Model_Container> in, string name){
+        if(mapped_from != nullptr) Model_Container::release_int_vector(bv);
+        in->view_int_vector(name + "_bv", bv);
+        mapped_from = in;
+        
+        string type;
+        stringstream info(in->get_string(name + "_info"));
+        info >> type >> have_bps >> have_ss_10 >> have_rs_10 >> have_rs >> have_ss;
+        
+        if(have_bps) in->load_support(name + "_bps", bps, &bv);
+        if(have_ss_10) in->load_support(name + "_ss_10", ss_10, &bv);
+        if(have_rs_10) in->load_support(name + "_rs_10", rs_10, &bv);
+        if(have_rs) in->load_support(name + "_rs", rs, &bv);
+        if(have_ss) in->load_support(name + "_ss", ss, &bv);
+    }
+    
     virtual int64_t rank(int64_t pos){
         assert(have_rs);
         return rs.rank(pos);
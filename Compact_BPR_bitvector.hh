@@ -0,0 +1,475 @@
+#ifndef COMPACT_BPR_BITVECTOR_HH
+#define COMPACT_BPR_BITVECTOR_HH
+
+#include "Interfaces.hh"
+#include "model_container.hh"
+#include "sdsl/int_vector.hpp"
+#include "sdsl/bits.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+// Excess changes over the bytes of a balanced parentheses sequence. Bit j of byte x is the
+// parenthesis at offset j. delta[x] is the change over the whole byte and min_prefix[x] the
+// smallest change over a prefix of 1 to 8 parentheses.
+struct BPR_Byte_Tables{
+    int8_t delta[256];
+    int8_t min_prefix[256];
+    BPR_Byte_Tables(){
+        for(int64_t x = 0; x < 256; x++){
+            int64_t e = 0, m = 8;
+            for(int64_t j = 0; j < 8; j++){
+                e += ((x >> j) & 1) ? 1 : -1;
+                m = std::min(m, e);
+            }
+            delta[x] = e;
+            min_prefix[x] = m;
+        }
+    }
+};
+
+inline const BPR_Byte_Tables& get_bpr_byte_tables(){
+    static BPR_Byte_Tables tables;
+    return tables;
+}
+
+// A balanced parentheses sequence with all the operations of Bitvector in less space than
+// Basic_bitvector with bp_support_g and the rank 10 and select 10 supports. The parentheses are
+// stored as they are. For each block of 512 parentheses we store the number of opens and the
+// number of patterns 10 before the block, and a range min-max tree (only the min is needed) over
+// the smallest excess in each block. Queries scan at most two blocks a byte at a time, and walk
+// the tree between them. Select and select 10 binary search the block counts.
+//
+// excess(i) is the number of opens minus the number of closes in [0,i], as in sdsl::bp_support_g.
+class Compact_BPR_bitvector final : public Bitvector{
+
+private:
+
+    Compact_BPR_bitvector(const Compact_BPR_bitvector&); // Prevent copy-construction. The vectors may point into a memory mapping.
+    Compact_BPR_bitvector& operator=(const Compact_BPR_bitvector&); // Prevent assignment
+
+    static const int64_t block_size = 512;
+    static const int64_t words_per_block = block_size / 64;
+
+    std::shared_ptr<Model_Container> mapped_from; // Non-null if the vectors point into the mapping of this container
+
+    std::string info_string(){
+        stringstream info;
+        info << "compact_bpr " << have_bps << " " << have_ss_10 << " " << have_rs_10 << " " << have_rs << " " << have_ss;
+        return info.str();
+    }
+
+    void release(){
+        if(mapped_from == nullptr) return;
+        Model_Container::release_int_vector(bv);
+        Model_Container::release_int_vector(opens_before);
+        Model_Container::release_int_vector(tens_before);
+        Model_Container::release_int_vector(tree);
+        mapped_from = nullptr;
+    }
+
+    int64_t n_blocks(){
+        return opens_before.size() - 1;
+    }
+
+    int64_t n_leaves(){
+        return tree.size() / 2;
+    }
+
+    int64_t block_end(int64_t b){
+        return std::min(size(), (b + 1) * block_size);
+    }
+
+    // excess(b * block_size - 1)
+    int64_t excess_before_block(int64_t b){
+        return 2 * (int64_t)opens_before[b] - b * block_size;
+    }
+
+    uint64_t word(int64_t i){
+        return bv.data()[i];
+    }
+
+    uint8_t byte(int64_t pos){ // The byte that starts at position pos, which is a multiple of 8
+        return (word(pos / 64) >> (pos % 64)) & 0xFF;
+    }
+
+    // Ones at the positions of the zeros of the patterns 10 in word i. carry is the last bit of word i-1.
+    static uint64_t tens_in_word(uint64_t w, uint64_t carry){
+        return ~w & ((w << 1) | carry);
+    }
+
+    uint64_t carry_into_word(int64_t i){
+        return i == 0 ? 0 : word(i-1) >> 63;
+    }
+
+    // The first j in [from,to) with excess(j) <= d, or to if there is none. e is excess(from-1).
+    int64_t scan_forward(int64_t from, int64_t to, int64_t e, int64_t d){
+        const BPR_Byte_Tables& T = get_bpr_byte_tables();
+        int64_t j = from;
+        for(; j < to && j % 8 != 0; j++){
+            e += bv[j] ? 1 : -1;
+            if(e <= d) return j;
+        }
+        for(; j + 8 <= to; j += 8){
+            uint8_t x = byte(j);
+            if(e + T.min_prefix[x] <= d) break;
+            e += T.delta[x];
+        }
+        for(; j < to; j++){
+            e += bv[j] ? 1 : -1;
+            if(e <= d) return j;
+        }
+        return to;
+    }
+
+    // The last q in [from,to) with excess(q) <= d, or from-1 if there is none. e is excess(to-1).
+    int64_t scan_backward(int64_t from, int64_t to, int64_t e, int64_t d){
+        const BPR_Byte_Tables& T = get_bpr_byte_tables();
+        int64_t q = to - 1;
+        for(; q >= from && (q + 1) % 8 != 0; q--){
+            if(e <= d) return q;
+            e -= bv[q] ? 1 : -1;
+        }
+        for(; q - 7 >= from; q -= 8){
+            uint8_t x = byte(q - 7);
+            int64_t e_before = e - T.delta[x]; // excess(q-8)
+            if(e_before + T.min_prefix[x] <= d) break;
+            e = e_before;
+        }
+        for(; q >= from; q--){
+            if(e <= d) return q;
+            e -= bv[q] ? 1 : -1;
+        }
+        return from - 1;
+    }
+
+    // The smallest excess in [from,to), which is not empty. e is excess(from-1).
+    int64_t scan_min(int64_t from, int64_t to, int64_t e){
+        const BPR_Byte_Tables& T = get_bpr_byte_tables();
+        int64_t result = size();
+        int64_t j = from;
+        for(; j < to && j % 8 != 0; j++){
+            e += bv[j] ? 1 : -1;
+            result = std::min(result, e);
+        }
+        for(; j + 8 <= to; j += 8){
+            uint8_t x = byte(j);
+            result = std::min(result, e + T.min_prefix[x]);
+            e += T.delta[x];
+        }
+        for(; j < to; j++){
+            e += bv[j] ? 1 : -1;
+            result = std::min(result, e);
+        }
+        return result;
+    }
+
+    // Tree node v has children 2v and 2v+1. Leaf b is at n_leaves() + b and holds the smallest
+    // excess in block b. The padding leaves hold size().
+
+    // The first block after b with a minimum at most d, or n_blocks() if there is none
+    int64_t next_block_at_most(int64_t b, int64_t d){
+        int64_t v = n_leaves() + b;
+        while(true){
+            if(v == 1) return n_blocks();
+            if(v % 2 == 0 && (int64_t)tree[v+1] <= d){ v++; break; }
+            v /= 2;
+        }
+        while(v < n_leaves()) v = (int64_t)tree[2*v] <= d ? 2*v : 2*v+1;
+        return v - n_leaves();
+    }
+
+    // The last block before b with a minimum at most d, or -1 if there is none
+    int64_t previous_block_at_most(int64_t b, int64_t d){
+        int64_t v = n_leaves() + b;
+        while(true){
+            if(v == 1) return -1;
+            if(v % 2 == 1 && (int64_t)tree[v-1] <= d){ v--; break; }
+            v /= 2;
+        }
+        while(v < n_leaves()) v = (int64_t)tree[2*v+1] <= d ? 2*v+1 : 2*v;
+        return v - n_leaves();
+    }
+
+    // The smallest excess in blocks [l,r], or size() if the range is empty
+    int64_t min_of_blocks(int64_t l, int64_t r){
+        int64_t result = size();
+        for(int64_t a = n_leaves() + l, b = n_leaves() + r; a <= b; a /= 2, b /= 2){
+            if(a % 2 == 1) result = std::min(result, (int64_t)tree[a++]);
+            if(b % 2 == 0) result = std::min(result, (int64_t)tree[b--]);
+        }
+        return result;
+    }
+
+    // The first j > i with excess(j) = d. Requires excess(i) > d.
+    int64_t fwd_search(int64_t i, int64_t d){
+        int64_t b = i / block_size;
+        int64_t j = scan_forward(i+1, block_end(b), excess(i), d);
+        if(j < block_end(b)) return j;
+        b = next_block_at_most(b, d);
+        if(b == n_blocks()) return size();
+        return scan_forward(b * block_size, block_end(b), excess_before_block(b), d);
+    }
+
+    // The last q < i with excess(q) = d, where excess(-1) = 0. Requires excess(i-1) >= d >= 0.
+    int64_t bwd_search(int64_t i, int64_t d){
+        int64_t b = (i-1) / block_size;
+        int64_t q = scan_backward(b * block_size, i, excess(i-1), d);
+        if(q >= b * block_size) return q;
+        b = previous_block_at_most(b, d);
+        if(b == -1) return -1;
+        return scan_backward(b * block_size, block_end(b), 2 * (int64_t)opens_before[b+1] - block_end(b), d);
+    }
+
+    // The smallest excess in [i,j], where i <= j
+    int64_t range_min(int64_t i, int64_t j){
+        int64_t bi = i / block_size, bj = j / block_size;
+        int64_t e = 2 * rank(i) - i; // excess(i-1)
+        if(bi == bj) return scan_min(i, j+1, e);
+        int64_t result = scan_min(i, (bi + 1) * block_size, e);
+        result = std::min(result, min_of_blocks(bi + 1, bj - 1));
+        return std::min(result, scan_min(bj * block_size, j+1, excess_before_block(bj)));
+    }
+
+public:
+
+    sdsl::bit_vector bv;
+    sdsl::int_vector<0> opens_before; // Opens before each block, and the total at the end
+    sdsl::int_vector<0> tens_before; // Patterns 10 with the zero before each block, and the total at the end
+    sdsl::int_vector<0> tree; // Range min tree over the blocks
+
+    bool have_bps;
+    bool have_ss_10;
+    bool have_rs_10;
+    bool have_rs;
+    bool have_ss;
+
+    Compact_BPR_bitvector() : have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(false), have_ss(false) {}
+
+    // B must be a balanced parentheses sequence
+    Compact_BPR_bitvector(const sdsl::bit_vector& B) : bv(B), have_bps(true), have_ss_10(true), have_rs_10(true), have_rs(true), have_ss(true) {
+        int64_t n = bv.size();
+        int64_t blocks = (n + block_size - 1) / block_size;
+        uint8_t width = sdsl::bits::hi(n + 1) + 1;
+        opens_before = sdsl::int_vector<0>(blocks + 1, 0, width);
+        tens_before = sdsl::int_vector<0>(blocks + 1, 0, width);
+        int64_t leaves = 1;
+        while(leaves < blocks) leaves *= 2;
+        tree = sdsl::int_vector<0>(2 * leaves, n, width);
+
+        int64_t opens = 0, tens = 0;
+        for(int64_t b = 0; b < blocks; b++){
+            opens_before[b] = opens;
+            tens_before[b] = tens;
+            tree[leaves + b] = scan_min(b * block_size, block_end(b), 2 * opens - b * block_size);
+            for(int64_t i = b * words_per_block; i < std::min((n + 63) / 64, (b + 1) * words_per_block); i++){
+                opens += __builtin_popcountll(word(i)); // sdsl keeps the bits past the end zero
+                tens += __builtin_popcountll(tens_in_word(word(i), carry_into_word(i)));
+            }
+        }
+        if(n % 64 != 0 && bv[n-1] == 1) tens--; // The pattern 10 with the zero past the end
+        opens_before[blocks] = opens;
+        tens_before[blocks] = tens;
+        for(int64_t v = leaves - 1; v >= 1; v--)
+            tree[v] = std::min(tree[2*v], tree[2*v+1]);
+    }
+
+    virtual ~Compact_BPR_bitvector(){
+        release();
+    }
+
+    virtual int64_t size(){
+        return bv.size();
+    }
+
+    virtual bool operator[](int64_t i){
+        return bv[i];
+    }
+
+    virtual bool at(int64_t i){
+        return bv[i];
+    }
+
+    template<typename T>
+    void store_check_error(T& data, string path){
+        if(!sdsl::store_to_file(data, path)){
+            throw std::runtime_error("Error writing to disk: " + path);
+        }
+    }
+
+    template<typename T>
+    void load_check_error(T& data, string path){
+        if(!sdsl::load_from_file(data, path)){
+            throw std::runtime_error("Error reading from disk: " + path);
+        }
+    }
+
+    virtual void serialize(string path){
+        store_check_error(bv, path + "_bv");
+        store_check_error(opens_before, path + "_opens_before");
+        store_check_error(tens_before, path + "_tens_before");
+        store_check_error(tree, path + "_rmm");
+
+        ofstream info(path + "_info");
+        info << info_string() << endl;
+        if(!info.good()){
+            cerr << "Error writing to disk: " << path + "_info" << endl;
+            exit(-1);
+        }
+    }
+
+    virtual void load(string path){
+        release();
+        load_check_error(bv, path + "_bv");
+        load_check_error(opens_before, path + "_opens_before");
+        load_check_error(tens_before, path + "_tens_before");
+        load_check_error(tree, path + "_rmm");
+
+        ifstream info;
+        info.exceptions(ifstream::failbit | ifstream::badbit);
+        try{
+            string type;
+            info.open(path + "_info");
+            info >> type >> have_bps >> have_ss_10 >> have_rs_10 >> have_rs >> have_ss;
+            info.close();
+        }  catch(const ifstream::failure& e) {
+            cerr << "Error loading data structure from disk: " << path + "_info" << endl;
+            exit(-1);
+        }
+    }
+
+    virtual void serialize(Model_Container_Writer& out, string name){
+        out.add_int_vector(name + "_bv", bv);
+        out.add_int_vector(name + "_opens_before", opens_before);
+        out.add_int_vector(name + "_tens_before", tens_before);
+        out.add_int_vector(name + "_rmm", tree);
+        out.add_string(name + "_info", info_string());
+    }
+
+    // Nothing is copied: all the vectors are used in place from the mapping
+    virtual void load(std::shared_ptr<Model_Container> in, string name){
+        release();
+        in->view_int_vector(name + "_bv", bv);
+        in->view_int_vector(name + "_opens_before", opens_before);
+        in->view_int_vector(name + "_tens_before", tens_before);
+        in->view_int_vector(name + "_rmm", tree);
+        mapped_from = in;
+
+        string type;
+        stringstream info(in->get_string(name + "_info"));
+        info >> type >> have_bps >> have_ss_10 >> have_rs_10 >> have_rs >> have_ss;
+    }
+
+    virtual int64_t rank(int64_t pos){
+        assert(have_rs);
+        int64_t b = pos / block_size;
+        int64_t result = opens_before[b];
+        for(int64_t i = b * words_per_block; i < pos / 64; i++) result += __builtin_popcountll(word(i));
+        if(pos % 64 != 0) result += __builtin_popcountll(word(pos / 64) & ((((uint64_t)1) << (pos % 64)) - 1));
+        return result;
+    }
+
+    // Number of patterns 10 with the zero in [0,pos)
+    virtual int64_t rank_10(int64_t pos){
+        assert(have_rs_10);
+        int64_t b = pos / block_size;
+        int64_t result = tens_before[b];
+        for(int64_t i = b * words_per_block; i < pos / 64; i++)
+            result += __builtin_popcountll(tens_in_word(word(i), carry_into_word(i)));
+        if(pos % 64 != 0){
+            uint64_t tens = tens_in_word(word(pos / 64), carry_into_word(pos / 64));
+            result += __builtin_popcountll(tens & ((((uint64_t)1) << (pos % 64)) - 1));
+        }
+        return result;
+    }
+
+    virtual int64_t select(int64_t rank){
+        assert(have_ss);
+        // The last block with fewer than rank opens before it
+        int64_t b = std::upper_bound(opens_before.begin(), opens_before.end() - 1, rank - 1) - opens_before.begin() - 1;
+        rank -= opens_before[b];
+        for(int64_t i = b * words_per_block; ; i++){
+            int64_t ones = __builtin_popcountll(word(i));
+            if(rank <= ones) return i * 64 + sdsl::bits::sel(word(i), rank);
+            rank -= ones;
+        }
+    }
+
+    // Position of the zero of the pos-th pattern 10
+    virtual int64_t select_10(int64_t pos){
+        assert(have_ss_10);
+        int64_t b = std::upper_bound(tens_before.begin(), tens_before.end() - 1, pos - 1) - tens_before.begin() - 1;
+        pos -= tens_before[b];
+        for(int64_t i = b * words_per_block; ; i++){
+            uint64_t tens = tens_in_word(word(i), carry_into_word(i));
+            int64_t count = __builtin_popcountll(tens);
+            if(pos <= count) return i * 64 + sdsl::bits::sel(tens, pos);
+            pos -= count;
+        }
+    }
+
+    virtual int64_t find_close(int64_t open){
+        assert(have_bps);
+        if(!at(open)) return open;
+        return fwd_search(open, excess(open) - 1);
+    }
+
+    virtual int64_t find_open(int64_t close){
+        assert(have_bps);
+        if(at(close)) return close;
+        return bwd_search(close, excess(close)) + 1;
+    }
+
+    virtual int64_t enclose(int64_t open){
+        assert(have_bps);
+        if(!at(open)) return find_open(open);
+        int64_t e = excess(open);
+        if(e == 1) return size();
+        return bwd_search(open, e - 2) + 1;
+    }
+
+    // The tightest pair that encloses both open1 and open2, where open1 < open2 and the pair
+    // of open1 closes before open2. The excess at its open is the smallest excess in [open1,open2].
+    virtual int64_t double_enclose(int64_t open1, int64_t open2){
+        assert(have_bps);
+        int64_t d = range_min(open1, open2);
+        if(d == 0) return size();
+        return bwd_search(open1, d - 1) + 1;
+    }
+
+    virtual int64_t excess(int64_t pos){
+        assert(have_bps);
+        return 2 * rank(pos+1) - pos - 1;
+    }
+
+    virtual void init_rank_support(){
+        // Already have
+    }
+
+    virtual void init_select_support(){
+        // Already have
+    }
+
+    virtual void init_rank_10_support(){
+        // Already have
+    }
+
+    virtual void init_select_10_support(){
+        // Already have
+    }
+
+    virtual void init_bps_support(){
+        // Already have
+    }
+
+    virtual std::string toString(){
+        stringstream ss;
+        ss << bv;
+        return ss.str();
+    }
+
+    int64_t size_in_bytes(){
+        return sdsl::size_in_bytes(bv) + sdsl::size_in_bytes(opens_before) + sdsl::size_in_bytes(tens_before) + sdsl::size_in_bytes(tree);
+    }
+};
+
+#endif
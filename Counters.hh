@@ -3,7 +3,7 @@
 #include "Interfaces.hh"
 #include "logging.hh"
 
-class Basic_Counters : public Counters {
+class Basic_Counters final : public Counters {
     
 public:
     
@@ -30,6 +30,10 @@ public:
         v_close[pos]++;
     }
     
+    pair<int64_t,int64_t> get_openclose(int64_t pos){
+        return {v_open[pos], v_close[pos]};
+    }
+    
     virtual int64_t get_open(int64_t pos){
         return v_open[pos];
     }
@@ -49,7 +53,7 @@ public:
     }
 };
 
-class Succinct_Counters : public Counters {
+class Succinct_Counters final : public Counters {
     
 public:
     
@@ -61,11 +65,13 @@ public:
     
     sdsl::int_vector<LEVEL_1_SIZE> v1; // Level 1
     unordered_map<int64_t, int64_t> v2; // Level 2  
+    pair<int64_t, int64_t> decoded[SATURATED]; // Decoded level 1 codewords, to avoid the branches of decode in get_openclose
     
     virtual void init(int64_t size){
         v1.resize(size);
         for(int64_t i = 0; i < v1.size(); i++) v1[i] = 0;
         v2.clear();
+        for(int64_t x = 0; x < SATURATED; x++) decoded[x] = decode(x);
     }    
     
     // (0,x) = 0 + 4x for x >= 0
@@ -126,7 +132,8 @@ public:
     }
     
     pair<int64_t,int64_t> get_openclose(int64_t pos){
-        if(v1[pos] != SATURATED) return decode(v1[pos]);
+        int64_t x = v1[pos];
+        if(x != SATURATED) return decoded[x];
         else return decode(v2[pos]);
     }
     
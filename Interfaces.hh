@@ -5,6 +5,11 @@
 #include <string>
 #include "BD_BWT_index/include/Interval.hh"
 #include <iostream>
+#include <memory>
+#include <vector>
+
+class Model_Container;
+class Model_Container_Writer;
 
 // Abstract base classes (play the role of function pointers, but because they are classes, then can have internal state)
 
@@ -13,6 +18,8 @@ public:
     virtual int64_t rev_st_string_depth(int64_t node) = 0;
     virtual int64_t rev_st_parent(int64_t node) = 0;
     virtual int64_t rev_st_lma(int64_t node) = 0;
+    virtual bool rev_st_is_maxrep(int64_t node) = 0;
+    virtual int64_t rev_st_context_rank(int64_t node) = 0; // Rank of a context among all contexts in preorder
     
     // Mapping between colex intervals and topology nodes
     virtual int64_t leaves_to_node(Interval I) = 0;    
@@ -57,6 +64,11 @@ public:
     // Loads the bit vector at 'path' based on the info file written by serialize.
     virtual void load(std::string path) = 0;
     
+    // The same for a single-file model. The entries are name + "_info" and name + suffixes.
+    // The loaded bit vector may point into the memory mapping of the container.
+    virtual void serialize(Model_Container_Writer& out, std::string name) = 0;
+    virtual void load(std::shared_ptr<Model_Container> in, std::string name) = 0;
+    
     virtual std::string toString() = 0;
     
     virtual ~Bitvector() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
@@ -92,11 +104,16 @@ public:
     //virtual void compute_interval_data(Interval I, Interval_Data& data) = 0;
     virtual Interval search(Interval I, uint8_t c) = 0;
     virtual Interval search_with_precalc(Interval I, uint8_t c, Interval_Data& D) = 0;
+
     
     // save_to_disk: also write type information to directory + "/" + filename_prefix + "_bwt_info"
     virtual void save_to_disk(std::string directory, std::string filename_prefix) = 0;
     virtual void load_from_disk(std::string directory, std::string filename_prefix) = 0;
     
+    // The same for a single-file model. Type information goes to the entry name + "_bwt_info".
+    virtual void save_to_container(Model_Container_Writer& out, std::string name) = 0;
+    virtual void load_from_container(std::shared_ptr<Model_Container> in, std::string name) = 0;
+    
     virtual ~BWT() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
     
 };
@@ -170,6 +187,7 @@ public:
 
 };
 
+class Context_Count_Table;
 class Scoring_Function{
 public:
       /**
@@ -189,6 +207,10 @@ public:
        */
     virtual double score(/*Interval I,*/int64_t node, int64_t d, char c, Topology& topology, BWT& index, Global_Data& G) = 0;
     
+    // Take the counts of the contexts from the table of the model instead of the BWT, if the
+    // scorer supports it. The table must belong to the model that is scored against.
+    virtual void use_context_counts(Context_Count_Table* table) { (void) table; }
+    
     virtual ~Scoring_Function() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
 
 };
@@ -218,8 +240,14 @@ public:
         Interval_pair intervals;  // forward interval, reverse interval
         int64_t depth; // depth in the tree
         bool is_maxrep;
-        Stack_frame(Interval_pair intervals, int64_t depth, bool is_maxrep) : intervals(intervals), depth(depth), is_maxrep(is_maxrep) {}
-        Stack_frame(){}
+        
+        // Whether the node belongs to the suffix link tree and to the reverse suffix tree topology.
+        // Only Fused_Maxrep_Iterator gives nodes that are not in both.
+        bool in_slt;
+        bool in_rev_st;
+        
+        Stack_frame(Interval_pair intervals, int64_t depth, bool is_maxrep) : intervals(intervals), depth(depth), is_maxrep(is_maxrep), in_slt(true), in_rev_st(true) {}
+        Stack_frame() : in_slt(true), in_rev_st(true) {}
     };
     
     virtual void init() = 0;
@@ -227,6 +255,14 @@ public:
     virtual void set_index(BIBWT* index) = 0;
     virtual Stack_frame get_top() = 0;
     
+    // For the parallel traversal (see parallel_traversal.hh). init(start) starts the iteration
+    // from the subtree of start instead of the root. get_pending returns the frames that are
+    // still on the stack, in the order they would be popped. new_copy returns a fresh
+    // iterator of the same type on the same index.
+    virtual void init(const Stack_frame& start) = 0;
+    virtual std::vector<Stack_frame> get_pending() = 0;
+    virtual std::shared_ptr<Iterator> new_copy() = 0;
+    
     virtual ~Iterator() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
 };
 
@@ -238,11 +274,29 @@ public:
 
 };
 
+// A callback that can be used in a parallel traversal. Every task of the traversal feeds the
+// nodes of one subtree to its own copy made by new_local. The copies are merged back with
+// merge in the order of a sequential traversal, so the result is the same as without threads.
+// finish is called only on the original callback.
+class Mergeable_Callback : public Iterator_Callback{
+public:
+    virtual std::shared_ptr<Mergeable_Callback> new_local() = 0;
+    virtual void merge(Mergeable_Callback& local) = 0;
+    virtual ~Mergeable_Callback() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
+};
+
 class Stats_writer;
-class Context_Callback : public Iterator_Callback{
+class Context_Callback : public Mergeable_Callback{
 public:
     
     virtual void init(BIBWT* index, int64_t rev_st_bpr_size, Topology_Mapper& mapper, Stats_writer* writer) = 0;
+    
+    // For building the model in a single traversal, before the topology exists. The contexts
+    // are collected as colex intervals and mapped to the topology by resolve_deferred.
+    // The writer must be disabled, because the statistics need the topology.
+    virtual void init_deferred(BIBWT* index, Stats_writer* writer) = 0;
+    virtual void resolve_deferred(int64_t rev_st_bpr_size, Topology_Mapper& mapper) = 0;
+    
     virtual sdsl::bit_vector get_result() = 0;
     virtual int64_t get_number_of_candidates() = 0;
     virtual ~Context_Callback() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
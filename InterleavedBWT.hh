@@ -0,0 +1,391 @@
+#ifndef InterleavedBWT_h
+#define InterleavedBWT_h
+
+#include <vector>
+#include <utility>
+#include <string>
+#include <cstring>
+#include "bwt.hh"
+#include "Interval.hh"
+#include "sdsl/io.hpp"
+#include "Interfaces.hh"
+#include "model_container.hh"
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+
+/*
+ * FM-index for small alphabets like DNA and protein. The BWT is cut into blocks that are aligned
+ * to cache lines. A block starts with the number of occurrences of every symbol before the block,
+ * 32 bits each, followed by the symbols of the block packed into 64-bit words. rank(i,c) reads the
+ * count of c from the block of i and counts the c's in the block before i with a few word
+ * operations. For DNA a block is a single cache line, so a rank costs one cache miss instead
+ * of one per level of a wavelet tree, and both ends of a short interval are usually in the same
+ * line. For larger alphabets a block is a few consecutive cache lines.
+ *
+ * The text can have at most 2^32 - 1 characters.
+ */
+class Interleaved_BWT final : public BWT {
+
+private:
+
+    Interleaved_BWT(const Interleaved_BWT&); // Prevent copy-construction. blocks may point into a memory mapping.
+    Interleaved_BWT& operator=(const Interleaved_BWT&);  // Prevent assignment
+
+    static const int64_t WORDS_PER_LINE = 8; // 64-byte cache lines
+
+    sdsl::int_vector<64> words; // Storage of the blocks, or a view to a Model_Container
+    const uint64_t* blocks; // The first cache line aligned word of words
+    std::shared_ptr<Model_Container> mapped_from; // Non-null if words points into the mapping of this container
+
+    int64_t n; // Length of the BWT
+    int64_t bits_per_symbol;
+    int64_t symbols_per_word;
+    int64_t count_words; // Number of words of counts at the start of a block
+    int64_t words_per_block;
+    int64_t symbols_per_block;
+    int64_t n_blocks;
+    uint64_t field_low_bits; // The lowest bit of every symbol in a word
+
+    std::vector<int64_t> codes; // codes[c] = rank of c in the alphabet, or -1 if c is not in the alphabet
+    std::vector<int64_t> global_c_array;
+    std::vector<uint8_t> alphabet;
+
+    std::vector<uint8_t> get_string_alphabet(const uint8_t* s) const;
+    int64_t strlen(const uint8_t* str) const;
+    void init_layout(); // Computes the layout parameters from n and the alphabet
+    void set_blocks(const uint64_t* data, int64_t n_words); // Copies the blocks to aligned memory
+    void release_mapping();
+
+    // Number of symbols equal to zero among the first n_fields symbols of x
+    int64_t zero_fields(uint64_t x, int64_t n_fields) const{
+        uint64_t nonzero = x;
+        for(int64_t k = 1; k < bits_per_symbol; k++) nonzero |= x >> k;
+        uint64_t mask = field_low_bits;
+        if(n_fields < symbols_per_word) mask &= (((uint64_t)1) << (n_fields * bits_per_symbol)) - 1;
+        return n_fields - __builtin_popcountll(nonzero & mask);
+    }
+
+    // Number of occurrences of the symbol with the given code in BWT[0..i)
+    int64_t rank(int64_t i, int64_t code) const{
+        const uint64_t* block = blocks + (i / symbols_per_block) * words_per_block;
+        int64_t offset = i % symbols_per_block;
+        int64_t count = (block[code >> 1] >> ((code & 1) * 32)) & 0xFFFFFFFF;
+
+        // Comparing with a word full of the code turns the occurrences into zero fields
+        const uint64_t* symbols = block + count_words;
+        uint64_t pattern = field_low_bits * code;
+        int64_t full_words = offset / symbols_per_word;
+        for(int64_t w = 0; w < full_words; w++)
+            count += zero_fields(symbols[w] ^ pattern, symbols_per_word);
+        int64_t rest = offset % symbols_per_word;
+        if(rest > 0) count += zero_fields(symbols[full_words] ^ pattern, rest);
+        return count;
+    }
+
+public:
+
+    // The input string must not contain the END byte
+    enum : uint8_t { END = 0x01 }; // End of string marker. An enumerator, so that it needs no definition outside the class.
+    Interleaved_BWT() : blocks(nullptr), n(0), bits_per_symbol(0), symbols_per_word(0), count_words(0),
+                        words_per_block(0), symbols_per_block(0), n_blocks(0), field_low_bits(0) {}
+
+    virtual ~Interleaved_BWT(){
+        release_mapping();
+    }
+
+    virtual void init_from_text(const uint8_t* input);
+    virtual void init_from_bwt(const uint8_t* bwt);
+    uint8_t get_END() const { return END; }
+    int64_t size() const { return n; }
+    const std::vector<int64_t>& get_global_c_array() const { return global_c_array; }
+    const std::vector<uint8_t>& get_alphabet() const { return alphabet; }
+
+    Interval search(Interval I, uint8_t c){
+        if(I.size() == 0)
+            return Interval(-1,-2);
+
+        int64_t code = codes[c];
+        if(code == -1) return Interval(-1,-2);
+
+        int64_t rank_left = rank(I.left, code);
+        int64_t num_c_in_interval = rank(I.right + 1, code) - rank_left;
+        int64_t start_new = global_c_array[c] + rank_left;
+        int64_t end_new = start_new + num_c_in_interval - 1;
+
+        if(start_new > end_new) return Interval(-1,-2); // num_c_in_interval == 0
+
+        return Interval(start_new,end_new);
+    }
+
+    Interval search_with_precalc(Interval I, uint8_t c, Interval_Data& D){
+        (void)I; (void) c; (void) D;
+        throw(std::runtime_error("Not implemented error: search_precomputed_data"));
+    }
+
+    void save_to_disk(std::string directory, std::string filename_prefix);
+    void load_from_disk(std::string directory, std::string filename_prefix);
+    void save_to_container(Model_Container_Writer& out, std::string name);
+    void load_from_container(std::shared_ptr<Model_Container> in, std::string name);
+
+};
+
+
+// Returns the alphabet in sorted order
+inline std::vector<uint8_t> Interleaved_BWT::get_string_alphabet(const uint8_t* s) const{
+
+    std::vector<bool> found(256,false);
+    while(*s != 0){
+        found[*s] = true;
+        s++;
+    }
+
+    std::vector<uint8_t> alphabet;
+    for(int i = 0; i < 256; i++){
+        if(found[i]) alphabet.push_back((uint8_t)i);
+    }
+
+    return alphabet;
+}
+
+// strlen(const uint8_t*) is not in the standard library
+inline int64_t Interleaved_BWT::strlen(const uint8_t* str) const{
+    const uint8_t* start = str;
+    while(*str != 0) str++;
+    return str - start;
+}
+
+inline void Interleaved_BWT::init_layout(){
+    int64_t sigma = alphabet.size();
+    codes.assign(256, -1);
+    for(int64_t i = 0; i < sigma; i++) codes[alphabet[i]] = i;
+
+    bits_per_symbol = 1;
+    while((((int64_t)1) << bits_per_symbol) < sigma) bits_per_symbol++;
+    symbols_per_word = 64 / bits_per_symbol;
+    field_low_bits = 0;
+    for(int64_t k = 0; k < symbols_per_word; k++) field_low_bits |= ((uint64_t)1) << (k * bits_per_symbol);
+
+    // Use the smallest number of cache lines such that at least half of the block are symbols
+    count_words = (sigma + 1) / 2;
+    int64_t lines = 1;
+    while(lines * WORDS_PER_LINE - count_words < count_words) lines++;
+    words_per_block = lines * WORDS_PER_LINE;
+    symbols_per_block = (words_per_block - count_words) * symbols_per_word;
+    n_blocks = n / symbols_per_block + 1; // rank(n,c) needs the block of position n
+}
+
+inline void Interleaved_BWT::release_mapping(){
+    if(mapped_from != nullptr) Model_Container::release_int_vector(words);
+    mapped_from = nullptr;
+}
+
+inline void Interleaved_BWT::set_blocks(const uint64_t* data, int64_t n_words){
+    release_mapping();
+    words = sdsl::int_vector<64>(n_words + WORDS_PER_LINE - 1, 0);
+    uint64_t* start = words.data();
+    while(((uintptr_t)start) % (WORDS_PER_LINE * sizeof(uint64_t)) != 0) start++;
+    if(data != nullptr) memcpy(start, data, n_words * sizeof(uint64_t));
+    blocks = start;
+}
+
+inline void Interleaved_BWT::init_from_text(const uint8_t* input){
+
+    if(*input == 0) throw std::runtime_error("Tried to construct BD_BWT_index for an empty string");
+
+    int64_t length = strlen(input);
+
+    if(std::find(input, input+length, END) != input + length){
+        std::stringstream error;
+        error << "Input string contains forbidden byte " << std::hex << (int)END;
+        throw std::runtime_error(error.str());
+    }
+
+    // Build the bwt
+    uint8_t* data = (uint8_t*) malloc(sizeof(uint8_t) * (length + 1));
+    for(int64_t i = 0; i < length; i++){
+        data[i] = input[i];
+    }
+    data[length] = END;
+
+    uint8_t* data_bwt = build_bwt(data,length,END);
+    free(data);
+
+    init_from_bwt(data_bwt);
+
+    free(data_bwt);
+}
+
+inline void Interleaved_BWT::init_from_bwt(const uint8_t* input){
+
+    if(*input == 0) throw std::runtime_error("Tried to construct BD_BWT_index for an empty string");
+
+    n = strlen(input);
+    if(n >= (((int64_t)1) << 32)) throw std::runtime_error("Interleaved BWT supports only texts shorter than 2^32");
+    alphabet = get_string_alphabet(input);
+    init_layout();
+
+    set_blocks(nullptr, n_blocks * words_per_block);
+    uint64_t* B = const_cast<uint64_t*>(blocks);
+    std::vector<int64_t> counts(alphabet.size(), 0);
+    for(int64_t b = 0; b < n_blocks; b++){
+        uint64_t* block = B + b * words_per_block;
+        for(int64_t code = 0; code < alphabet.size(); code++)
+            block[code >> 1] |= ((uint64_t)counts[code]) << ((code & 1) * 32);
+        for(int64_t k = 0; k < symbols_per_block && b * symbols_per_block + k < n; k++){
+            int64_t code = codes[input[b * symbols_per_block + k]];
+            block[count_words + k / symbols_per_word] |= ((uint64_t)code) << ((k % symbols_per_word) * bits_per_symbol);
+            counts[code]++;
+        }
+    }
+
+    // Compute cumulative character counts
+    global_c_array.assign(256, 0);
+    int64_t cumul = 0;
+    for(int64_t code = 0; code < alphabet.size(); code++){
+        global_c_array[alphabet[code]] = cumul;
+        cumul += counts[code];
+    }
+}
+
+inline void Interleaved_BWT::save_to_disk(std::string directory, std::string filename_prefix){
+    // View the aligned blocks as an int vector to use the sdsl serialization
+    sdsl::int_vector<64> blocks_sdsl;
+    blocks_sdsl.attach(blocks, n_blocks * words_per_block * 64);
+    std::string bwt_path = directory + "/" + filename_prefix + "_bwt.dat";
+    bool ok = sdsl::store_to_file(blocks_sdsl, bwt_path);
+    blocks_sdsl.detach();
+    if(!ok) throw std::runtime_error("Error writing to disk: " + bwt_path);
+
+    // Copy to sdsl bit vector because they have serialization built in
+    sdsl::int_vector<64> global_c_array_sdsl(global_c_array.size());
+    for(int64_t i = 0; i < global_c_array.size(); i++){
+        global_c_array_sdsl[i] = global_c_array[i];
+    }
+    std::string gca = directory + "/" + filename_prefix + "_gca.dat";
+    if(!sdsl::store_to_file(global_c_array_sdsl, gca)) {
+        throw std::runtime_error("Error writing to disk: " + gca);
+    }
+
+    sdsl::int_vector<8> alphabet_sdsl(alphabet.size());
+    for(int64_t i = 0; i < alphabet.size(); i++){
+        alphabet_sdsl[i] = alphabet[i];
+    }
+    std::string A = directory + "/" + filename_prefix + "_alphabet.dat";
+    if(!sdsl::store_to_file(alphabet_sdsl, A)) {
+        throw std::runtime_error("Error writing to disk: " + A);
+    }
+
+    sdsl::int_vector<64> size_sdsl(1, n);
+    std::string size_path = directory + "/" + filename_prefix + "_size.dat";
+    if(!sdsl::store_to_file(size_sdsl, size_path)) {
+        throw std::runtime_error("Error writing to disk: " + size_path);
+    }
+
+    std::ofstream info(directory + "/" + filename_prefix + "_bwt_info");
+    info << "interleaved_bwt" << std::endl;
+    if(!info.good()){
+        std::cerr << "Error writing to disk: " << directory + "/" + filename_prefix + "_bwt_info" << std::endl;
+        exit(-1);
+    }
+}
+
+inline void Interleaved_BWT::load_from_disk(std::string directory, std::string filename_prefix){
+    sdsl::int_vector<64> size_sdsl;
+    std::string size_path = directory + "/" + filename_prefix + "_size.dat";
+    if(!sdsl::load_from_file(size_sdsl, size_path)) {
+        throw std::runtime_error("Error reading from disk: " + size_path);
+    }
+    n = size_sdsl[0];
+
+    sdsl::int_vector<64> gca_sdsl;
+    std::string gca_path = directory + "/" + filename_prefix + "_gca.dat";
+    if(!sdsl::load_from_file(gca_sdsl, gca_path)) {
+        throw std::runtime_error("Error reading from disk: " + gca_path);
+    }
+    if(gca_sdsl.size() != 256)
+        throw std::runtime_error("Error reading from disk: " + gca_path + " has the wrong size");
+    global_c_array.resize(256);
+    for(int64_t i = 0; i < 256; i++){
+        global_c_array[i] = gca_sdsl[i];
+    }
+
+    sdsl::int_vector<8> alphabet_sdsl;
+    std::string alphabet_path = directory + "/" + filename_prefix + "_alphabet.dat";
+    if(!sdsl::load_from_file(alphabet_sdsl, alphabet_path)) {
+        throw std::runtime_error("Error reading from disk: " + alphabet_path);
+    }
+    alphabet.resize(alphabet_sdsl.size());
+    for(int64_t i = 0; i < alphabet_sdsl.size(); i++){
+        alphabet[i] = alphabet_sdsl[i];
+    }
+
+    init_layout();
+
+    // The vector is loaded to wherever the allocator puts it, so it is copied to aligned memory
+    sdsl::int_vector<64> blocks_sdsl;
+    std::string bwt_path = directory + "/" + filename_prefix + "_bwt.dat";
+    if(!sdsl::load_from_file(blocks_sdsl, bwt_path)) {
+        throw std::runtime_error("Error reading from disk: " + bwt_path);
+    }
+    if(blocks_sdsl.size() != n_blocks * words_per_block)
+        throw std::runtime_error("Error reading from disk: " + bwt_path + " has the wrong size");
+    set_blocks(blocks_sdsl.data(), blocks_sdsl.size());
+}
+
+inline void Interleaved_BWT::save_to_container(Model_Container_Writer& out, std::string name){
+    sdsl::int_vector<64> blocks_sdsl;
+    blocks_sdsl.attach(blocks, n_blocks * words_per_block * 64);
+    out.add_int_vector(name + "_bwt.dat", blocks_sdsl);
+    blocks_sdsl.detach();
+
+    sdsl::int_vector<64> global_c_array_sdsl(global_c_array.size());
+    for(int64_t i = 0; i < global_c_array.size(); i++){
+        global_c_array_sdsl[i] = global_c_array[i];
+    }
+    out.add_int_vector(name + "_gca.dat", global_c_array_sdsl);
+
+    sdsl::int_vector<8> alphabet_sdsl(alphabet.size());
+    for(int64_t i = 0; i < alphabet.size(); i++){
+        alphabet_sdsl[i] = alphabet[i];
+    }
+    out.add_int_vector(name + "_alphabet.dat", alphabet_sdsl);
+
+    out.add_string(name + "_size.dat", std::to_string(n));
+    out.add_string(name + "_bwt_info", "interleaved_bwt");
+}
+
+// The payloads of the container are page-aligned, so the blocks are used in place from the mapping
+inline void Interleaved_BWT::load_from_container(std::shared_ptr<Model_Container> in, std::string name){
+    n = std::stoll(in->get_string(name + "_size.dat"));
+
+    sdsl::int_vector<64> gca_sdsl;
+    in->view_int_vector(name + "_gca.dat", gca_sdsl);
+    if(gca_sdsl.size() != 256){
+        Model_Container::release_int_vector(gca_sdsl);
+        throw std::runtime_error("Error reading model container: " + name + "_gca.dat has the wrong size");
+    }
+    global_c_array.resize(256);
+    for(int64_t i = 0; i < 256; i++){
+        global_c_array[i] = gca_sdsl[i];
+    }
+    Model_Container::release_int_vector(gca_sdsl);
+
+    sdsl::int_vector<8> alphabet_sdsl;
+    in->view_int_vector(name + "_alphabet.dat", alphabet_sdsl);
+    alphabet.resize(alphabet_sdsl.size());
+    for(int64_t i = 0; i < alphabet_sdsl.size(); i++){
+        alphabet[i] = alphabet_sdsl[i];
+    }
+    Model_Container::release_int_vector(alphabet_sdsl);
+
+    init_layout();
+
+    release_mapping();
+    in->view_int_vector(name + "_bwt.dat", words);
+    mapped_from = in;
+    if(words.size() != n_blocks * words_per_block) throw std::runtime_error("Error reading model container: " + name + "_bwt.dat has the wrong size");
+    blocks = words.data();
+}
+
+#endif /* InterleavedBWT_h */
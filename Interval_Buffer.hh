@@ -0,0 +1,58 @@
+#ifndef INTERVAL_BUFFER_HH
+#define INTERVAL_BUFFER_HH
+
+#include "Interval.hh"
+#include "sdsl/int_vector.hpp"
+#include <algorithm>
+
+// Growable list of intervals with endpoints in [0, max_value]. The endpoints are bit-packed
+// to log2(max_value) bits each.
+class Interval_Buffer{
+
+private:
+
+    sdsl::int_vector<0> endpoints;
+    int64_t n_intervals;
+
+public:
+
+    Interval_Buffer() : n_intervals(0) {}
+
+    void init(int64_t max_value){
+        endpoints = sdsl::int_vector<0>(0, 0, sdsl::bits::hi(std::max(max_value, (int64_t)1)) + 1);
+        n_intervals = 0;
+    }
+
+    // Empty buffer for the same range of values as other
+    void init_like(const Interval_Buffer& other){
+        endpoints = sdsl::int_vector<0>(0, 0, other.endpoints.width());
+        n_intervals = 0;
+    }
+
+    void push_back(Interval I){
+        if(2*n_intervals + 2 > (int64_t)endpoints.size())
+            endpoints.resize(std::max((int64_t)16, 2 * (int64_t)endpoints.size()));
+        endpoints[2*n_intervals] = I.left;
+        endpoints[2*n_intervals+1] = I.right;
+        n_intervals++;
+    }
+
+    void append(const Interval_Buffer& other){
+        for(int64_t i = 0; i < other.size(); i++) push_back(other[i]);
+    }
+
+    Interval operator[](int64_t i) const{
+        return Interval(endpoints[2*i], endpoints[2*i+1]);
+    }
+
+    int64_t size() const{
+        return n_intervals;
+    }
+
+    void free_memory(){
+        sdsl::util::clear(endpoints);
+        n_intervals = 0;
+    }
+};
+
+#endif
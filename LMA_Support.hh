@@ -8,21 +8,27 @@
 #include "globals.hh"
 #include "BD_BWT_index/include/BD_BWT_index.hh"
 #include "Interfaces.hh"
+#include "lma_pointer_table.hh"
 
 // Lowest marked ancestor support
 // Does not own any of the data
-class LMA_Support{
+// marks_t and bpr_t are the types of the bit vectors (see Parent_Support_Template)
+template<typename marks_t, typename bpr_t>
+class LMA_Support_Template{
 public:
     
-    std::shared_ptr<Bitvector> marks;
-    std::shared_ptr<Bitvector> bpr_marked_only;
+    std::shared_ptr<marks_t> marks;
+    std::shared_ptr<bpr_t> bpr_marked_only;
+    std::shared_ptr<LMA_Pointer_Table> pointers; // Null if the model has no table
     
-    LMA_Support() {}
+    LMA_Support_Template() {}
     
-    // Marks assumes both open and close parentheses are marked
-    LMA_Support(std::shared_ptr<Bitvector> marks,
-                std::shared_ptr<Bitvector> bpr_marked_only) :
-        marks(marks), bpr_marked_only(bpr_marked_only) {}
+    // Marks assumes both open and close parentheses are marked. The answers that are in
+    // pointers are taken from there instead of the parenthesis operations.
+    LMA_Support_Template(std::shared_ptr<marks_t> marks,
+                std::shared_ptr<bpr_t> bpr_marked_only,
+                std::shared_ptr<LMA_Pointer_Table> pointers = nullptr) :
+        marks(marks), bpr_marked_only(bpr_marked_only), pointers(pointers) {}
         
     // Takes the position of an open parenthesis in the bpr
     // Returns the position of the opening parenthesis of the
@@ -35,6 +41,7 @@ public:
         int64_t k = marks->rank(p);
         // The current node is a "virtual" node between positions k-1 and k in the marked only bpr
         
+        if(pointers != nullptr && pointers->is_sampled(k)) return pointers->lma(k);
         if(k == 0 || k == bpr_marked_only->size()) return -1;
         
         // Four cases: we are in between (), ((, )) or )(
@@ -55,7 +62,16 @@ public:
         return marks->select(open_in_marked_only+1); // Map back to the original bpr
     }
     
+    // Takes the position of a marked open parenthesis in the bpr. Returns the rank of
+    // the node among the marked nodes in preorder, starting from zero.
+    int64_t marked_preorder_rank(int64_t p){
+        int64_t k = marks->rank(p); // Position in the marked only bpr
+        return (k + 1 + bpr_marked_only->excess(k)) / 2 - 1; // Open parentheses in [0,k]
+    }
+    
 };
 
+typedef LMA_Support_Template<Bitvector, Bitvector> LMA_Support;
+
 
 #endif
@@ -45,6 +45,15 @@ void test_all_queries(sdsl::bit_vector& bpr, sdsl::bit_vector& marks){
     bpr_marked_only_v->init_bps_support();
     
     LMA_Support nmas(marksv, bpr_marked_only_v);
+    
+    // The same queries answered partly or wholly from pointer tables
+    vector<LMA_Support> with_pointers;
+    for(int64_t sample_shift : {0, 1, 3}){
+        shared_ptr<LMA_Pointer_Table> pointers = make_shared<LMA_Pointer_Table>();
+        pointers->build(*marksv, *bpr_marked_only_v, sample_shift);
+        with_pointers.push_back(LMA_Support(marksv, bpr_marked_only_v, pointers));
+    }
+    
     sdsl::bp_support_g<> bpr_bps;
     sdsl::util::init_support(bpr_bps, &bpr);
     for(int64_t open = 0; open < bpr.size(); open++){
@@ -52,6 +61,7 @@ void test_all_queries(sdsl::bit_vector& bpr, sdsl::bit_vector& marks){
             int64_t correct = LMA_naive(open, bpr_bps, marks);
             int64_t test = nmas.LMA(open);
             assert(test == correct);
+            for(LMA_Support& LMAS : with_pointers) assert(LMAS.LMA(open) == correct);
         }
     }
 }
@@ -11,15 +11,18 @@
 #include "Interfaces.hh"
 
 // The purpose of this class is to provide functions to map a lexicographic
-// range into the lexicographic range of the parent
-class Parent_Support{
+// range into the lexicographic range of the parent.
+// bitvector_t is the type of the BPR. A concrete final type lets the compiler inline
+// the bit vector operations (see static_scoring.hh).
+template<typename bitvector_t>
+class Parent_Support_Template{
     
 public:
     
-    std::shared_ptr<Bitvector> bpr;
+    std::shared_ptr<bitvector_t> bpr;
     
-    Parent_Support() {};
-    Parent_Support(std::shared_ptr<Bitvector> bpr) :
+    Parent_Support_Template() {};
+    Parent_Support_Template(std::shared_ptr<bitvector_t> bpr) :
         bpr(bpr) {}
         
     Interval lex_parent(Interval I){ // TODO: delete
@@ -73,6 +76,8 @@ private:
 
 };
 
+typedef Parent_Support_Template<Bitvector> Parent_Support;
+
 
 // sdsl::bit_vector bpr = {1, 1, 1,0,1,0, 0, 1, 1,0, 0, 0};
 // Parent_Support PS(bpr);
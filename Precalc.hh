@@ -17,6 +17,9 @@
 #include <numeric>
 #include <vector>
 #include "Counters.hh"
+#include "Interval_Buffer.hh"
+#include "bit_kernels.hh"
+#include <memory>
 
 /*
  * The BWT iterators in these functions are supposed to iterate all nodes that will
@@ -24,24 +27,47 @@
  */
 
 
-vector<bool> counters_to_bpr(Counters& counters){
+// Position i of the counters becomes get_open(i) ones followed by get_close(i) zeros. The
+// runs of ones are written a word at a time, and the zeros are already there.
+template<typename counters_t>
+sdsl::bit_vector counters_to_bpr(counters_t& counters){
     
-    vector<bool> bpr;
+    int64_t length = 0;
+    for(int64_t i = 0; i < counters.size(); i++){
+        pair<int64_t, int64_t> openclose = counters.get_openclose(i);
+        length += openclose.first + openclose.second;
+    }
     
     // Build the BPR
+    sdsl::bit_vector bpr(length, 0);
+    int64_t pos = 0;
     for(int64_t i = 0; i < counters.size(); i++){
-        for(int64_t j = 0; j < counters.get_open(i); j++){
-            bpr.push_back(1);
-        }
-        for(int64_t j = 0; j < counters.get_close(i); j++){
-            bpr.push_back(0);
-        }
+        pair<int64_t, int64_t> openclose = counters.get_openclose(i);
+        set_ones(bpr, pos, pos + openclose.first);
+        pos += openclose.first + openclose.second;
     }
     
     return bpr;
 }
 
-class Build_SLT_BPR_Callback : public Iterator_Callback{
+// Local copy of a counter-based callback in a parallel traversal: buffers the increments
+// of one task so that they can be applied to the shared counters when merging.
+struct Counter_Increments{
+    vector<int64_t> opens;
+    vector<int64_t> closes;
+    
+    void add(const Iterator::Stack_frame& top){
+        opens.push_back(top.intervals.reverse.left);
+        closes.push_back(top.intervals.reverse.right);
+    }
+    
+    void apply(Counters& counters){
+        for(int64_t pos : opens) counters.increment_open(pos);
+        for(int64_t pos : closes) counters.increment_close(pos);
+    }
+};
+
+class Build_SLT_BPR_Callback : public Mergeable_Callback{
   
 public:
     
@@ -49,7 +75,10 @@ public:
     sdsl::bit_vector bpr_sdsl;
     bool enabled;
     
-    Build_SLT_BPR_Callback() : enabled(true) {}
+    bool is_local;
+    Counter_Increments increments; // Used if is_local
+    
+    Build_SLT_BPR_Callback() : enabled(true), is_local(false) {}
     
     void init(BIBWT& index){
         if(!enabled) return;
@@ -60,17 +89,30 @@ public:
     void disable(){ enabled = false;}
     
     void callback(const Iterator::Stack_frame& top){
-        if(!enabled) return;
+        if(!enabled || !top.in_slt) return;
+        if(is_local){
+            increments.add(top);
+            return;
+        }
         counters.increment_open(top.intervals.reverse.left);
         counters.increment_close(top.intervals.reverse.right);
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        std::shared_ptr<Build_SLT_BPR_Callback> local = make_shared<Build_SLT_BPR_Callback>();
+        local->enabled = enabled;
+        local->is_local = true;
+        return local;
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        if(!enabled) return;
+        dynamic_cast<Build_SLT_BPR_Callback&>(local).increments.apply(counters);
+    }
+    
     void finish(){
         if(!enabled) return;
-        vector<bool> bpr = counters_to_bpr(counters);
-        bpr_sdsl.resize(bpr.size());
-        for(int64_t i = 0; i < bpr.size(); i++)
-            bpr_sdsl[i] = bpr[i];
+        bpr_sdsl = counters_to_bpr(counters);
         counters.free_memory();
     }
     
@@ -85,7 +127,7 @@ struct Rev_st_topology{
     sdsl::bit_vector pruning_marks;
 };
 
-class Build_REV_ST_BPR_And_Pruning_Callback : public Iterator_Callback{
+class Build_REV_ST_BPR_And_Pruning_Callback : public Mergeable_Callback{
   
 public:
     
@@ -93,6 +135,11 @@ public:
     sdsl::bit_vector bpr_sdsl;
     sdsl::bit_vector pruning;
     
+    bool is_local;
+    Counter_Increments increments; // Used if is_local
+    
+    Build_REV_ST_BPR_And_Pruning_Callback() : is_local(false) {}
+    
     void init(BIBWT& index){
         counters.init(index.size());
         pruning = sdsl::bit_vector(index.size(),0);
@@ -101,17 +148,27 @@ public:
     }
     
     virtual void callback(const Iterator::Stack_frame& top){
+        if(!top.in_rev_st) return;
+        if(is_local){
+            increments.add(top);
+            return;
+        }
         counters.increment_open(top.intervals.reverse.left);
         counters.increment_close(top.intervals.reverse.right);
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        std::shared_ptr<Build_REV_ST_BPR_And_Pruning_Callback> local = make_shared<Build_REV_ST_BPR_And_Pruning_Callback>();
+        local->is_local = true;
+        return local;
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        dynamic_cast<Build_REV_ST_BPR_And_Pruning_Callback&>(local).increments.apply(counters);
+    }
+    
     virtual void finish(){
-        vector<bool> bpr = counters_to_bpr(counters);
-        
-        // Copy to bpr_sdsl
-        bpr_sdsl.resize(bpr.size());
-        for(int64_t i = 0; i < bpr.size(); i++)
-            bpr_sdsl[i] = bpr[i];
+        bpr_sdsl = counters_to_bpr(counters);
         
         // Compute pruning marks
         for(int64_t i = 0; i < counters.size(); i++){            
@@ -128,33 +185,77 @@ public:
     }
 };
 
-class Rev_ST_Maximal_Marks_Callback : public Iterator_Callback{
-  
+class Rev_ST_Maximal_Marks_Callback : public Mergeable_Callback{
+// In deferred mode the colex intervals of the maxreps are stored, and they are mapped to
+// the topology by resolve once the topology has been built.
 public:
     
     sdsl::bit_vector marks;
     Topology_Mapper* mapper;
     
+    bool is_local;
+    vector<int64_t> marked_nodes; // Used if is_local
+    
+    bool deferred;
+    Interval_Buffer maxrep_intervals; // Used if deferred
+    
+    Rev_ST_Maximal_Marks_Callback() : mapper(nullptr), is_local(false), deferred(false) {}
+    
     void init(BIBWT& index, int64_t rev_st_bpr_length, Topology_Mapper& mapper){
         (void) index;
         marks = sdsl::bit_vector(rev_st_bpr_length,0);
         this->mapper = &mapper;
     }
     
+    void init_deferred(BIBWT& index){
+        deferred = true;
+        maxrep_intervals.init(index.size());
+    }
+    
     virtual void callback(const Iterator::Stack_frame& top){
         if(top.is_maxrep){
-            marks[mapper->leaves_to_node(top.intervals.reverse)] = 1;
+            if(deferred){
+                maxrep_intervals.push_back(top.intervals.reverse);
+                return;
+            }
+            int64_t node = mapper->leaves_to_node(top.intervals.reverse);
+            if(is_local) marked_nodes.push_back(node);
+            else marks[node] = 1;
         }
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        std::shared_ptr<Rev_ST_Maximal_Marks_Callback> local = make_shared<Rev_ST_Maximal_Marks_Callback>();
+        local->mapper = mapper;
+        local->is_local = true;
+        local->deferred = deferred;
+        if(deferred) local->maxrep_intervals.init_like(maxrep_intervals);
+        return local;
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        Rev_ST_Maximal_Marks_Callback& L = dynamic_cast<Rev_ST_Maximal_Marks_Callback&>(local);
+        if(deferred) maxrep_intervals.append(L.maxrep_intervals);
+        else for(int64_t node : L.marked_nodes) marks[node] = 1;
+    }
+    
     virtual void finish(){}
     
+    void resolve(int64_t rev_st_bpr_length, Topology_Mapper& mapper){
+        assert(deferred);
+        marks = sdsl::bit_vector(rev_st_bpr_length,0);
+        for(int64_t i = 0; i < maxrep_intervals.size(); i++)
+            marks[mapper.leaves_to_node(maxrep_intervals[i])] = 1;
+        maxrep_intervals.free_memory();
+        deferred = false;
+    }
+    
     sdsl::bit_vector get_result(){
         return marks;
     }
 };
 
-class SLT_Maximal_Marks_Callback : public Iterator_Callback{
+class SLT_Maximal_Marks_Callback : public Mergeable_Callback{
     
 public:
     
@@ -163,7 +264,15 @@ public:
     int64_t preorder_rank;
     bool enabled;
     
-    SLT_Maximal_Marks_Callback() : enabled(true) {}
+    bool is_local;
+    vector<int64_t> maxrep_preorder_ranks; // Used if is_local. Relative to the start of the task.
+    
+    // In deferred mode the SLT BPR does not exist yet, and whether each node in preorder is a
+    // maxrep is stored instead. The marks are made by resolve.
+    bool deferred;
+    vector<bool> is_maxrep_in_preorder; // Used if deferred
+    
+    SLT_Maximal_Marks_Callback() : preorder_rank(0), enabled(true), is_local(false), deferred(false) {}
     
     void enable() {enabled = true;}
     void disable() {enabled = false;}
@@ -176,22 +285,69 @@ public:
         preorder_rank = 0;
     }
     
+    void init_deferred(){
+        deferred = true;
+    }
+    
     virtual void callback(const Iterator::Stack_frame& top){
-        if(!enabled) return;
+        if(!enabled || !top.in_slt) return;
+        if(deferred){
+            is_maxrep_in_preorder.push_back(top.is_maxrep);
+            return;
+        }
         preorder_rank++;
         if(top.is_maxrep){ // todo: is_maxrep from the stack frame
-            marks[slt_bpr_ss.select(preorder_rank)] = 1;
+            if(is_local) maxrep_preorder_ranks.push_back(preorder_rank);
+            else marks[slt_bpr_ss.select(preorder_rank)] = 1;
         }
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        std::shared_ptr<SLT_Maximal_Marks_Callback> local = make_shared<SLT_Maximal_Marks_Callback>();
+        local->enabled = enabled;
+        local->is_local = true;
+        local->deferred = deferred;
+        return local;
+    }
+    
+    // The preorder ranks of the local callback continue from the nodes merged so far
+    virtual void merge(Mergeable_Callback& local){
+        if(!enabled) return;
+        SLT_Maximal_Marks_Callback& L = dynamic_cast<SLT_Maximal_Marks_Callback&>(local);
+        if(deferred){
+            is_maxrep_in_preorder.insert(is_maxrep_in_preorder.end(), L.is_maxrep_in_preorder.begin(), L.is_maxrep_in_preorder.end());
+            return;
+        }
+        for(int64_t rank : L.maxrep_preorder_ranks)
+            marks[slt_bpr_ss.select(preorder_rank + rank)] = 1;
+        preorder_rank += L.preorder_rank;
+    }
+    
     virtual void finish(){}
     
+    // The i-th open parenthesis of the SLT BPR is the i-th node in preorder
+    void resolve(sdsl::bit_vector& slt_bpr){
+        assert(deferred);
+        if(!enabled) return;
+        marks = sdsl::bit_vector(slt_bpr.size(),0);
+        int64_t rank = 0;
+        for(int64_t i = 0; i < slt_bpr.size(); i++){
+            if(slt_bpr[i] == 1){
+                if(is_maxrep_in_preorder[rank]) marks[i] = 1;
+                rank++;
+            }
+        }
+        assert(rank == is_maxrep_in_preorder.size());
+        vector<bool>().swap(is_maxrep_in_preorder);
+        deferred = false;
+    }
+    
     sdsl::bit_vector get_result(){
         return marks;
     }
 };
 
-class Store_Depths_Callback : public Iterator_Callback{
+class Store_Depths_Callback : public Mergeable_Callback{
 // Needs a left-to-right DFS traversal
 public:
     
@@ -205,6 +361,21 @@ public:
         maxdepth = 0;
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        std::shared_ptr<Store_Depths_Callback> local = make_shared<Store_Depths_Callback>();
+        local->enabled = enabled;
+        local->init();
+        return local;
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        if(!enabled) return;
+        Store_Depths_Callback& L = dynamic_cast<Store_Depths_Callback&>(local);
+        depths.insert(depths.end(), L.depths.begin(), L.depths.end());
+        maxdepth = max(maxdepth, L.maxdepth);
+        maxreps_seen += L.maxreps_seen;
+    }
+    
     void enable(){
         enabled = true;
     }
@@ -2,13 +2,70 @@
 #define RLE_BITVECTOR
 
 #include "Interfaces.hh"
-#include "prezza/rle_string.h"
+#include "model_container.hh"
+#include "bit_kernels.hh"
+#include "sdsl/sd_vector.hpp"
 #include <stdexcept>
 
-class RLE_bitvector : public Bitvector{
+// Calls f(begin, end) for each maximal run of ones [begin, end) of B, left to right.
+// Scans B a word at a time: the runs start and end at the ones of w ^ (w << 1 | carry).
+template<typename F>
+void for_each_one_run(const sdsl::bit_vector& B, F f){
+    int64_t n_words = (B.size() + 63) / 64;
+    uint64_t carry = 0; // Last bit of the previous word
+    int64_t begin = 0;
+    for(int64_t i = 0; i < n_words; i++){
+        uint64_t w = get_word(B, i);
+        uint64_t boundaries = w ^ ((w << 1) | carry);
+        while(boundaries != 0){
+            int64_t offset = __builtin_ctzll(boundaries);
+            int64_t pos = i * 64 + offset;
+            if(pos == (int64_t)B.size()) break; // The run ending at the end of B is reported below
+            if((w >> offset) & 1) begin = pos;
+            else f(begin, pos);
+            boundaries &= boundaries - 1; // Clear the lowest one
+        }
+        carry = w >> 63;
+    }
+    if(B.size() > 0 && B[B.size() - 1] == 1) f(begin, (int64_t)B.size());
+}
+
+// A bit vector stored as its runs of ones. The starts of the runs are an Elias-Fano coded
+// sd_vector of length size(), and the ends of the runs are an sd_vector of length rank(size())
+// with a one at the last one of each run. Both take space proportional to the number of runs.
+class RLE_bitvector final : public Bitvector{
+    
+private:
+    
+    RLE_bitvector(const RLE_bitvector&); // Prevent copy-construction. The supports point to the sd_vectors.
+    RLE_bitvector& operator=(const RLE_bitvector&); // Prevent assignment
+    
+    std::string info_string(){
+        stringstream info;
+        info << "rle_sd " << have_bps << " " << have_ss_10 << " " << have_rs_10 << " " << have_rs << " " << have_ss;
+        return info.str();
+    }
+    
+    void init_supports(){
+        starts_rs.set_vector(&starts);
+        starts_ss.set_vector(&starts);
+        ends_rs.set_vector(&ends);
+        ends_ss.set_vector(&ends);
+    }
+    
+    // Number of ones before the start of run j
+    int64_t ones_before_run(int64_t j){
+        return j == 0 ? 0 : ends_ss.select(j) + 1;
+    }
+    
 public:
     
-    lzrlbwt::rle_string<> bv;
+    sdsl::sd_vector<> starts; // Ones at the first positions of the runs of ones
+    sdsl::sd_vector<> ends; // Ones at the ranks of the last ones of the runs of ones
+    sdsl::sd_vector<>::rank_1_type starts_rs;
+    sdsl::sd_vector<>::select_1_type starts_ss;
+    sdsl::sd_vector<>::rank_1_type ends_rs;
+    sdsl::sd_vector<>::select_1_type ends_ss;
     
     bool have_bps;
     bool have_ss_10;
@@ -16,35 +73,54 @@ public:
     bool have_rs;
     bool have_ss;
         
-    RLE_bitvector() : have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(false), have_ss(false) {}
+    RLE_bitvector() : have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(false), have_ss(false) {
+        init_supports();
+    }
+    
+    // Two scans over the words of B: one to count the runs and ones, one to fill the sd_vectors.
     RLE_bitvector(const sdsl::bit_vector& B) : have_bps(false), have_ss_10(false), have_rs_10(false), have_rs(true), have_ss(true) {
-        string S;
-        for(int64_t i = 0; i < B.size(); i++){
-            if(B[i] == 0) S += '0';
-            else S += '1';
-        }
-        this->bv = lzrlbwt::rle_string<>(S);
+        int64_t n_runs = 0, n_ones = 0;
+        for_each_one_run(B, [&](int64_t begin, int64_t end){
+            n_runs++;
+            n_ones += end - begin;
+        });
+        
+        sdsl::sd_vector_builder starts_builder(B.size(), n_runs);
+        sdsl::sd_vector_builder ends_builder(n_ones, n_runs);
+        int64_t ones = 0;
+        for_each_one_run(B, [&](int64_t begin, int64_t end){
+            starts_builder.set(begin);
+            ones += end - begin;
+            ends_builder.set(ones - 1);
+        });
+        starts = sdsl::sd_vector<>(starts_builder);
+        ends = sdsl::sd_vector<>(ends_builder);
+        init_supports();
     }
     
     virtual int64_t size(){
-        return bv.size();
+        return starts.size();
     }
     
     virtual bool operator[](int64_t i){
-        return bv[i] == '0' ? 0 : 1;
+        return at(i);
     }
     
     virtual bool at(int64_t i){
-        return bv[i] == '0' ? 0 : 1;;
+        int64_t j = starts_rs.rank(i+1); // Number of runs starting at or before i
+        if(j == 0) return 0;
+        int64_t run_length = ones_before_run(j) - ones_before_run(j-1);
+        return i - (int64_t)starts_ss.select(j) < run_length;
     }
     
     virtual void serialize(string path){
         ofstream outfile(path + "_bv_and_support");
         outfile.exceptions(ifstream::failbit | ifstream::badbit);
-        bv.serialize(outfile);
+        starts.serialize(outfile);
+        ends.serialize(outfile);
 
         ofstream info(path + "_info");
-        info << "rle " << have_bps << " " << have_ss_10 << " " << have_rs_10 << " " << have_rs << " " << have_ss << endl;
+        info << info_string() << endl;
         if(!info.good()){
             cerr << "Error writing to disk: " << path + "_info" << endl;
             exit(-1);
@@ -54,7 +130,9 @@ public:
     virtual void load(string path){
         ifstream infile(path + "_bv_and_support");
         infile.exceptions(ifstream::failbit | ifstream::badbit);
-        bv.load(infile);
+        starts.load(infile);
+        ends.load(infile);
+        init_supports();
 
         ifstream info;
         info.exceptions(ifstream::failbit | ifstream::badbit);
@@ -69,9 +147,28 @@ public:
         }        
     }
     
+    virtual void serialize(Model_Container_Writer& out, string name){
+        out.add_serializable(name + "_starts", starts);
+        out.add_serializable(name + "_ends", ends);
+        out.add_string(name + "_info", info_string());
+    }
+    
+    virtual void load(std::shared_ptr<Model_Container> in, string name){
+        in->load_serializable(name + "_starts", starts);
+        in->load_serializable(name + "_ends", ends);
+        init_supports();
+        string type;
+        stringstream info(in->get_string(name + "_info"));
+        info >> type >> have_bps >> have_ss_10 >> have_rs_10 >> have_rs >> have_ss;
+    }
+    
     virtual int64_t rank(int64_t pos){
         assert(have_rs);
-        return bv.rank(pos, '1');
+        int64_t j = starts_rs.rank(pos); // Number of runs starting before pos
+        if(j == 0) return 0;
+        int64_t before = ones_before_run(j-1);
+        int64_t run_length = ones_before_run(j) - before;
+        return before + std::min(pos - (int64_t)starts_ss.select(j), run_length);
     }
     
     virtual int64_t rank_10(int64_t pos){
@@ -81,7 +178,8 @@ public:
     
     virtual int64_t select(int64_t rank){
         assert(have_ss);
-        return bv.select(rank, '1');
+        int64_t j = ends_rs.rank(rank-1); // The run of the one with this rank
+        return starts_ss.select(j+1) + (rank - 1 - ones_before_run(j));
     }
     
     virtual int64_t select_10(int64_t pos){
@@ -136,19 +234,19 @@ public:
     }
     
     virtual std::string toString(){
-        string S;
-        for(int64_t i = 0; i < bv.size(); i++){
-            S += bv[i]; // bv has characters '0' and '1'
+        string S(size(), '0');
+        int64_t n_runs = starts_rs.rank(size());
+        for(int64_t j = 0; j < n_runs; j++){
+            int64_t begin = starts_ss.select(j+1);
+            std::fill(S.begin() + begin, S.begin() + begin + ones_before_run(j+1) - ones_before_run(j), '1');
         }
         return S;
     }
 };
 
 std::ostream& operator<<(std::ostream& os, RLE_bitvector& B){
-    for(int64_t i = 0; i < B.bv.size(); i++){
-        os << B.bv[i];
-    }
+    os << B.toString();
     return os;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -20,23 +20,25 @@ using namespace std;
 
 // 1 represents an open parenthesis, 0 a closed parenthesis
 // This class should contain only pointer data members, so it can be copied easily
-class String_Depth_Support_SLT : public String_Depth_Support{
+// rev_st_t and slt_t are the types of the bit vectors of the two trees (see Parent_Support_Template)
+template<typename rev_st_t, typename slt_t>
+class String_Depth_Support_SLT_Template : public String_Depth_Support{
     public:
-    String_Depth_Support_SLT() {};
-    String_Depth_Support_SLT(std::shared_ptr<Bitvector> rev_st_bpr,
-                         std::shared_ptr<Bitvector> slt_bpr, 
-                         std::shared_ptr<Bitvector> rev_st_maximal_marks,
-                         std::shared_ptr<Bitvector> slt_maximal_marks)
+    String_Depth_Support_SLT_Template() {};
+    String_Depth_Support_SLT_Template(std::shared_ptr<rev_st_t> rev_st_bpr,
+                         std::shared_ptr<slt_t> slt_bpr, 
+                         std::shared_ptr<rev_st_t> rev_st_maximal_marks,
+                         std::shared_ptr<slt_t> slt_maximal_marks)
       : rev_st_bpr(rev_st_bpr), slt_bpr(slt_bpr), rev_st_maximal_marks(rev_st_maximal_marks), slt_maximal_marks(slt_maximal_marks) {}; // Assuming these have all the required support structures
 
     public:
 
     // Utilities
    
-    std::shared_ptr<Bitvector> rev_st_bpr;
-    std::shared_ptr<Bitvector> slt_bpr;
-    std::shared_ptr<Bitvector> rev_st_maximal_marks;
-    std::shared_ptr<Bitvector> slt_maximal_marks;
+    std::shared_ptr<rev_st_t> rev_st_bpr;
+    std::shared_ptr<slt_t> slt_bpr;
+    std::shared_ptr<rev_st_t> rev_st_maximal_marks;
+    std::shared_ptr<slt_t> slt_maximal_marks;
     
     virtual int64_t string_depth(int64_t open){
         assert(rev_st_maximal_marks->at(open) == 1); // Only works for maxreps
@@ -62,15 +64,18 @@ class String_Depth_Support_SLT : public String_Depth_Support{
         
 };
 
-class String_Depth_Support_Store_All : public String_Depth_Support{
+typedef String_Depth_Support_SLT_Template<Bitvector, Bitvector> String_Depth_Support_SLT;
+
+template<typename bitvector_t>
+class String_Depth_Support_Store_All_Template : public String_Depth_Support{
     
     public:
     
     std::shared_ptr<sdsl::int_vector<0>> depths;
-    std::shared_ptr<Bitvector> rev_st_maximal_marks;
+    std::shared_ptr<bitvector_t> rev_st_maximal_marks;
     
-    String_Depth_Support_Store_All() {}
-    String_Depth_Support_Store_All(std::shared_ptr<sdsl::int_vector<0>> depths, std::shared_ptr<Bitvector> rev_st_maximal_marks) : depths(depths), rev_st_maximal_marks(rev_st_maximal_marks){}
+    String_Depth_Support_Store_All_Template() {}
+    String_Depth_Support_Store_All_Template(std::shared_ptr<sdsl::int_vector<0>> depths, std::shared_ptr<bitvector_t> rev_st_maximal_marks) : depths(depths), rev_st_maximal_marks(rev_st_maximal_marks){}
     
     virtual int64_t string_depth(int64_t open_paren){
         // Only works for maxreps
@@ -80,6 +85,8 @@ class String_Depth_Support_Store_All : public String_Depth_Support{
     }
 };
 
+typedef String_Depth_Support_Store_All_Template<Bitvector> String_Depth_Support_Store_All;
+
 
 
 #endif
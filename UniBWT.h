@@ -17,6 +17,7 @@
 #include "Interval.hh"
 #include "sdsl/io.hpp"
 #include "Interfaces.hh"
+#include "model_container.hh"
 #include <stdexcept>
 
 
@@ -31,7 +32,7 @@
  */
 
 template<class t_bitvector = sdsl::bit_vector>
-class Basic_BWT : public BWT {
+class Basic_BWT final : public BWT {
     
 public:
     
@@ -64,6 +65,8 @@ public:
     
     virtual void save_to_disk(std::string directory, std::string filename_prefix);
     virtual void load_from_disk(std::string directory, std::string filename_prefix);
+    virtual void save_to_container(Model_Container_Writer& out, std::string name);
+    virtual void load_from_container(std::shared_ptr<Model_Container> in, std::string name);
     
     // Results are stored in the provided struct reference
     void compute_interval_data(Interval I, Interval_Data& data){
@@ -77,9 +80,9 @@ public:
         if(I.size() == 0)
             return Interval(-1,-2);
         
-        // Todo: rank at I.left is computed twice. Reuse.
-        int64_t num_c_in_interval = bwt.rank(I.right + 1,c) - bwt.rank(I.left,c);
-        int64_t start_new = get_global_c_array()[c] + bwt.rank(I.left, c);
+        int64_t rank_left = bwt.rank(I.left, c);
+        int64_t num_c_in_interval = bwt.rank(I.right + 1,c) - rank_left;
+        int64_t start_new = get_global_c_array()[c] + rank_left;
         int64_t end_new = start_new + num_c_in_interval - 1;
         
         if(start_new > end_new) return Interval(-1,-2); // num_c_in_interval == 0
@@ -274,6 +277,8 @@ void Basic_BWT<t_bitvector>::load_from_disk(std::string directory, std::string f
     if(!sdsl::load_from_file(gca_sdsl, gca_path)) {
         throw std::runtime_error("Error reading from disk: " + gca_path);
     }
+    if(gca_sdsl.size() != 256)
+        throw std::runtime_error("Error reading from disk: " + gca_path + " has the wrong size");
     for(int64_t i = 0; i < 256; i++){
         global_c_array[i] = gca_sdsl[i];
     }
@@ -293,4 +298,50 @@ void Basic_BWT<t_bitvector>::load_from_disk(std::string directory, std::string f
 
 
 
+template<class t_bitvector>
+void Basic_BWT<t_bitvector>::save_to_container(Model_Container_Writer& out, std::string name){
+    out.add_serializable(name + "_bwt.dat", bwt);
+    
+    sdsl::int_vector<64> global_c_array_sdsl(global_c_array.size());
+    for(int64_t i = 0; i < global_c_array.size(); i++){
+        global_c_array_sdsl[i] = global_c_array[i];
+    }
+    out.add_int_vector(name + "_gca.dat", global_c_array_sdsl);
+    
+    sdsl::int_vector<8> alphabet_sdsl(alphabet.size());
+    for(int64_t i = 0; i < alphabet.size(); i++){
+        alphabet_sdsl[i] = alphabet[i];
+    }
+    out.add_int_vector(name + "_alphabet.dat", alphabet_sdsl);
+    
+    out.add_string(name + "_bwt_info", "basic_bwt");
+}
+
+// The wavelet tree is deserialized from the mapping of the container, so it is copied to the heap.
+template<class t_bitvector>
+void Basic_BWT<t_bitvector>::load_from_container(std::shared_ptr<Model_Container> in, std::string name){
+    in->load_serializable(name + "_bwt.dat", bwt);
+    
+    // The small arrays are copied to std::vectors, so the views are released right away
+    sdsl::int_vector<64> gca_sdsl;
+    in->view_int_vector(name + "_gca.dat", gca_sdsl);
+    if(gca_sdsl.size() != 256){
+        Model_Container::release_int_vector(gca_sdsl);
+        throw std::runtime_error("Error reading model container: " + name + "_gca.dat has the wrong size");
+    }
+    global_c_array.resize(256);
+    for(int64_t i = 0; i < 256; i++){
+        global_c_array[i] = gca_sdsl[i];
+    }
+    Model_Container::release_int_vector(gca_sdsl);
+    
+    sdsl::int_vector<8> alphabet_sdsl;
+    in->view_int_vector(name + "_alphabet.dat", alphabet_sdsl);
+    alphabet.resize(alphabet_sdsl.size());
+    for(int64_t i = 0; i < alphabet_sdsl.size(); i++){
+        alphabet[i] = alphabet_sdsl[i];
+    }
+    Model_Container::release_int_vector(alphabet_sdsl);
+}
+
 #endif /* UniBWT_h */
@@ -0,0 +1,37 @@
+#ifndef BATCH_SCORING_HH
+#define BATCH_SCORING_HH
+
+#include "score_string.hh"
+#include "globals.hh"
+#include "Interfaces.hh"
+#include <vector>
+#include <string>
+
+// Scores many queries on one thread, one query after the other. The support structures
+// are built once for the whole range instead of once per query. Every query goes through
+// exactly the same steps as when it is scored alone, so the scores are identical to those
+// of score_string and score_string_lin.
+
+// Scores queries[begin..end) into results[begin..end)
+void score_strings_batched(const vector<string>& queries, int64_t begin, int64_t end, vector<double>& results, Global_Data& G,
+                           Topology& topology, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    assert(results.size() >= end);
+    for(int64_t i = begin; i < end; i++){
+        Main_Loop_State state(G);
+        for(char c : queries[i]) main_loop_step(state, c, G, topology, scorer, updater);
+        results[i] = state.logprob;
+    }
+}
+
+void score_strings_lin_batched(const vector<string>& queries, int64_t begin, int64_t end, vector<double>& results, Global_Data& G){
+    assert(results.size() >= end);
+    Pruned_Topology_Mapper mapper(G.rev_st_bpr,G.pruning_marks); // Also works for non-pruned topology
+    Parent_Support PS(G.rev_st_bpr);
+    for(int64_t i = begin; i < end; i++){
+        Lin_Scoring_State state(G);
+        for(char c : queries[i]) lin_scoring_step(state, c, G, mapper, PS);
+        results[i] = state.out;
+    }
+}
+
+#endif
@@ -0,0 +1,656 @@
+//
+//  benchmark_driver.cpp
+//
+//  End-to-end benchmarks: builds models of datasets at several scales with every context formula
+//  and with and without --rle and --maxreps-pruning, scores query sets in raw and FASTA mode, and
+//  writes the wall time of every phase, the peak resident set size, the size of every stored
+//  structure and the scoring throughput to a CSV or JSON lines file. With a baseline directory,
+//  runs the same benchmarks with two sets of binaries on the same machine and compares them.
+//
+//  The programs are run as child processes. A phase is the time between two consecutive log
+//  lines of the program, taken when the line arrives, so that the driver works also with binaries
+//  that are older than it.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <algorithm>
+#include <tuple>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "synthetic_inputs.hh"
+
+using namespace std;
+
+struct Driver_Config{
+    string bin_dir = ".";
+    string baseline_bin_dir; // Regression mode if not empty
+    string build_binary = "build_model_optimized";
+    string score_binary = "score_string_optimized";
+    string work_dir = "benchmark_work";
+    string csv_path, json_path;
+    vector<string> datasets; // Files given by the user
+    vector<string> generated = {"dna", "protein", "text"};
+    vector<int64_t> scales = {100000, 1000000};
+    vector<string> formulas = {"entropy:0.05", "KL:0.05", "pnorm:2:0.05", "four-thresholds:0.001:0.001:0.952:1.050"};
+    vector<string> variants = {"plain", "rle", "maxreps", "rle+maxreps"};
+    vector<string> build_flags, score_flags; // Passed through to the programs
+    string escapeprob = "0.05";
+    int64_t n_queries = 1000;
+    int64_t query_length = 1000;
+    int64_t repeats = 1;
+    uint64_t seed = 1;
+    double tolerance = 0.05;
+    bool keep_models = false;
+};
+
+struct Dataset{
+    string name, path;
+    int64_t size;
+    string query_raw, query_fasta; // Paths of the query sets
+    int64_t n_queries, n_query_characters;
+};
+
+struct Process_Result{
+    int exit_status; // 0 if the program succeeded
+    double wall_seconds;
+    int64_t peak_rss_bytes;
+    vector<pair<string, double>> phases; // Name and wall seconds, in the order of the first occurrence
+};
+
+struct Result_Row{
+    string binary, dataset;
+    int64_t dataset_size;
+    string formula, variant;
+    int64_t repeat;
+    string task, metric, name;
+    double value;
+};
+
+vector<string> split(const string& S, char delimiter){
+    vector<string> tokens;
+    stringstream ss(S);
+    string token;
+    while(getline(ss, token, delimiter)) if(token != "") tokens.push_back(token);
+    return tokens;
+}
+
+string sanitize(string name){
+    for(char& c : name) if(!isalnum(c) && c != '.' && c != '-' && c != '_') c = '_';
+    return name;
+}
+
+string basename_of(const string& path){
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+void make_dirs(const string& path){
+    for(size_t i = 1; i <= path.size(); i++){
+        if(i == path.size() || path[i] == '/'){
+            string prefix = path.substr(0, i);
+            if(mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST){
+                cerr << "Error: could not create directory " << prefix << endl;
+                exit(-1);
+            }
+        }
+    }
+}
+
+void remove_files_in(const string& dir){
+    DIR* d = opendir(dir.c_str());
+    if(d == nullptr) return;
+    while(dirent* entry = readdir(d)){
+        string name = entry->d_name;
+        if(name != "." && name != "..") unlink((dir + "/" + name).c_str());
+    }
+    closedir(d);
+}
+
+int64_t file_size(const string& path){
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return -1;
+    return st.st_size;
+}
+
+string read_file(const string& path){
+    ifstream in(path, ios::binary);
+    stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// The log message of a line written by write_log, without the time stamp and with everything
+// from the first number or path on removed, so that the same phase has the same name in every
+// run. Empty if the line is not a log line.
+string phase_name(const string& line){
+    // The time stamp is the 24 characters of asctime, like "Sat Oct 17 19:16:57 2026"
+    if(line.size() < 26 || line[3] != ' ' || line[7] != ' ' || line[13] != ':' || line[16] != ':' || line[24] != ' ') return "";
+    string message = line.substr(25);
+    size_t end = message.find_first_of("0123456789/:");
+    if(end != string::npos) message = message.substr(0, end);
+    while(message.size() > 0 && message.back() == ' ') message.pop_back();
+    return message;
+}
+
+// A message that is logged more than once, like the peak memory usage, is one phase with the
+// total time, so that the phase names of a run are unique
+void add_phase(Process_Result& result, const string& name, double seconds){
+    for(auto& phase : result.phases){
+        if(phase.first == name){
+            phase.second += seconds;
+            return;
+        }
+    }
+    result.phases.push_back({name, seconds});
+}
+
+// Runs the program with the given arguments, with the standard output going to stdout_path and
+// the standard error to log_path
+Process_Result run_process(const vector<string>& args, const string& stdout_path, const string& log_path){
+    int pipe_fds[2];
+    if(pipe(pipe_fds) != 0){
+        cerr << "Error: could not create a pipe" << endl;
+        exit(-1);
+    }
+
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid < 0){
+        cerr << "Error: could not fork" << endl;
+        exit(-1);
+    }
+    if(pid == 0){
+        int out = open(stdout_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(out < 0) _exit(127);
+        dup2(out, STDOUT_FILENO);
+        dup2(pipe_fds[1], STDERR_FILENO);
+        close(out);
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        vector<char*> argv;
+        for(const string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+    Process_Result result;
+    ofstream log(log_path);
+    FILE* err = fdopen(pipe_fds[0], "r");
+    string current_phase = "Start";
+    auto phase_start = start;
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while((length = getline(&line, &capacity, err)) != -1){
+        auto now = chrono::steady_clock::now();
+        string S(line, length);
+        log << S;
+        if(S.size() > 0 && S.back() == '\n') S.pop_back();
+        string name = phase_name(S);
+        if(name == "") continue;
+        add_phase(result, current_phase, chrono::duration<double>(now - phase_start).count());
+        current_phase = name;
+        phase_start = now;
+    }
+    free(line);
+    fclose(err);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    auto end = chrono::steady_clock::now();
+    add_phase(result, current_phase, chrono::duration<double>(end - phase_start).count());
+    result.wall_seconds = chrono::duration<double>(end - start).count();
+    result.peak_rss_bytes = (int64_t)usage.ru_maxrss * 1024; // Kilobytes on Linux
+    result.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if(result.exit_status != 0) cerr << "Warning: " << args[0] << " failed with status " << result.exit_status << ", see " << log_path << endl;
+    return result;
+}
+
+// Writes the rows to the CSV and JSON lines files as they come, and keeps them for the comparison
+class Results_Writer{
+
+private:
+
+    ofstream csv, json;
+
+    static string csv_field(const string& S){
+        if(S.find_first_of(",\"\n") == string::npos) return S;
+        string quoted = "\"";
+        for(char c : S) quoted += (c == '"') ? string("\"\"") : string(1, c);
+        return quoted + "\"";
+    }
+
+    static string json_string(const string& S){
+        string escaped = "\"";
+        for(char c : S){
+            if(c == '"' || c == '\\') escaped += '\\';
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+public:
+
+    vector<Result_Row> rows;
+
+    Results_Writer(const string& csv_path, const string& json_path){
+        if(csv_path != ""){
+            csv.open(csv_path);
+            csv << "binary,dataset,dataset_size,formula,variant,repeat,task,metric,name,value" << endl;
+        }
+        if(json_path != "") json.open(json_path);
+        csv.precision(15);
+        json.precision(15);
+        if((csv_path != "" && !csv.good()) || (json_path != "" && !json.good())){
+            cerr << "Error: could not open the results files" << endl;
+            exit(-1);
+        }
+    }
+
+    void add(const Result_Row& R){
+        rows.push_back(R);
+        if(csv.is_open()){
+            csv << R.binary << "," << csv_field(R.dataset) << "," << R.dataset_size << "," << csv_field(R.formula) << "," << R.variant << ","
+                << R.repeat << "," << R.task << "," << R.metric << "," << csv_field(R.name) << "," << R.value << endl;
+        }
+        if(json.is_open()){
+            json << "{\"binary\": " << json_string(R.binary) << ", \"dataset\": " << json_string(R.dataset) << ", \"dataset_size\": " << R.dataset_size
+                 << ", \"formula\": " << json_string(R.formula) << ", \"variant\": " << json_string(R.variant) << ", \"repeat\": " << R.repeat
+                 << ", \"task\": " << json_string(R.task) << ", \"metric\": " << json_string(R.metric) << ", \"name\": " << json_string(R.name)
+                 << ", \"value\": " << R.value << "}" << endl;
+        }
+    }
+};
+
+// The build_model arguments of a formula like entropy:0.05, KL:0.05, pnorm:2:0.05 or
+// four-thresholds:0.001:0.001:0.952:1.050
+vector<string> formula_args(const string& formula){
+    vector<string> parts = split(formula, ':');
+    map<string, int64_t> n_parameters = {{"entropy", 1}, {"KL", 1}, {"pnorm", 2}, {"four-thresholds", 4}};
+    if(parts.size() == 0 || n_parameters.count(parts[0]) == 0 || (int64_t)parts.size() != n_parameters[parts[0]] + 1){
+        cerr << "Error: invalid context formula " << formula << endl;
+        exit(-1);
+    }
+    parts[0] = "--" + parts[0];
+    return parts;
+}
+
+vector<string> variant_args(const string& variant){
+    if(variant == "plain") return {};
+    if(variant == "rle") return {"--rle"};
+    if(variant == "maxreps") return {"--maxreps-pruning"};
+    if(variant == "rle+maxreps") return {"--rle", "--maxreps-pruning"};
+    cerr << "Error: invalid variant " << variant << endl;
+    exit(-1);
+}
+
+// Half of the queries are substrings of the dataset with 5% of the characters changed, and half
+// have the character distribution of the dataset but no other relation to it. Newlines and '>'
+// are left out so that the FASTA records and the raw file have the same characters.
+void write_queries(Dataset& D, const Driver_Config& C, const string& dir){
+    string T = read_file(D.path);
+    string characters;
+    for(char c : T) if(c != '\n' && c != '\r' && c != '>') characters += c;
+    if(characters.size() == 0){
+        cerr << "Error: no characters for queries in " << D.path << endl;
+        exit(-1);
+    }
+
+    mt19937_64 rng(C.seed);
+    D.query_raw = dir + "/" + D.name + ".queries.txt";
+    D.query_fasta = dir + "/" + D.name + ".queries.fa";
+    ofstream raw(D.query_raw), fasta(D.query_fasta);
+    D.n_queries = C.n_queries;
+    D.n_query_characters = 0;
+    for(int64_t q = 0; q < C.n_queries; q++){
+        int64_t length = min(C.query_length, (int64_t)characters.size());
+        string query;
+        if(q % 2 == 0){
+            int64_t start = rng() % (characters.size() - length + 1);
+            query = characters.substr(start, length);
+            for(char& c : query) if(uniform(rng) < 0.05) c = characters[rng() % characters.size()];
+        } else{
+            for(int64_t i = 0; i < length; i++) query += characters[rng() % characters.size()];
+        }
+        raw << query;
+        fasta << ">query_" << q << "\n" << query << "\n";
+        D.n_query_characters += length;
+    }
+    if(!raw.good() || !fasta.good()){
+        cerr << "Error writing the queries to " << dir << endl;
+        exit(-1);
+    }
+}
+
+vector<Dataset> prepare_datasets(const Driver_Config& C){
+    string dir = C.work_dir + "/data";
+    make_dirs(dir);
+    vector<Dataset> datasets;
+    for(const string& path : C.datasets){
+        Dataset D;
+        D.name = sanitize(basename_of(path));
+        D.path = path;
+        D.size = file_size(path);
+        if(D.size <= 0){
+            cerr << "Error: could not read dataset " << path << endl;
+            exit(-1);
+        }
+        datasets.push_back(D);
+    }
+    for(const string& name : C.generated){
+        for(int64_t scale : C.scales){
+            mt19937_64 rng(C.seed);
+            string T = generate_input(name, scale, rng);
+            if(T == ""){
+                cerr << "Error: unknown generated dataset " << name << endl;
+                exit(-1);
+            }
+            Dataset D;
+            D.name = name + "_" + to_string(scale);
+            D.path = dir + "/" + D.name + ".txt";
+            D.size = scale;
+            ofstream out(D.path);
+            out << T;
+            if(!out.good()){
+                cerr << "Error writing to file " << D.path << endl;
+                exit(-1);
+            }
+            datasets.push_back(D);
+        }
+    }
+    for(Dataset& D : datasets) write_queries(D, C, dir);
+    return datasets;
+}
+
+// Sizes of the stored structures from the .profile file of the model, or the sizes of the files
+// of the model if there is no profile
+vector<pair<string, int64_t>> model_structure_sizes(const string& model_dir, const string& prefix){
+    vector<pair<string, int64_t>> sizes;
+    ifstream profile(model_dir + "/" + prefix + ".profile");
+    string profile_name, name;
+    int64_t bytes;
+    if(profile >> profile_name){
+        while(profile >> name >> bytes) sizes.push_back({name, bytes});
+        return sizes;
+    }
+    DIR* d = opendir(model_dir.c_str());
+    if(d == nullptr) return sizes;
+    while(dirent* entry = readdir(d)){
+        string file = entry->d_name;
+        if(file.compare(0, prefix.size() + 1, prefix + ".") != 0) continue;
+        sizes.push_back({file.substr(prefix.size() + 1), file_size(model_dir + "/" + file)});
+    }
+    closedir(d);
+    sort(sizes.begin(), sizes.end());
+    return sizes;
+}
+
+void add_process_rows(Results_Writer& W, Result_Row R, const Process_Result& P){
+    R.name = "";
+    R.metric = "exit_status"; R.value = P.exit_status; W.add(R);
+    R.metric = "wall_seconds"; R.value = P.wall_seconds; W.add(R);
+    R.metric = "peak_rss_bytes"; R.value = P.peak_rss_bytes; W.add(R);
+    R.metric = "phase_seconds";
+    for(auto& phase : P.phases){
+        R.name = phase.first;
+        R.value = phase.second;
+        W.add(R);
+    }
+}
+
+// Builds the model of one configuration with the binaries in bin_dir and scores both query sets
+// against it. Returns the score outputs by task.
+map<string, string> run_configuration(const Driver_Config& C, Results_Writer& W, const string& binary, const string& bin_dir,
+                                      const Dataset& D, const string& formula, const string& variant, int64_t repeat){
+    string config_name = sanitize(formula) + "." + variant;
+    string model_dir = C.work_dir + "/models/" + binary + "/" + D.name + "/" + config_name;
+    string output_dir = C.work_dir + "/output/" + binary + "/" + D.name + "/" + config_name;
+    make_dirs(model_dir);
+    make_dirs(output_dir);
+    remove_files_in(model_dir);
+
+    Result_Row R;
+    R.binary = binary;
+    R.dataset = D.name;
+    R.dataset_size = D.size;
+    R.formula = formula;
+    R.variant = variant;
+    R.repeat = repeat;
+
+    vector<string> build_args = {bin_dir + "/" + C.build_binary, "--reference-raw", D.path, "--outputdir", model_dir};
+    for(const string& arg : formula_args(formula)) build_args.push_back(arg);
+    for(const string& arg : variant_args(variant)) build_args.push_back(arg);
+    for(const string& arg : C.build_flags) build_args.push_back(arg);
+    Process_Result build = run_process(build_args, output_dir + "/build.stdout", output_dir + "/build.log");
+    R.task = "build";
+    add_process_rows(W, R, build);
+
+    map<string, string> scores;
+    if(build.exit_status != 0) return scores;
+
+    string prefix = basename_of(D.path);
+    int64_t total_bytes = 0;
+    R.metric = "model_bytes";
+    for(auto& structure : model_structure_sizes(model_dir, prefix)){
+        R.name = structure.first;
+        R.value = structure.second;
+        W.add(R);
+        total_bytes += structure.second;
+    }
+    R.name = "";
+    R.metric = "model_bytes_total"; R.value = total_bytes; W.add(R);
+
+    vector<pair<string, string>> modes = {{"score_raw", "--query-raw"}, {"score_fasta", "--query-fasta"}};
+    for(auto& mode : modes){
+        string query_path = mode.first == "score_raw" ? D.query_raw : D.query_fasta;
+        vector<string> score_args = {bin_dir + "/" + C.score_binary, mode.second, query_path, "--dir", model_dir, "--file", prefix, "--escapeprob", C.escapeprob};
+        for(const string& arg : C.score_flags) score_args.push_back(arg);
+        string stdout_path = output_dir + "/" + mode.first + ".stdout";
+        Process_Result score = run_process(score_args, stdout_path, output_dir + "/" + mode.first + ".log");
+        R.task = mode.first;
+        add_process_rows(W, R, score);
+        if(score.exit_status != 0) continue;
+        scores[mode.first] = read_file(stdout_path);
+
+        // Throughput of the scoring phase only, without loading the model
+        double scoring_seconds = score.wall_seconds;
+        for(auto& phase : score.phases) if(phase.first == "Starting to score") scoring_seconds = phase.second;
+        int64_t n_queries = mode.first == "score_raw" ? 1 : D.n_queries;
+        R.name = "";
+        R.metric = "queries_per_second"; R.value = n_queries / scoring_seconds; W.add(R);
+        R.metric = "characters_per_second"; R.value = D.n_query_characters / scoring_seconds; W.add(R);
+    }
+
+    if(!C.keep_models) remove_files_in(model_dir);
+    return scores;
+}
+
+double median(vector<double> values){
+    sort(values.begin(), values.end());
+    int64_t n = values.size();
+    return n % 2 == 1 ? values[n/2] : (values[n/2 - 1] + values[n/2]) / 2;
+}
+
+// Prints the medians of both binaries and their ratio for every configuration and main metric.
+// Returns the number of regressions.
+int64_t print_comparison(const Driver_Config& C, const vector<Result_Row>& rows){
+    // Metrics where a larger value is better. For the others a smaller value is better.
+    set<string> higher_is_better = {"queries_per_second", "characters_per_second"};
+    set<string> compared = {"wall_seconds", "peak_rss_bytes", "model_bytes_total", "queries_per_second", "characters_per_second"};
+
+    typedef tuple<string, string, string, string, string> Key; // dataset, formula, variant, task, metric
+    map<Key, map<string, vector<double>>> values; // Key -> binary -> values of the repeats
+    vector<Key> order;
+    for(const Result_Row& R : rows){
+        if(compared.count(R.metric) == 0) continue;
+        Key key(R.dataset, R.formula, R.variant, R.task, R.metric);
+        if(values.count(key) == 0) order.push_back(key);
+        values[key][R.binary].push_back(R.value);
+    }
+
+    int64_t n_regressions = 0;
+    cout << "# dataset\tformula\tvariant\ttask\tmetric\tbaseline_median\tcandidate_median\tratio\tverdict" << endl;
+    for(const Key& key : order){
+        map<string, vector<double>>& by_binary = values[key];
+        if(by_binary["baseline"].empty() || by_binary["candidate"].empty()) continue;
+        double baseline = median(by_binary["baseline"]);
+        double candidate = median(by_binary["candidate"]);
+        double ratio = baseline == 0 ? (candidate == 0 ? 1 : 1e300) : candidate / baseline;
+        bool better_is_higher = higher_is_better.count(get<4>(key)) > 0;
+        double worse_ratio = better_is_higher ? 1 / max(ratio, 1e-300) : ratio;
+        string verdict = "ok";
+        if(worse_ratio > 1 + C.tolerance){
+            verdict = "regression";
+            n_regressions++;
+        } else if(worse_ratio < 1 - C.tolerance) verdict = "improvement";
+        cout << get<0>(key) << "\t" << get<1>(key) << "\t" << get<2>(key) << "\t" << get<3>(key) << "\t" << get<4>(key) << "\t"
+             << baseline << "\t" << candidate << "\t" << ratio << "\t" << verdict << endl;
+    }
+    return n_regressions;
+}
+
+void print_usage(){
+    cerr << "End-to-end build and scoring benchmarks" << endl;
+    cerr << "Usage: benchmark_driver (--csv [file]) (--json [file]) (--bin-dir [directory]) (--baseline-bin-dir [directory])" << endl;
+    cerr << "    (--dataset [raw file, repeatable]) (--generate [comma-separated subset of dna,protein,text, or none]) (--scales [comma-separated sizes])" << endl;
+    cerr << "    (--formulas [comma-separated formulas like entropy:0.05,KL:0.05,pnorm:2:0.05,four-thresholds:0.001:0.001:0.952:1.050])" << endl;
+    cerr << "    (--variants [comma-separated subset of plain,rle,maxreps,rle+maxreps]) (--queries [number]) (--query-length [characters])" << endl;
+    cerr << "    (--repeats [number]) (--seed [number]) (--tolerance [fraction]) (--escapeprob [probability]) (--work-dir [directory])" << endl;
+    cerr << "    (--build-binary [name]) (--score-binary [name]) (--build-flags [flags]) (--score-flags [flags]) (--keep-models)" << endl;
+}
+
+int main(int argc, char** argv){
+
+    Driver_Config C;
+    bool datasets_given = false, generate_given = false;
+    for(int64_t i = 1; i < argc; i++){
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "--keep-models"){
+            C.keep_models = true;
+        } else if(!has_value){
+            print_usage();
+            return -1;
+        } else if(arg == "--csv"){
+            C.csv_path = argv[++i];
+        } else if(arg == "--json"){
+            C.json_path = argv[++i];
+        } else if(arg == "--bin-dir"){
+            C.bin_dir = argv[++i];
+        } else if(arg == "--baseline-bin-dir"){
+            C.baseline_bin_dir = argv[++i];
+        } else if(arg == "--build-binary"){
+            C.build_binary = argv[++i];
+        } else if(arg == "--score-binary"){
+            C.score_binary = argv[++i];
+        } else if(arg == "--work-dir"){
+            C.work_dir = argv[++i];
+        } else if(arg == "--dataset"){
+            C.datasets.push_back(argv[++i]);
+            datasets_given = true;
+        } else if(arg == "--generate"){
+            string value = argv[++i];
+            C.generated = value == "none" ? vector<string>() : split(value, ',');
+            generate_given = true;
+        } else if(arg == "--scales"){
+            C.scales.clear();
+            for(const string& s : split(argv[++i], ',')) C.scales.push_back(stoll(s));
+        } else if(arg == "--formulas"){
+            C.formulas = split(argv[++i], ',');
+        } else if(arg == "--variants"){
+            C.variants = split(argv[++i], ',');
+        } else if(arg == "--build-flags"){
+            C.build_flags = split(argv[++i], ' ');
+        } else if(arg == "--score-flags"){
+            C.score_flags = split(argv[++i], ' ');
+        } else if(arg == "--escapeprob"){
+            C.escapeprob = argv[++i];
+        } else if(arg == "--queries"){
+            C.n_queries = stoll(argv[++i]);
+        } else if(arg == "--query-length"){
+            C.query_length = stoll(argv[++i]);
+        } else if(arg == "--repeats"){
+            C.repeats = stoll(argv[++i]);
+        } else if(arg == "--seed"){
+            C.seed = stoull(argv[++i]);
+        } else if(arg == "--tolerance"){
+            C.tolerance = stod(argv[++i]);
+        } else{
+            print_usage();
+            return -1;
+        }
+    }
+    if(datasets_given && !generate_given) C.generated.clear(); // Only the given datasets
+    if(C.csv_path == "" && C.json_path == ""){
+        cerr << "Error: give a results file with --csv or --json" << endl;
+        return -1;
+    }
+    if(C.repeats < 1 || C.n_queries < 1 || C.query_length < 1){
+        cerr << "Error: the number of repeats, queries and query characters must be at least 1" << endl;
+        return -1;
+    }
+    for(const string& formula : C.formulas) formula_args(formula); // Exits if invalid
+    for(const string& variant : C.variants) variant_args(variant);
+
+    // The binaries to run, by label. In regression mode the order alternates between repeats, so
+    // that drift in the speed of the machine affects both equally.
+    vector<pair<string, string>> binaries = {{"candidate", C.bin_dir}};
+    if(C.baseline_bin_dir != "") binaries.insert(binaries.begin(), {"baseline", C.baseline_bin_dir});
+    for(auto& binary : binaries){
+        for(const string& program : {C.build_binary, C.score_binary}){
+            if(access((binary.second + "/" + program).c_str(), X_OK) != 0){
+                cerr << "Error: " << binary.second << "/" << program << " is not an executable" << endl;
+                return -1;
+            }
+        }
+    }
+
+    vector<Dataset> datasets = prepare_datasets(C);
+    Results_Writer W(C.csv_path, C.json_path);
+    int64_t n_score_mismatches = 0;
+    for(const Dataset& D : datasets){
+        for(const string& formula : C.formulas){
+            for(const string& variant : C.variants){
+                for(int64_t repeat = 0; repeat < C.repeats; repeat++){
+                    cerr << "Running " << D.name << " " << formula << " " << variant << " repeat " << repeat << endl;
+                    map<string, map<string, string>> scores; // binary -> task -> score output
+                    for(int64_t b = 0; b < (int64_t)binaries.size(); b++){
+                        auto& binary = binaries[repeat % 2 == 0 ? b : binaries.size() - 1 - b];
+                        scores[binary.first] = run_configuration(C, W, binary.first, binary.second, D, formula, variant, repeat);
+                    }
+                    if(binaries.size() < 2) continue;
+                    for(auto& task : scores["candidate"]){
+                        if(scores["baseline"].count(task.first) && scores["baseline"][task.first] != task.second){
+                            cerr << "Warning: the scores of " << D.name << " " << formula << " " << variant << " " << task.first << " differ between the binaries" << endl;
+                            n_score_mismatches++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if(binaries.size() < 2) return 0;
+    int64_t n_regressions = print_comparison(C, W.rows);
+    cerr << n_regressions << " regressions beyond the tolerance of " << C.tolerance << ", " << n_score_mismatches << " runs with different scores" << endl;
+    return (n_regressions > 0 || n_score_mismatches > 0) ? 1 : 0;
+}
@@ -0,0 +1,436 @@
+//
+//  benchmarks.cpp
+//
+//  Microbenchmarks of the succinct building blocks of the model on synthetic DNA, protein and
+//  natural language inputs. Every operation is timed on every backend that supports it with the
+//  same queries, and the answers of the backends are checked against each other.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <map>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "BD_BWT_index/include/BD_BWT_index.hh"
+#include "globals.hh"
+#include "String_Depth_Support.hh"
+#include "LMA_Support.hh"
+#include "BPR_Colex_mapping.hh"
+#include "score_string.hh"
+#include "build_model.hh"
+#include "Basic_bitvector.hh"
+#include "RLE_bitvector.hh"
+#include "All_Ones_Bitvector.hh"
+#include "Compact_BPR_bitvector.hh"
+#include "InterleavedBWT.hh"
+#include "RLEBWT.hh"
+#include "synthetic_inputs.hh"
+
+using namespace std;
+
+// Last level cache misses of the calling thread from the hardware counters, if the kernel
+// allows reading them. Otherwise available() is false and the misses are reported as NA.
+class Cache_Miss_Counter{
+
+private:
+
+    Cache_Miss_Counter(const Cache_Miss_Counter&); // Prevent copy-construction
+    Cache_Miss_Counter& operator=(const Cache_Miss_Counter&);  // Prevent assignment
+
+    int fd;
+
+public:
+
+    Cache_Miss_Counter() : fd(-1) {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~Cache_Miss_Counter(){
+#ifdef __linux__
+        if(fd != -1) close(fd);
+#endif
+    }
+
+    bool available() const{
+        return fd != -1;
+    }
+
+    void start(){
+#ifdef __linux__
+        if(fd == -1) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    int64_t stop(){
+        int64_t count = 0;
+#ifdef __linux__
+        if(fd == -1) return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+        return count;
+    }
+};
+
+// Runs the benchmarks of one input and prints a row for each
+class Benchmark_Runner{
+
+private:
+
+    Cache_Miss_Counter cache_misses;
+    map<string, int64_t> checksums; // structure + operation -> checksum of the first backend
+
+public:
+
+    string input;
+    int64_t input_size;
+    int64_t repeats;
+
+    Benchmark_Runner(string input, int64_t input_size, int64_t repeats) : input(input), input_size(input_size), repeats(repeats) {}
+
+    static void print_header(){
+        cout << "# input\tinput_size\tstructure\tbackend\toperation\tops\tns_per_op\tcache_misses_per_op" << endl;
+    }
+
+    // f runs all queries and returns the sum of the answers. Prints the fastest of the repeats.
+    // Exits if a backend answers differently than the first backend of the same operation.
+    void run(string structure, string backend, string operation, int64_t n_ops, function<int64_t()> f){
+        double best_ns = 1e300;
+        int64_t best_misses = 0;
+        int64_t checksum = 0;
+        for(int64_t r = 0; r < repeats; r++){
+            cache_misses.start();
+            auto start = chrono::steady_clock::now();
+            checksum = f();
+            auto end = chrono::steady_clock::now();
+            int64_t misses = cache_misses.stop();
+            double ns = chrono::duration<double, nano>(end - start).count();
+            if(ns < best_ns){
+                best_ns = ns;
+                best_misses = misses;
+            }
+        }
+
+        string key = structure + "\t" + operation;
+        if(checksums.count(key) == 0) checksums[key] = checksum;
+        else if(checksums[key] != checksum){
+            cerr << "Error: " << backend << " answers " << structure << " " << operation << " differently than the other backends" << endl;
+            exit(-1);
+        }
+
+        cout << input << "\t" << input_size << "\t" << structure << "\t" << backend << "\t" << operation << "\t" << n_ops << "\t" << best_ns / n_ops << "\t";
+        if(cache_misses.available()) cout << (double)best_misses / n_ops << endl;
+        else cout << "NA" << endl;
+    }
+};
+
+vector<int64_t> ones_of(Bitvector& B){
+    vector<int64_t> ones;
+    for(int64_t i = 0; i < B.size(); i++) if(B.at(i)) ones.push_back(i);
+    return ones;
+}
+
+template<typename T>
+vector<T> sample(const vector<T>& values, int64_t n, mt19937_64& rng){
+    vector<T> result(n);
+    for(T& x : result) x = values[rng() % values.size()];
+    return result;
+}
+
+// A search walk: the characters of the substring of length length starting at start, searched
+// one by one from the whole BWT of the reverse of the text
+struct Search_Walk{
+    int64_t start, length;
+};
+
+template<typename bwt_t>
+int64_t run_walks(bwt_t& index, const string& T, const vector<Search_Walk>& walks){
+    int64_t checksum = 0;
+    for(const Search_Walk& W : walks){
+        Interval I(0, index.size() - 1);
+        for(int64_t i = 0; i < W.length; i++) I = index.search(I, T[W.start + i]);
+        checksum += I.left + I.right;
+    }
+    return checksum;
+}
+
+template<typename bwt_t>
+void bench_bwt(Benchmark_Runner& R, string backend, const string& T, const vector<Search_Walk>& walks, int64_t n_searches){
+    string reversed(T.rbegin(), T.rend());
+    bwt_t index;
+    index.init_from_text((const uint8_t*)reversed.c_str());
+    R.run("reverse_bwt", backend, "search", n_searches, [&](){ return run_walks(index, T, walks); });
+}
+
+// The same queries for every backend of a bit vector
+struct Bitvector_Queries{
+    vector<int64_t> positions, ranks; // For rank and select
+    vector<int64_t> opens, non_root_opens; // For find_close and enclose
+    vector<pair<int64_t,int64_t>> open_pairs; // For double_enclose
+
+    // B must have rank and select support, and bps support if it is a BPR. The parenthesis
+    // queries are made only for a BPR. The pairs of double_enclose are disjoint subtrees near
+    // each other, like the leaves of a search interval.
+    Bitvector_Queries(Bitvector& B, bool bpr, int64_t n_ops, mt19937_64& rng) : positions(n_ops), ranks(n_ops){
+        int64_t n = B.size();
+        int64_t n_ones = B.rank(n);
+        for(int64_t& x : positions) x = rng() % (n + 1);
+        for(int64_t& x : ranks) x = 1 + rng() % n_ones;
+        if(!bpr) return;
+
+        vector<int64_t> all_opens = ones_of(B);
+        opens = sample(all_opens, n_ops, rng);
+        for(int64_t x : opens) if(x != 0) non_root_opens.push_back(x);
+        while((int64_t)open_pairs.size() < n_ops){
+            int64_t first = all_opens[1 + rng() % (all_opens.size() - 1)];
+            int64_t l = upper_bound(all_opens.begin(), all_opens.end(), B.find_close(first)) - all_opens.begin();
+            l += rng() % 16;
+            if(l < (int64_t)all_opens.size()) open_pairs.push_back({first, all_opens[l]});
+        }
+    }
+};
+
+// Rank and select on any backend, and the parenthesis operations if bps is true
+template<typename bitvector_t>
+void bench_bitvector(Benchmark_Runner& R, string structure, string backend, bitvector_t& B, bool bps, const Bitvector_Queries& Q){
+    R.run(structure, backend, "rank", Q.positions.size(), [&](){ int64_t s = 0; for(int64_t x : Q.positions) s += B.rank(x); return s; });
+    R.run(structure, backend, "select", Q.ranks.size(), [&](){ int64_t s = 0; for(int64_t x : Q.ranks) s += B.select(x); return s; });
+    if(!bps) return;
+
+    R.run(structure, backend, "find_close", Q.opens.size(), [&](){ int64_t s = 0; for(int64_t x : Q.opens) s += B.find_close(x); return s; });
+    R.run(structure, backend, "enclose", Q.non_root_opens.size(), [&](){ int64_t s = 0; for(int64_t x : Q.non_root_opens) s += B.enclose(x); return s; });
+    R.run(structure, backend, "double_enclose", Q.open_pairs.size(), [&](){
+        int64_t s = 0;
+        for(auto& p : Q.open_pairs) s += B.double_enclose(p.first, p.second);
+        return s;
+    });
+}
+
+template<typename bpr_t, typename pruning_t>
+void bench_mapper(Benchmark_Runner& R, string structure, string backend, shared_ptr<bpr_t> bpr, shared_ptr<pruning_t> pruning_marks,
+                  const vector<Interval>& intervals, const vector<int64_t>& nodes){
+    Pruned_Topology_Mapper_Template<bpr_t, pruning_t> mapper(bpr, pruning_marks);
+    R.run(structure, backend, "leaves_to_node", intervals.size(), [&](){ int64_t s = 0; for(const Interval& I : intervals) s += mapper.leaves_to_node(I); return s; });
+    R.run(structure, backend, "node_to_leaves", nodes.size(), [&](){
+        int64_t s = 0;
+        for(int64_t v : nodes){
+            Interval I = mapper.node_to_leaves(v);
+            s += I.left + I.right;
+        }
+        return s;
+    });
+}
+
+template<typename lma_support_t>
+void bench_lma(Benchmark_Runner& R, string backend, lma_support_t& LMAS, const vector<int64_t>& nodes){
+    R.run("rev_st_context_marks", backend, "lma", nodes.size(), [&](){ int64_t s = 0; for(int64_t v : nodes) s += LMAS.LMA(v); return s; });
+}
+
+template<typename string_depth_support_t>
+void bench_string_depth(Benchmark_Runner& R, string backend, string_depth_support_t& SDS, const vector<int64_t>& maxreps){
+    R.run("rev_st_maximal_marks", backend, "string_depth", maxreps.size(), [&](){ int64_t s = 0; for(int64_t v : maxreps) s += SDS.string_depth(v); return s; });
+}
+
+template<typename bitvector_t>
+shared_ptr<bitvector_t> copy_of(Bitvector& B){
+    sdsl::bit_vector bits(B.size());
+    for(int64_t i = 0; i < B.size(); i++) bits[i] = B.at(i);
+    return make_shared<bitvector_t>(bits);
+}
+
+shared_ptr<Basic_bitvector> basic_copy_of(Bitvector& B, bool bps){
+    shared_ptr<Basic_bitvector> C = copy_of<Basic_bitvector>(B);
+    C->init_rank_support();
+    C->init_select_support();
+    if(bps){
+        C->init_rank_10_support();
+        C->init_select_10_support();
+        C->init_bps_support();
+    }
+    return C;
+}
+
+void run_input(string input, string T, int64_t n_ops, int64_t repeats, mt19937_64& rng){
+    Benchmark_Runner R(input, T.size(), repeats);
+
+    // Models with the full topology and with the maxrep-pruned topology
+    Global_Data G_full, G_pruned;
+    {
+        SLT_Iterator slt_it;
+        Rev_ST_Iterator rev_st_it;
+        Entropy_Formula formula(0.05);
+        build_model(G_full, T, formula, slt_it, rev_st_it);
+    }
+    {
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Entropy_Formula formula(0.05);
+        build_model(G_pruned, T, formula, slt_it, rev_st_it);
+    }
+
+    // BWT::search
+    vector<Search_Walk> walks;
+    int64_t n_searches = 0;
+    while(n_searches < n_ops){
+        Search_Walk W;
+        W.length = min((int64_t)T.size(), (int64_t)(1 + rng() % 24));
+        W.start = rng() % (T.size() - W.length + 1);
+        walks.push_back(W);
+        n_searches += W.length;
+    }
+    bench_bwt<Basic_BWT<>>(R, "Basic_BWT", T, walks, n_searches);
+    bench_bwt<RLEBWT<>>(R, "RLEBWT", T, walks, n_searches);
+    bench_bwt<Interleaved_BWT>(R, "Interleaved_BWT", T, walks, n_searches);
+
+    // Bitvector operations on the same bits in every backend. The run-length coded and the
+    // all-ones vectors have no parenthesis operations, so those are compared against the
+    // compact BPR instead.
+    shared_ptr<Basic_bitvector> bpr = basic_copy_of(*G_full.rev_st_bpr, true);
+    shared_ptr<RLE_bitvector> rle_bpr = copy_of<RLE_bitvector>(*bpr);
+    shared_ptr<Compact_BPR_bitvector> compact_bpr = copy_of<Compact_BPR_bitvector>(*bpr);
+    Bitvector_Queries bpr_queries(*bpr, true, n_ops, rng);
+    bench_bitvector(R, "rev_st_bpr", "Basic_bitvector", *bpr, true, bpr_queries);
+    bench_bitvector(R, "rev_st_bpr", "RLE_bitvector", *rle_bpr, false, bpr_queries);
+    bench_bitvector(R, "rev_st_bpr", "Compact_BPR_bitvector", *compact_bpr, true, bpr_queries);
+
+    shared_ptr<Basic_bitvector> pruning_marks = basic_copy_of(*G_pruned.pruning_marks, false);
+    shared_ptr<RLE_bitvector> rle_pruning_marks = copy_of<RLE_bitvector>(*pruning_marks);
+    Bitvector_Queries pruning_queries(*pruning_marks, false, n_ops, rng);
+    bench_bitvector(R, "pruning_marks", "Basic_bitvector", *pruning_marks, false, pruning_queries);
+    bench_bitvector(R, "pruning_marks", "RLE_bitvector", *rle_pruning_marks, false, pruning_queries);
+
+    shared_ptr<All_Ones_Bitvector> all_ones = make_shared<All_Ones_Bitvector>(G_full.pruning_marks->size());
+    shared_ptr<Basic_bitvector> basic_all_ones = basic_copy_of(*all_ones, false);
+    shared_ptr<RLE_bitvector> rle_all_ones = copy_of<RLE_bitvector>(*all_ones);
+    Bitvector_Queries all_ones_queries(*all_ones, false, n_ops, rng);
+    bench_bitvector(R, "all_ones", "Basic_bitvector", *basic_all_ones, false, all_ones_queries);
+    bench_bitvector(R, "all_ones", "RLE_bitvector", *rle_all_ones, false, all_ones_queries);
+    bench_bitvector(R, "all_ones", "All_Ones_Bitvector", *all_ones, false, all_ones_queries);
+
+    // Pruned_Topology_Mapper. The intervals are those of the search walks, like in scoring.
+    vector<Interval> intervals;
+    for(const Search_Walk& W : walks){
+        Interval I(0, G_full.revbwt->size() - 1);
+        for(int64_t i = 0; i < W.length; i++) I = G_full.revbwt->search(I, T[W.start + i]);
+        intervals.push_back(I);
+    }
+    intervals = sample(intervals, n_ops, rng);
+
+    vector<int64_t> full_nodes = sample(ones_of(*bpr), n_ops, rng);
+    bench_mapper(R, "full_topology", "Basic_bitvector+All_Ones_Bitvector", bpr, all_ones, intervals, full_nodes);
+    bench_mapper(R, "full_topology", "Compact_BPR_bitvector+All_Ones_Bitvector", compact_bpr, all_ones, intervals, full_nodes);
+
+    shared_ptr<Basic_bitvector> pruned_bpr = basic_copy_of(*G_pruned.rev_st_bpr, true);
+    shared_ptr<Compact_BPR_bitvector> compact_pruned_bpr = copy_of<Compact_BPR_bitvector>(*pruned_bpr);
+    vector<int64_t> pruned_nodes = sample(ones_of(*pruned_bpr), n_ops, rng);
+    bench_mapper(R, "pruned_topology", "Basic_bitvector+Basic_bitvector", pruned_bpr, pruning_marks, intervals, pruned_nodes);
+    bench_mapper(R, "pruned_topology", "Basic_bitvector+RLE_bitvector", pruned_bpr, rle_pruning_marks, intervals, pruned_nodes);
+    bench_mapper(R, "pruned_topology", "Compact_BPR_bitvector+Basic_bitvector", compact_pruned_bpr, pruning_marks, intervals, pruned_nodes);
+
+    // LMA_Support on the full topology
+    shared_ptr<Basic_bitvector> context_marks = basic_copy_of(*G_full.rev_st_context_marks, false);
+    shared_ptr<Basic_bitvector> bpr_context_only = basic_copy_of(*G_full.rev_st_bpr_context_only, true);
+    shared_ptr<Compact_BPR_bitvector> compact_bpr_context_only = copy_of<Compact_BPR_bitvector>(*bpr_context_only);
+    shared_ptr<LMA_Pointer_Table> pointers = make_shared<LMA_Pointer_Table>();
+    pointers->build(*context_marks, *bpr_context_only, 0);
+    if(bpr_context_only->size() > 0){
+        LMA_Support_Template<Basic_bitvector, Basic_bitvector> basic_lma(context_marks, bpr_context_only);
+        LMA_Support_Template<Basic_bitvector, Compact_BPR_bitvector> compact_lma(context_marks, compact_bpr_context_only);
+        LMA_Support_Template<Basic_bitvector, Basic_bitvector> pointer_lma(context_marks, bpr_context_only, pointers);
+        bench_lma(R, "Basic_bitvector", basic_lma, full_nodes);
+        bench_lma(R, "Compact_BPR_bitvector", compact_lma, full_nodes);
+        bench_lma(R, "Basic_bitvector+LMA_Pointer_Table", pointer_lma, full_nodes);
+    }
+
+    // String_Depth_Support on the full topology. The stored depths are those given by the SLT.
+    shared_ptr<Basic_bitvector> maximal_marks = basic_copy_of(*G_full.rev_st_maximal_marks, false);
+    shared_ptr<Basic_bitvector> slt_bpr = basic_copy_of(*G_full.slt_bpr, false);
+    shared_ptr<Basic_bitvector> slt_maximal_marks = basic_copy_of(*G_full.slt_maximal_marks, false);
+    shared_ptr<RLE_bitvector> rle_slt_bpr = copy_of<RLE_bitvector>(*slt_bpr);
+    shared_ptr<RLE_bitvector> rle_slt_maximal_marks = copy_of<RLE_bitvector>(*slt_maximal_marks);
+    String_Depth_Support_SLT_Template<Basic_bitvector, Basic_bitvector> basic_slt_depths(bpr, slt_bpr, maximal_marks, slt_maximal_marks);
+    String_Depth_Support_SLT_Template<Basic_bitvector, RLE_bitvector> rle_slt_depths(bpr, rle_slt_bpr, maximal_marks, rle_slt_maximal_marks);
+
+    vector<int64_t> all_maxreps = ones_of(*maximal_marks);
+    shared_ptr<sdsl::int_vector<0>> depths = make_shared<sdsl::int_vector<0>>(all_maxreps.size());
+    for(int64_t i = 0; i < (int64_t)all_maxreps.size(); i++) (*depths)[i] = basic_slt_depths.string_depth(all_maxreps[i]);
+    sdsl::util::bit_compress(*depths);
+    String_Depth_Support_Store_All_Template<Basic_bitvector> stored_depths(depths, maximal_marks);
+
+    vector<int64_t> maxreps = sample(all_maxreps, n_ops, rng);
+    bench_string_depth(R, "SLT:Basic_bitvector", basic_slt_depths, maxreps);
+    bench_string_depth(R, "SLT:RLE_bitvector", rle_slt_depths, maxreps);
+    bench_string_depth(R, "Store_All:Basic_bitvector", stored_depths, maxreps);
+}
+
+int main(int argc, char** argv){
+
+    int64_t size = 1000000;
+    int64_t n_ops = 1000000;
+    int64_t repeats = 3;
+    uint64_t seed = 1;
+    vector<string> inputs = {"dna", "protein", "text"};
+    for(int64_t i = 1; i < argc; i++){
+        if(argv[i] == string("--size") && i + 1 < argc){
+            size = stoll(argv[++i]);
+        } else if(argv[i] == string("--ops") && i + 1 < argc){
+            n_ops = stoll(argv[++i]);
+        } else if(argv[i] == string("--repeats") && i + 1 < argc){
+            repeats = stoll(argv[++i]);
+        } else if(argv[i] == string("--seed") && i + 1 < argc){
+            seed = stoull(argv[++i]);
+        } else if(argv[i] == string("--inputs") && i + 1 < argc){
+            inputs.clear();
+            stringstream ss(argv[++i]);
+            string name;
+            while(getline(ss, name, ',')) inputs.push_back(name);
+        } else{
+            cerr << "Microbenchmarks of the succinct data structures on synthetic inputs" << endl;
+            cerr << "Usage: benchmarks (--size [characters]) (--ops [queries per benchmark]) (--repeats [number]) (--seed [number]) (--inputs [comma-separated subset of dna,protein,text])" << endl;
+            return -1;
+        }
+    }
+    if(size < 2 || n_ops < 1 || repeats < 1){
+        cerr << "Error: the size must be at least 2 and the number of queries and repeats at least 1" << endl;
+        return -1;
+    }
+    for(string input : inputs){
+        if(input != "dna" && input != "protein" && input != "text"){
+            cerr << "Error: unknown input " << input << endl;
+            return -1;
+        }
+    }
+
+    cout << "# size " << size << ", ops " << n_ops << ", repeats " << repeats << ", seed " << seed << ", fastest repeat reported" << endl;
+    Benchmark_Runner::print_header();
+    for(string input : inputs){
+        // Every input has its own generator, so that its results do not depend on the other inputs
+        mt19937_64 rng(seed);
+        run_input(input, generate_input(input, size, rng), n_ops, repeats, rng);
+    }
+
+    return 0;
+}
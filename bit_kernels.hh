@@ -0,0 +1,77 @@
+#ifndef BIT_KERNELS_HH
+#define BIT_KERNELS_HH
+
+#include "sdsl/bit_vectors.hpp"
+#include <cstdint>
+#include <algorithm>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Operations on whole 64-bit words of sdsl::bit_vectors. Bit i of a bit vector is bit i % 64 of word i / 64.
+
+// The bits of x at the positions of the ones of mask, packed to the lowest bits. One instruction
+// with BMI2 (-march=native on CPUs that have it), otherwise a loop over the ones of the mask.
+inline uint64_t pext64(uint64_t x, uint64_t mask){
+#ifdef __BMI2__
+    return _pext_u64(x, mask);
+#else
+    uint64_t result = 0;
+    for(uint64_t bit = 1; mask != 0; bit <<= 1){
+        if(x & mask & -mask) result |= bit;
+        mask &= mask - 1; // Clear the lowest one
+    }
+    return result;
+#endif
+}
+
+// Word i of v with the bits beyond the end of v cleared
+inline uint64_t get_word(const sdsl::bit_vector& v, int64_t i){
+    uint64_t w = v.data()[i];
+    int64_t end = (int64_t)v.size() - i * 64;
+    if(end < 64) w &= (((uint64_t)1) << end) - 1;
+    return w;
+}
+
+// ORs the lowest k bits of x into positions [pos, pos + k) of words. The bits of x above k must be zero.
+inline void or_bits(uint64_t* words, int64_t pos, uint64_t x, int64_t k){
+    if(k == 0) return;
+    int64_t offset = pos % 64;
+    words[pos / 64] |= x << offset;
+    if(offset + k > 64) words[pos / 64 + 1] |= x >> (64 - offset);
+}
+
+// Sets positions [begin, end) of v to one
+inline void set_ones(sdsl::bit_vector& v, int64_t begin, int64_t end){
+    if(begin >= end) return;
+    uint64_t* words = v.data();
+    int64_t first = begin / 64, last = (end - 1) / 64;
+    uint64_t first_mask = ~(uint64_t)0 << (begin % 64);
+    uint64_t last_mask = ~(uint64_t)0 >> (63 - (end - 1) % 64);
+    if(first == last){
+        words[first] |= first_mask & last_mask;
+        return;
+    }
+    words[first] |= first_mask;
+    std::fill(words + first + 1, words + last, ~(uint64_t)0);
+    words[last] |= last_mask;
+}
+
+// The bits of bits at the positions of the ones of mask, in order. The vectors have the same length.
+inline sdsl::bit_vector compact_under_mask(const sdsl::bit_vector& bits, const sdsl::bit_vector& mask){
+    assert(bits.size() == mask.size());
+    int64_t n_words = (bits.size() + 63) / 64;
+    int64_t n_ones = 0;
+    for(int64_t i = 0; i < n_words; i++) n_ones += __builtin_popcountll(get_word(mask, i));
+    sdsl::bit_vector result(n_ones, 0);
+    int64_t pos = 0;
+    for(int64_t i = 0; i < n_words; i++){
+        uint64_t m = get_word(mask, i);
+        int64_t k = __builtin_popcountll(m);
+        or_bits(result.data(), pos, pext64(bits.data()[i], m), k);
+        pos += k;
+    }
+    return result;
+}
+
+#endif
@@ -20,12 +20,19 @@
 #include "BPR_tools.hh"
 #include "Precalc.hh"
 #include "input_reading.hh"
+#include "reference_reading.hh"
+#include "semi_external_bwt.hh"
 #include "score_string.hh"
 #include "build_model.hh"
 #include "logging.hh"
 
 #define HUGE_NUMBER 1e18
 
+// Approximate peak memory of reading the reference and building BD_BWT_index(const uint8_t*)
+// per character of the reference (measured on DNA). Used to decide whether to build
+// semi-externally when there is a memory budget.
+const int64_t IN_MEMORY_BIBWT_BYTES_PER_CHAR = 13;
+
 using namespace std;
 
 vector<string> split(string s, char delimiter){
@@ -40,21 +47,6 @@ vector<string> split(string s, char delimiter){
     return seglist;
 }
 
-string read_raw_file(string filename){
-
-    std::ifstream t(filename.c_str());
-    std::string str;
-
-    t.seekg(0, std::ios::end);   
-    str.reserve(t.tellg());
-    t.seekg(0, std::ios::beg);
-
-    str.assign((std::istreambuf_iterator<char>(t)),
-                std::istreambuf_iterator<char>());
-    
-    return str;
-}
-
 class Build_Time_Config{
     
 private:
@@ -72,15 +64,26 @@ public:
     Context_Type context_type;
     string outputdir;
     string input_filename;
+    bool input_is_fasta;
+    bool semi_external;
+    string scratch_dir; // Empty means the output directory
+    int64_t memory_budget; // Bytes. 0 means no budget.
     bool run_length_encoding;
     bool store_depths;
+    bool context_counts;
+    bool single_file;
+    bool compact_topology;
+    int64_t lma_sample_shift; // -1 means no LMA pointer table
+    Model_Profile profile;
+    int64_t n_threads;
+    BWT_Layout bwt_layout;
     
     Context_Callback* cf;
     
     Iterator* rev_st_it;
     Iterator* slt_it;
     
-    Build_Time_Config() : context_stats(false), only_maxreps(false), depth_bound(HUGE_NUMBER), context_type(UNDEFINED), run_length_encoding(false), store_depths(false),
+    Build_Time_Config() : context_stats(false), only_maxreps(false), depth_bound(HUGE_NUMBER), context_type(UNDEFINED), input_is_fasta(false), semi_external(false), memory_budget(0), run_length_encoding(false), store_depths(false), context_counts(false), single_file(false), compact_topology(false), lma_sample_shift(-1), profile(Model_Profile::FULL), n_threads(1), bwt_layout(BWT_Layout::DEFAULT),
                           cf(nullptr), rev_st_it(nullptr), slt_it(nullptr) {}
     
     ~Build_Time_Config(){
@@ -135,18 +138,16 @@ int build_model_main(int argc, char** argv){
     Build_Time_Config C;
     
     vector<string> queries;
-    string reference;
     for(int64_t i = 1; i < argc; i++){
         if(argv[i] == string("--reference-raw")){
             i++;
-            reference = read_raw_file(argv[i]);
             C.input_filename = argv[i];
+            C.input_is_fasta = false;
         } else if(argv[i] == string("--reference-fasta")){
             // Concatenate all reads in fasta
             i++;
-            auto v = parse_FASTA(argv[i]);
-            for(auto pair : v) reference += pair.first;
             C.input_filename = argv[i];
+            C.input_is_fasta = true;
         } else if(argv[i] == string("--maxreps-pruning")){
             C.rev_st_it = new Rev_ST_Maxrep_Iterator();
             C.slt_it = new SLT_Iterator();
@@ -192,6 +193,52 @@ int build_model_main(int argc, char** argv){
             C.context_stats = true;
         } else if(argv[i] == string("--store-depths")){
             C.store_depths = true;
+        } else if(argv[i] == string("--context-counts")){
+            C.context_counts = true;
+        } else if(argv[i] == string("--single-file")){
+            C.single_file = true;
+        } else if(argv[i] == string("--compact-topology")){
+            C.compact_topology = true;
+        } else if(argv[i] == string("--lma-pointers")){
+            i++;
+            int64_t rate = stoll(argv[i]);
+            if(rate < 1 || (rate & (rate - 1)) != 0){
+                cerr << "Error: the sample rate of --lma-pointers must be a power of two" << endl;
+                return -1;
+            }
+            C.lma_sample_shift = 0;
+            while((1LL << C.lma_sample_shift) < rate) C.lma_sample_shift++;
+        } else if(argv[i] == string("--profile")){
+            i++;
+            try{
+                C.profile = parse_model_profile(argv[i]);
+            } catch(const std::runtime_error& e){
+                cerr << e.what() << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--bwt-layout")){
+            i++;
+            if(argv[i] == string("default")) C.bwt_layout = BWT_Layout::DEFAULT;
+            else if(argv[i] == string("interleaved")) C.bwt_layout = BWT_Layout::INTERLEAVED;
+            else{
+                cerr << "Invalid BWT layout: " << argv[i] << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--semi-external")){
+            C.semi_external = true;
+        } else if(argv[i] == string("--scratch-dir")){
+            i++;
+            C.scratch_dir = argv[i];
+        } else if(argv[i] == string("--memory-budget")){
+            i++;
+            C.memory_budget = stoll(argv[i]) * (1LL << 20); // Megabytes
+        } else if(argv[i] == string("--threads")){
+            i++;
+            C.n_threads = stoll(argv[i]);
+            if(C.n_threads < 1){
+                cerr << "Error: number of threads must be at least 1" << endl;
+                return -1;
+            }
         } else{
             cerr << "Invalid argument: " << argv[i] << endl;
             return -1;
@@ -207,20 +254,97 @@ int build_model_main(int argc, char** argv){
     C.assert_all_ok();
     
     string filename = split(C.input_filename,'/').back();
+    if(C.scratch_dir == "") C.scratch_dir = C.outputdir;
+    
+    Reference_Reader reader(C.input_filename);
+    if(!C.semi_external && C.memory_budget > 0){
+        int64_t estimate = reader.estimate_size() * IN_MEMORY_BIBWT_BYTES_PER_CHAR;
+        if(estimate > C.memory_budget){
+            write_log("Estimated memory for building the BiBWT in memory is " + to_string(estimate >> 20) + " MB, which exceeds the budget. Using semi-external construction.");
+            C.semi_external = true;
+        }
+    }
+    
     write_log("Starting to build the model");
     Global_Data G;
     Stats_writer wr;
     if(C.context_stats){
         wr.set_file(C.outputdir + "/stats.depths_and_scores.txt");
     }
-    build_model(G, reference, *C.cf, *C.slt_it, *C.rev_st_it, C.run_length_encoding, C.store_depths, wr);
+    
+    Build_Options options;
+    options.run_length_coding = C.run_length_encoding;
+    options.compute_string_depths = C.store_depths;
+    options.stats_writer = &wr;
+    options.n_threads = C.n_threads;
+    options.bwt_layout = C.bwt_layout;
+    
+    if(C.semi_external){
+        // The reference goes straight to the scratch space and is never held in memory
+        string text_path = C.scratch_dir + "/" + filename + ".vomm_scratch_text";
+        int64_t length;
+        {
+            Text_File_Writer writer(text_path);
+            if(C.input_is_fasta) reader.append_FASTA(writer);
+            else reader.append_raw(writer);
+            length = writer.size();
+            writer.close();
+        }
+        write_log("Read a reference of " + to_string(length) + " characters");
+        write_log("Building the BiBWT semi-externally in " + C.scratch_dir);
+        std::shared_ptr<BD_BWT_index<>> bibwt = make_shared<BD_BWT_index<>>();
+        build_bibwt_semi_external(*bibwt, text_path, C.scratch_dir);
+        G.bibwt = bibwt;
+        write_peak_memory_log();
+        build_model_from_bibwt(G, *C.cf, *C.slt_it, *C.rev_st_it, options);
+    } else{
+        string reference;
+        if(C.input_is_fasta) reader.read_FASTA(reference);
+        else reader.read_raw(reference);
+        write_log("Read a reference of " + to_string(reference.size()) + " characters");
+        write_peak_memory_log();
+        build_model(G, reference, *C.cf, *C.slt_it, *C.rev_st_it, options);
+    }
+    
     if(C.context_stats){ 
         write_context_summary(G, C.cf->get_number_of_candidates(), C.outputdir + "/stats.context_summary.txt");
     }
+    if(C.context_counts){
+        write_log("Building the context count table");
+        build_context_counts(G);
+        write_log("Context count table: " + to_string(G.context_counts->number_of_contexts()) + " contexts, "
+                  + to_string(G.context_counts->alphabet.size()) + " symbols, " + to_string(G.context_counts->size_in_bytes()) + " bytes");
+    }
+    if(C.lma_sample_shift != -1){
+        build_lma_pointers(G, C.lma_sample_shift);
+        write_log("LMA pointer table with sample rate " + to_string(1LL << C.lma_sample_shift) + ": "
+                  + to_string(G.rev_st_lma_pointers->size_in_bytes()) + " bytes");
+    }
+    if(C.compact_topology){
+        compact_rev_st_bprs(G);
+        int64_t bytes = static_pointer_cast<Compact_BPR_bitvector>(G.rev_st_bpr)->size_in_bytes()
+                      + static_pointer_cast<Compact_BPR_bitvector>(G.rev_st_bpr_context_only)->size_in_bytes();
+        write_log("Compacted the reverse suffix tree BPRs to " + to_string(bytes) + " bytes");
+    }
     write_log("Writing model to directory: " + C.outputdir);
     
-    G.store_all_to_disk(C.outputdir, filename);
+    map<string, int64_t> sizes;
+    if(C.single_file){
+        string path = C.outputdir + "/" + filename + ".model";
+        G.store_all_to_container(path, C.profile);
+        sizes = G.container_size_breakdown(path, C.profile);
+    } else{
+        G.store_all_to_disk(C.outputdir, filename, C.profile);
+        sizes = G.disk_size_breakdown(C.outputdir, filename, C.profile);
+    }
+    int64_t total = 0;
+    for(auto& keyval : sizes){
+        write_log("Size of " + keyval.first + ": " + to_string(keyval.second) + " bytes");
+        total += keyval.second;
+    }
+    write_log("Total size with profile " + model_profile_to_string(C.profile) + ": " + to_string(total) + " bytes");
     C.write_to_file(C.outputdir, filename + ".info");
+    write_peak_memory_log();
     
     return 0;
 }
@@ -13,14 +13,21 @@
 #include "BPR_Colex_mapping.hh"
 #include "UniBWT.h"
 #include "RLEBWT.hh"
+#include "InterleavedBWT.hh"
 #include "Basic_bitvector.hh"
 #include "RLE_bitvector.hh"
+#include "Compact_BPR_bitvector.hh"
 #include "logging.hh"
+#include "parallel_traversal.hh"
 #include "build_model.hh"
 #include <stack>
 #include <vector>
 #include <memory>
 
+// How the reverse BWT that is used for scoring is stored. DEFAULT is a wavelet tree,
+// or run-length coded if run_length_coding is set.
+enum class BWT_Layout {DEFAULT, INTERLEAVED};
+
 bool is_all_ones(sdsl::bit_vector& v){
     for(int64_t i = 0; i < v.size(); i++){
         if(v[i] == 0) return false;
@@ -28,30 +35,8 @@ bool is_all_ones(sdsl::bit_vector& v){
     return true;
 }
 
-// All components of the model will be stored into G
-// T: reference string
-// context_formula: a callback for context marking
-// slt_it: iterator that gives all nodes that we want in the SLT
-// rev_st_it: iterator that gives all nodes that we want in the rev ST
-// run_length_coding: self-explatonary
-// compute_string_depths: Get precomputed string depths
-// wr: where to write context stats
-
-void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
-                 Iterator& slt_it, Iterator& rev_st_it, bool run_length_coding, bool compute_string_depths, Stats_writer& wr){
-        
-    
-    write_log("Building the BiBWT");
-    G.bibwt = make_shared<BD_BWT_index<>>((uint8_t*)T.c_str());
-    
-    slt_it.set_index(G.bibwt.get());
-    rev_st_it.set_index(G.bibwt.get());
-    
-    write_log("Building reverse suffix tree BPR and pruning marks");
-    Build_REV_ST_BPR_And_Pruning_Callback revstbprcb;
-    revstbprcb.init(*G.bibwt);
-    iterate_with_callbacks(rev_st_it, &revstbprcb);
-    Rev_st_topology RSTT = revstbprcb.get_result();
+// Stores the rev st BPR and the pruning marks into G
+void store_rev_st_topology(Global_Data& G, Rev_st_topology& RSTT, bool run_length_coding){
     G.rev_st_bpr = std::shared_ptr<Bitvector>(new Basic_bitvector(RSTT.bpr));
     
     G.rev_st_bpr->init_rank_10_support();
@@ -72,21 +57,9 @@ void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
     
     G.pruning_marks->init_rank_support();
     G.pruning_marks->init_select_support();
-    
-    Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
-    
-    sdsl::bit_vector sdsl_slt_bpr; // Assigned to later if compute_string_depths is false
-    
-    if(!compute_string_depths) write_log("Building SLT BPR");
-    Build_SLT_BPR_Callback sltbprcb;
-    
-    if(compute_string_depths) sltbprcb.disable();
-    else sltbprcb.enable();
-    
-    sltbprcb.init(*G.bibwt);
-    iterate_with_callbacks(slt_it, &sltbprcb);
-    sdsl_slt_bpr = sltbprcb.get_result(); // Returns empty if disabled
-    
+}
+
+void store_slt_bpr(Global_Data& G, sdsl::bit_vector& sdsl_slt_bpr, bool run_length_coding, bool compute_string_depths){
     if(run_length_coding){
         if(!compute_string_depths) write_log("Run length coding SLT BPR");
         G.slt_bpr = make_shared<RLE_bitvector>(sdsl_slt_bpr);
@@ -95,30 +68,165 @@ void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
     }
     
     G.slt_bpr->init_rank_support();
+}
+
+void build_context_counts(Global_Data& G){
+    Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+    G.context_counts = make_shared<Context_Count_Table>();
+    G.context_counts->build(*G.revbwt, G.rev_st_bpr, G.rev_st_context_marks, mapper);
+}
+
+// sample_shift: the table stores every 2^sample_shift-th answer (see LMA_Pointer_Table)
+void build_lma_pointers(Global_Data& G, int64_t sample_shift){
+    G.rev_st_lma_pointers = make_shared<LMA_Pointer_Table>();
+    G.rev_st_lma_pointers->build(*G.rev_st_context_marks, *G.rev_st_bpr_context_only, sample_shift);
+}
+
+// Replaces the contexts of G. The BPR of contexts only, and the context count table and the
+// LMA pointer table if G has them, are built again from the new marks.
+void set_context_marks(Global_Data& G, const sdsl::bit_vector& marks){
+    G.rev_st_context_marks = std::shared_ptr<Bitvector>(new Basic_bitvector(marks));
+    G.rev_st_context_marks->init_rank_support();
+    G.rev_st_context_marks->init_select_support();
+    
+    if(dynamic_cast<Compact_BPR_bitvector*>(G.rev_st_bpr.get())){
+        G.rev_st_bpr_context_only = make_shared<Compact_BPR_bitvector>(get_rev_st_bpr_context_only(&G)); // Same type as rev_st_bpr
+    } else{
+        G.rev_st_bpr_context_only = std::shared_ptr<Bitvector>(new Basic_bitvector(get_rev_st_bpr_context_only(&G)));
+        G.rev_st_bpr_context_only->init_bps_support();
+    }
+    
+    if(G.context_counts != nullptr) build_context_counts(G);
+    if(G.rev_st_lma_pointers != nullptr) build_lma_pointers(G, G.rev_st_lma_pointers->sample_shift);
+}
+
+// Replaces both BPRs of the reverse suffix tree with Compact_BPR_bitvectors. Call this after
+// everything that is built from the model. The bits are taken directly from the Basic_bitvectors
+// that the builders store.
+void compact_rev_st_bprs(Global_Data& G){
+    for(std::shared_ptr<Bitvector>* bpr : {&G.rev_st_bpr, &G.rev_st_bpr_context_only}){
+        if(dynamic_cast<Compact_BPR_bitvector*>(bpr->get())) continue; // Already compact
+        Basic_bitvector* B = dynamic_cast<Basic_bitvector*>(bpr->get());
+        assert(B != nullptr); // The builders store the BPRs as Basic_bitvectors
+        *bpr = make_shared<Compact_BPR_bitvector>(B->bv);
+    }
+}
+
+// If the SLT and the rev st iterators are the depth-bounded maxrep iterators with the same depth
+// bound, everything can be computed in a single traversal with Fused_Maxrep_Iterator. The context
+// statistics need the topology while traversing, so they are written only in separate traversals.
+// Returns -1 if the traversal can not be fused, and the depth bound otherwise.
+int64_t get_fused_depth_bound(Iterator& slt_it, Iterator& rev_st_it, Stats_writer& wr){
+    Depth_Bounded_SLT_Iterator* slt = dynamic_cast<Depth_Bounded_SLT_Iterator*>(&slt_it);
+    Rev_ST_Depth_Bounded_Maxrep_Iterator* rev_st = dynamic_cast<Rev_ST_Depth_Bounded_Maxrep_Iterator*>(&rev_st_it);
+    if(slt == nullptr || rev_st == nullptr || slt->depth_bound != rev_st->depth_bound || wr.is_enabled()) return -1;
+    return slt->depth_bound;
+}
+
+// Options for build_model and build_model_from_bibwt. The defaults build a plain model in one thread.
+class Build_Options{
+public:
+    
+    bool run_length_coding; // Run length code the BWT and the SLT bit vectors
+    bool compute_string_depths; // Store precomputed string depths instead of the SLT
+    Stats_writer* stats_writer; // Where to write context stats. nullptr means no stats.
+    int64_t n_threads; // Number of threads for the traversals. The model is the same for any number of threads.
+    BWT_Layout bwt_layout; // How to store the reverse BWT
+    bool allow_fused_traversal; // Use a single traversal if possible (see get_fused_depth_bound). The model is the same either way.
+    
+    Build_Options() : run_length_coding(false), compute_string_depths(false), stats_writer(nullptr), n_threads(1),
+                      bwt_layout(BWT_Layout::DEFAULT), allow_fused_traversal(true) {}
+};
+
+// All components of the model will be stored into G
+// G.bibwt: the BiBWT of the reference, which must be built already
+// context_formula: a callback for context marking
+// slt_it: iterator that gives all nodes that we want in the SLT
+// rev_st_it: iterator that gives all nodes that we want in the rev ST
+void build_model_from_bibwt(Global_Data& G, Context_Callback& context_formula,
+                           Iterator& slt_it, Iterator& rev_st_it, const Build_Options& options = Build_Options()){
+    
+    bool run_length_coding = options.run_length_coding;
+    bool compute_string_depths = options.compute_string_depths;
+    int64_t n_threads = options.n_threads;
+    Stats_writer no_stats; // Disabled
+    Stats_writer& wr = options.stats_writer != nullptr ? *options.stats_writer : no_stats;
+    
+    slt_it.set_index(G.bibwt.get());
+    rev_st_it.set_index(G.bibwt.get());
     
     wr.set_data(&G);
-    if(compute_string_depths) write_log("Marking contexts and storing string depths of maxreps");
-    else write_log("Marking contexts and maxreps");
     
+    Build_REV_ST_BPR_And_Pruning_Callback revstbprcb;
+    Build_SLT_BPR_Callback sltbprcb;
     Rev_ST_Maximal_Marks_Callback revstmmcb;
     SLT_Maximal_Marks_Callback sltmmcb;
     Store_Depths_Callback sdcb;
     
     if(compute_string_depths) {
+        sltbprcb.disable();
         sdcb.enable();
         sltmmcb.disable();
     } else {
+        sltbprcb.enable();
         sdcb.disable();
         sltmmcb.enable();
     }
     
-    revstmmcb.init(*G.bibwt, G.rev_st_bpr->size(), mapper);
-    sltmmcb.init(*G.bibwt, sdsl_slt_bpr);
-    context_formula.init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
-    sdcb.init();
+    sdsl::bit_vector sdsl_slt_bpr; // Stays empty if compute_string_depths is true
     
-    vector<Iterator_Callback*> marking_callbacks = {&sdcb, &revstmmcb, &sltmmcb, &context_formula};
-    iterate_with_callbacks(slt_it, marking_callbacks);
+    int64_t fused_depth_bound = options.allow_fused_traversal ? get_fused_depth_bound(slt_it, rev_st_it, wr) : -1;
+    if(fused_depth_bound != -1){
+        if(compute_string_depths) write_log("Building reverse suffix tree BPR, pruning marks, context marks and string depths of maxreps");
+        else write_log("Building reverse suffix tree BPR, pruning marks, SLT BPR, context marks and maxreps");
+        
+        Fused_Maxrep_Iterator fused_it(G.bibwt.get(), fused_depth_bound);
+        revstbprcb.init(*G.bibwt);
+        sltbprcb.init(*G.bibwt);
+        revstmmcb.init_deferred(*G.bibwt);
+        sltmmcb.init_deferred();
+        context_formula.init_deferred(G.bibwt.get(), &wr);
+        sdcb.init();
+        
+        vector<Mergeable_Callback*> callbacks = {&revstbprcb, &sltbprcb, &sdcb, &revstmmcb, &sltmmcb, &context_formula};
+        iterate_with_callbacks_parallel(fused_it, callbacks, n_threads);
+        
+        Rev_st_topology RSTT = revstbprcb.get_result();
+        store_rev_st_topology(G, RSTT, run_length_coding);
+        sdsl_slt_bpr = sltbprcb.get_result(); // Returns empty if disabled
+        store_slt_bpr(G, sdsl_slt_bpr, run_length_coding, compute_string_depths);
+        
+        write_log("Mapping maxreps and contexts to the topology");
+        Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+        revstmmcb.resolve(G.rev_st_bpr->size(), mapper);
+        sltmmcb.resolve(sdsl_slt_bpr);
+        context_formula.resolve_deferred(G.rev_st_bpr->size(), mapper);
+    } else{
+        write_log("Building reverse suffix tree BPR and pruning marks");
+        revstbprcb.init(*G.bibwt);
+        iterate_with_callbacks_parallel(rev_st_it, &revstbprcb, n_threads);
+        Rev_st_topology RSTT = revstbprcb.get_result();
+        store_rev_st_topology(G, RSTT, run_length_coding);
+        
+        Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+        
+        if(!compute_string_depths) write_log("Building SLT BPR");
+        sltbprcb.init(*G.bibwt);
+        iterate_with_callbacks_parallel(slt_it, &sltbprcb, n_threads);
+        sdsl_slt_bpr = sltbprcb.get_result(); // Returns empty if disabled
+        store_slt_bpr(G, sdsl_slt_bpr, run_length_coding, compute_string_depths);
+        
+        if(compute_string_depths) write_log("Marking contexts and storing string depths of maxreps");
+        else write_log("Marking contexts and maxreps");
+        
+        revstmmcb.init(*G.bibwt, G.rev_st_bpr->size(), mapper);
+        sltmmcb.init(*G.bibwt, sdsl_slt_bpr);
+        context_formula.init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
+        sdcb.init();
+        
+        vector<Mergeable_Callback*> marking_callbacks = {&sdcb, &revstmmcb, &sltmmcb, &context_formula};
+        iterate_with_callbacks_parallel(slt_it, marking_callbacks, n_threads);
+    }
     
     G.rev_st_maximal_marks = std::shared_ptr<Bitvector>(new Basic_bitvector(revstmmcb.get_result()));
     G.rev_st_maximal_marks->init_rank_support();
@@ -145,13 +253,18 @@ void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
     
     // Store reverse BWT for scoring. Todo: reuse already computed bibwt
     
-    uint8_t* revbwt = (uint8_t*)malloc(sizeof(uint8_t) * T.size()+1+1); // +1: dollar, +1: null terminator
-    for(int64_t i = 0; i < T.size()+1; i++){
+    int64_t n = G.bibwt->size(); // Includes the dollar
+    uint8_t* revbwt = (uint8_t*)malloc(sizeof(uint8_t) * n+1); // +1: null terminator
+    for(int64_t i = 0; i < n; i++){
         revbwt[i] = G.bibwt->backward_bwt_at(i);
     }
-    revbwt[T.size()+1] = 0;
+    revbwt[n] = 0;
     
-    if(run_length_coding){
+    if(options.bwt_layout == BWT_Layout::INTERLEAVED){
+        write_log("Storing the reverse BWT in the interleaved layout");
+        G.revbwt = make_shared<Interleaved_BWT>();
+        G.revbwt->init_from_bwt(revbwt);
+    } else if(run_length_coding){
         write_log("Run length coding the reverse BWT");
         G.revbwt = make_shared<RLEBWT<>>();
         G.revbwt->init_from_bwt(revbwt);
@@ -167,11 +280,13 @@ void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
         
 }
 
+// T: reference string. The other parameters are as in build_model_from_bibwt.
 void build_model(Global_Data& G, string& T, Context_Callback& context_formula,
-                 Iterator& slt_it, Iterator& rev_st_it, bool run_length_coding, bool compute_string_depths){
-    // No score Scores_writer
-    Stats_writer wr;
-    build_model(G,T,context_formula, slt_it, rev_st_it, run_length_coding, compute_string_depths, wr);
+                 Iterator& slt_it, Iterator& rev_st_it, const Build_Options& options = Build_Options()){
+    write_log("Building the BiBWT");
+    G.bibwt = make_shared<BD_BWT_index<>>((uint8_t*)T.c_str());
+    write_peak_memory_log();
+    build_model_from_bibwt(G, context_formula, slt_it, rev_st_it, options);
 }
 
 int build_model_main(int argc, char** argv);
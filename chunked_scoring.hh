@@ -0,0 +1,150 @@
+#ifndef CHUNKED_SCORING_HH
+#define CHUNKED_SCORING_HH
+
+#include "score_string.hh"
+#include "static_scoring.hh"
+#include "globals.hh"
+#include "Interfaces.hh"
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+// Scores one long query with many threads. The query is processed in blocks of
+// n_threads * chunk_length characters, and each block is split into one chunk per thread.
+// The first chunk of a block continues from the state at the end of the previous block. The
+// other chunks do not know their starting state yet, so they start from the empty string
+// overlap characters before the chunk, which usually gives the right state by the time the
+// chunk begins. Each thread records the states at the start of its chunk. Then the chunks are
+// checked in order: the correct state at the start of a chunk is the state at the end of the
+// previous chunk, and it is stepped forward until it equals the state the thread had at the
+// same position. From there on the two runs are identical, because the next state and the
+// log-probability depend only on the state and the character. The log-probabilities before
+// that point are recomputed. Finally the log-probabilities are summed in the order of the
+// query, so the score is bit-identical to main_loop.
+class Chunked_Raw_Scorer{
+
+private:
+
+    Chunked_Raw_Scorer(const Chunked_Raw_Scorer&); // Prevent copy-construction
+    Chunked_Raw_Scorer& operator=(const Chunked_Raw_Scorer&);  // Prevent assignment
+
+    struct Chunk{
+        int64_t begin, end; // Positions in the block
+        Main_Loop_State end_state; // State of the thread at the end of the chunk
+        std::vector<Main_Loop_State> start_states; // States of the thread before the first characters of the chunk
+        Chunk(Global_Data& G) : begin(0), end(0), end_state(G) {}
+    };
+
+    Global_Data& G;
+    std::vector<std::shared_ptr<Scoring_Engine>> engines; // One per thread
+    int64_t chunk_length;
+    int64_t overlap;
+    int64_t n_recorded_states;
+    Main_Loop_State state; // State at the end of the previous block
+    double logprob; // Sum so far
+    std::vector<double> logprobs; // Of the current block
+    std::vector<Chunk> chunks;
+
+    static bool same_state(const Main_Loop_State& A, const Main_Loop_State& B){
+        return A.I == B.I && A.string_depth == B.string_depth;
+    }
+
+    void score_chunk(const char* S, int64_t t){
+        Chunk& C = chunks[t];
+        Scoring_Engine& engine = *engines[t];
+        Main_Loop_State s = state;
+        if(t > 0){
+            s = Main_Loop_State(G);
+            int64_t warmup_begin = max(chunks[t-1].begin, C.begin - overlap);
+            std::vector<double> discard(C.begin - warmup_begin);
+            engine.score_range(S + warmup_begin, C.begin - warmup_begin, s, discard.data());
+        }
+        C.start_states.clear();
+        int64_t p = C.begin;
+        if(t > 0){
+            for(; p < C.end && p - C.begin < n_recorded_states; p++){
+                C.start_states.push_back(s);
+                engine.score_range(S + p, 1, s, logprobs.data() + p);
+            }
+        }
+        engine.score_range(S + p, C.end - p, s, logprobs.data() + p);
+        C.end_state = s;
+    }
+
+    // Fixes the log-probabilities of chunk t given the correct state at its start. Returns the correct state at its end.
+    Main_Loop_State synchronize(const char* S, int64_t t, Main_Loop_State s){
+        Chunk& C = chunks[t];
+        for(int64_t p = C.begin; p < C.end; p++){
+            int64_t i = p - C.begin;
+            if(i < (int64_t)C.start_states.size() && same_state(s, C.start_states[i])) return C.end_state;
+            engines[0]->score_range(S + p, 1, s, logprobs.data() + p);
+        }
+        return s;
+    }
+
+public:
+
+    Chunked_Raw_Scorer(Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater, int64_t n_threads,
+                       int64_t chunk_length = (1 << 22), int64_t overlap = (1 << 14), int64_t n_recorded_states = (1 << 16))
+        : G(G), chunk_length(chunk_length), overlap(overlap), n_recorded_states(n_recorded_states), state(G), logprob(0) {
+        assert(n_threads >= 1 && chunk_length >= 1 && overlap >= 0 && n_recorded_states >= 1);
+        for(int64_t t = 0; t < n_threads; t++){
+            engines.push_back(make_scoring_engine(G, scorer, updater));
+            chunks.push_back(Chunk(G));
+        }
+    }
+
+    // Length of the blocks that score_block is meant to be called with
+    int64_t block_length() const{
+        return (int64_t)engines.size() * chunk_length;
+    }
+
+    // Continues the query with the n characters of S
+    void score_block(const char* S, int64_t n){
+        logprobs.resize(n);
+        int64_t n_chunks = min((int64_t)engines.size(), max((int64_t)1, n));
+        for(int64_t t = 0; t < n_chunks; t++){
+            chunks[t].begin = n * t / n_chunks;
+            chunks[t].end = n * (t + 1) / n_chunks;
+        }
+
+        std::vector<std::thread> threads;
+        for(int64_t t = 1; t < n_chunks; t++) threads.push_back(std::thread([this, S, t](){ score_chunk(S, t); }));
+        score_chunk(S, 0); // The calling thread works too
+        for(std::thread& T : threads) T.join();
+
+        Main_Loop_State s = chunks[0].end_state;
+        for(int64_t t = 1; t < n_chunks; t++) s = synchronize(S, t, s);
+        state = s;
+
+        for(int64_t i = 0; i < n; i++) logprob += logprobs[i];
+    }
+
+    // The score of the whole query so far
+    double get_logprob() const{
+        return logprob;
+    }
+
+    // Scores a raw file like Raw_file_stream and main_loop do
+    double score_file(std::string filename){
+        std::ifstream file(filename, ios::in | ios::binary);
+        if(file.bad()){
+            cerr << "Error opening file " << filename << endl;
+            exit(-1);
+        }
+        std::vector<char> block(block_length());
+        while(true){
+            file.read(block.data(), block.size());
+            int64_t n = file.gcount();
+            if(n == 0) break;
+            if(std::find_if(block.begin(), block.begin() + n, [](char c){ return c == '\n' || c == '\r'; }) != block.begin() + n)
+                std::cerr << "Warning: file contains a newline character" << std::endl;
+            score_block(block.data(), n);
+        }
+        return logprob;
+    }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef CONTEXT_COUNT_TABLE_HH
+#define CONTEXT_COUNT_TABLE_HH
+
+#include "Interfaces.hh"
+#include "BPR_Colex_mapping.hh"
+#include "model_container.hh"
+#include "sdsl/int_vector.hpp"
+#include "sdsl/io.hpp"
+#include <memory>
+#include <string>
+#include <fstream>
+
+// Optional part of the model: for every context, the size of its colex interval and the number
+// of occurrences of every symbol of the alphabet in the reverse BWT inside that interval. The
+// scorers then get the probability of a character from the table instead of mapping the context
+// to its colex interval and searching the BWT. The contexts are indexed by their rank among the
+// marked nodes of the reverse suffix tree in preorder (see Topology::rev_st_context_rank). The
+// table takes (number of symbols + 1) * log2(n) bits per context.
+class Context_Count_Table{
+
+private:
+
+    Context_Count_Table(const Context_Count_Table&); // Prevent copy-construction
+    Context_Count_Table& operator=(const Context_Count_Table&);  // Prevent assignment
+
+    std::shared_ptr<Model_Container> container; // Non-null if the vectors point into its memory mapping
+    int16_t column[256]; // Column of a symbol in counts, or -1 if it is not in the alphabet
+
+    void init_columns(){
+        for(int64_t c = 0; c < 256; c++) column[c] = -1;
+        for(int64_t i = 0; i < (int64_t)alphabet.size(); i++) column[alphabet[i]] = i;
+    }
+
+public:
+
+    sdsl::int_vector<0> counts; // counts[context * alphabet.size() + column of c]
+    sdsl::int_vector<0> totals; // Size of the colex interval of every context
+    sdsl::int_vector<8> alphabet;
+
+    Context_Count_Table() {
+        init_columns();
+    }
+
+    ~Context_Count_Table(){
+        if(container != nullptr){
+            Model_Container::release_int_vector(counts);
+            Model_Container::release_int_vector(totals);
+        }
+    }
+
+    // index: the reverse BWT. The contexts are the open parentheses marked in context_marks.
+    void build(BWT& index, std::shared_ptr<Bitvector> rev_st_bpr, std::shared_ptr<Bitvector> context_marks, Pruned_Topology_Mapper& mapper){
+        const std::vector<uint8_t>& symbols = index.get_alphabet();
+        alphabet = sdsl::int_vector<8>(symbols.size());
+        for(int64_t i = 0; i < (int64_t)symbols.size(); i++) alphabet[i] = symbols[i];
+        init_columns();
+
+        int64_t n_contexts = 0;
+        for(int64_t i = 0; i < rev_st_bpr->size(); i++)
+            if(context_marks->at(i) && rev_st_bpr->at(i)) n_contexts++;
+
+        uint8_t width = sdsl::bits::hi(std::max(index.size(), (int64_t)1)) + 1;
+        counts = sdsl::int_vector<0>(n_contexts * alphabet.size(), 0, width);
+        totals = sdsl::int_vector<0>(n_contexts, 0, width);
+        int64_t context = 0;
+        for(int64_t i = 0; i < rev_st_bpr->size(); i++){
+            if(!context_marks->at(i) || !rev_st_bpr->at(i)) continue;
+            Interval I = mapper.node_to_leaves(i);
+            totals[context] = I.size();
+            for(int64_t j = 0; j < (int64_t)alphabet.size(); j++)
+                counts[context * alphabet.size() + j] = index.search(I, alphabet[j]).size();
+            context++;
+        }
+    }
+
+    int64_t count(int64_t context, uint8_t c) const{
+        int64_t col = column[c];
+        if(col == -1) return 0;
+        return counts[context * alphabet.size() + col];
+    }
+
+    int64_t total(int64_t context) const{
+        return totals[context];
+    }
+
+    int64_t number_of_contexts() const{
+        return totals.size();
+    }
+
+    int64_t size_in_bytes() const{
+        return sdsl::size_in_bytes(counts) + sdsl::size_in_bytes(totals) + sdsl::size_in_bytes(alphabet);
+    }
+
+    void serialize(std::string path){
+        if(!sdsl::store_to_file(counts, path + "_counts") || !sdsl::store_to_file(totals, path + "_totals") || !sdsl::store_to_file(alphabet, path + "_alphabet")){
+            cerr << "Error writing to disk: " << path << endl;
+            exit(-1);
+        }
+    }
+
+    void load(std::string path){
+        if(!sdsl::load_from_file(counts, path + "_counts") || !sdsl::load_from_file(totals, path + "_totals") || !sdsl::load_from_file(alphabet, path + "_alphabet")){
+            cerr << "Error loading data structure from disk: " << path << endl;
+            exit(-1);
+        }
+        init_columns();
+    }
+
+    void serialize(Model_Container_Writer& out, std::string name){
+        out.add_int_vector(name + "_counts", counts);
+        out.add_int_vector(name + "_totals", totals);
+        out.add_serializable(name + "_alphabet", alphabet);
+    }
+
+    // The counts and the totals are used in place from the memory mapping
+    void load(std::shared_ptr<Model_Container> in, std::string name){
+        container = in;
+        in->view_int_vector(name + "_counts", counts);
+        in->view_int_vector(name + "_totals", totals);
+        in->load_serializable(name + "_alphabet", alphabet);
+        init_columns();
+    }
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include <vector>
 #include "Interfaces.hh"
 #include "globals.hh"
+#include "Interval_Buffer.hh"
 
 using namespace std;
 
@@ -25,18 +26,43 @@ private:
     Global_Data* G;
     bool enabled;
     ofstream outfile;    
+    bool buffered;
+    stringstream buffer; // Used instead of outfile if buffered
+    
+    ostream& out(){
+        if(buffered) return buffer;
+        return outfile;
+    }
     
 public:
     
-    Stats_writer() : G(nullptr), enabled(false) {
+    Stats_writer() : G(nullptr), enabled(false), buffered(false) {
         outfile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     }
     
+    // Makes this the writer of one task of a parallel traversal. The output is collected
+    // into memory and appended to the parent writer with append.
+    void init_local(const Stats_writer& parent){
+        G = parent.G;
+        enabled = parent.enabled;
+        buffered = true;
+    }
+    
+    void append(Stats_writer& local){
+        if(!enabled) return;
+        string S = local.buffer.str();
+        if(S.size() > 0) out() << S;
+    }
+    
     void set_file(string filename){
         outfile.open(filename);
         enabled = true;
     }
     
+    bool is_enabled() const{
+        return enabled;
+    }
+    
     void set_data(Global_Data* G){
         this->G = G;
     }
@@ -44,7 +70,7 @@ public:
     void write_depths(int64_t stringdepth, int64_t open_paren){
         if(enabled){
         assert(G != nullptr);
-            outfile << stringdepth << " " << G->rev_st_bpr->excess(open_paren) - 1 << " ";
+            out() << stringdepth << " " << G->rev_st_bpr->excess(open_paren) - 1 << " ";
         }
     }
     
@@ -57,11 +83,199 @@ template<typename T>
 Stats_writer& operator<<(Stats_writer& wr, const T& data){  
     if(!wr.enabled) return wr;
     else{
-        wr.outfile << data;
+        wr.out() << data;
         return wr;
     }
 }  
 
+// The scores of the contexts found with some threshold, for marking the contexts again with
+// any higher threshold in one pass over the scores instead of a traversal of the BiBWT.
+// A node can get more than one score. It is a context if any of them reaches the threshold.
+class Context_Scores{
+
+public:
+
+    double min_threshold; // The threshold the scores were collected with
+    vector<int64_t> opens;
+    vector<double> scores;
+
+    Context_Scores() : min_threshold(0) {}
+
+    void add(int64_t open, double score){
+        opens.push_back(open);
+        scores.push_back(score);
+    }
+
+    void append(const Context_Scores& other){
+        opens.insert(opens.end(), other.opens.begin(), other.opens.end());
+        scores.insert(scores.end(), other.scores.begin(), other.scores.end());
+    }
+
+    int64_t size() const{
+        return opens.size();
+    }
+
+    // The context marks with the given threshold. rev_st_bpr needs bps support.
+    sdsl::bit_vector get_marks(Bitvector& rev_st_bpr, double threshold) const{
+        if(threshold < min_threshold)
+            throw std::runtime_error("The context scores were collected with threshold " + to_string(min_threshold) + ", which is larger than " + to_string(threshold));
+        sdsl::bit_vector bits(rev_st_bpr.size(), 0);
+        bits[0] = 1; bits[bits.size()-1] = 1; // Always mark root
+        for(int64_t i = 0; i < size(); i++){
+            if(scores[i] < threshold) continue;
+            bits[opens[i]] = 1;
+            bits[rev_st_bpr.find_close(opens[i])] = 1;
+        }
+        return bits;
+    }
+
+    // Sorts by position and keeps only the largest score of each node
+    void finish(){
+        vector<int64_t> order(size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int64_t a, int64_t b){
+            return opens[a] < opens[b] || (opens[a] == opens[b] && scores[a] > scores[b]);
+        });
+        vector<int64_t> new_opens;
+        vector<double> new_scores;
+        for(int64_t i : order){
+            if(new_opens.size() > 0 && new_opens.back() == opens[i]) continue;
+            new_opens.push_back(opens[i]);
+            new_scores.push_back(scores[i]);
+        }
+        opens.swap(new_opens);
+        scores.swap(new_scores);
+    }
+
+    void serialize(string path){
+        ofstream out(path, ios::binary);
+        int64_t n = size();
+        out.write((char*)&min_threshold, sizeof(double));
+        out.write((char*)&n, sizeof(int64_t));
+        out.write((char*)opens.data(), n * sizeof(int64_t));
+        out.write((char*)scores.data(), n * sizeof(double));
+        if(!out.good()) throw std::runtime_error("Error writing to disk: " + path);
+    }
+
+    void load(string path){
+        ifstream in(path, ios::binary);
+        int64_t n = 0;
+        in.read((char*)&min_threshold, sizeof(double));
+        in.read((char*)&n, sizeof(int64_t));
+        opens.resize(n);
+        scores.resize(n);
+        in.read((char*)opens.data(), n * sizeof(int64_t));
+        in.read((char*)scores.data(), n * sizeof(double));
+        if(!in.good()) throw std::runtime_error("Error reading from disk: " + path);
+    }
+};
+
+// Context marks of a formula. The local copy of a formula in a parallel traversal
+// stores the marked positions instead of a bit vector the size of the whole BPR.
+// In deferred mode the colex intervals of the contexts are stored instead, and they are
+// mapped to the topology by resolve once the topology has been built.
+class Context_Marks{
+    
+public:
+    
+    sdsl::bit_vector bits;
+    Topology_Mapper* mapper;
+    vector<int64_t> local_marks;
+    bool is_local;
+    bool deferred;
+    Interval_Buffer deferred_intervals; // Used if deferred
+    bool keep_scores;
+    Context_Scores scores; // The score of every mark, if keep_scores is set
+    
+    Context_Marks() : mapper(nullptr), is_local(false), deferred(false), keep_scores(false) {}
+    
+    void init(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        this->mapper = &mapper;
+        bits = sdsl::bit_vector(rev_st_bpr_size, 0);
+        
+        // Always mark root
+        bits[0] = 1;
+        bits[bits.size()-1] = 1;
+    }
+    
+    void init_deferred(int64_t bwt_size){
+        deferred = true;
+        deferred_intervals.init(bwt_size);
+    }
+    
+    void init_local(const Context_Marks& parent){
+        is_local = true;
+        mapper = parent.mapper;
+        deferred = parent.deferred;
+        keep_scores = parent.keep_scores;
+        if(deferred) deferred_intervals.init_like(parent.deferred_intervals);
+    }
+    
+    // Marks the node with the given colex interval. Returns the open parenthesis of the node,
+    // or -1 if deferred. The score is kept only if keep_scores is set, which needs the topology.
+    int64_t mark(Interval colex, double score = 0){
+        if(deferred){
+            assert(!keep_scores);
+            deferred_intervals.push_back(colex);
+            return -1;
+        }
+        int64_t open = mapper->leaves_to_node(colex);
+        int64_t close = mapper->find_close(open);
+        if(keep_scores) scores.add(open, score);
+        if(is_local){
+            local_marks.push_back(open);
+            local_marks.push_back(close);
+        } else{
+            bits[open] = 1;
+            bits[close] = 1;
+        }
+        return open;
+    }
+    
+    void merge(Context_Marks& local){
+        if(deferred) deferred_intervals.append(local.deferred_intervals);
+        else for(int64_t pos : local.local_marks) bits[pos] = 1;
+        scores.append(local.scores);
+    }
+    
+    void resolve(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        assert(deferred);
+        init(rev_st_bpr_size, mapper);
+        deferred = false;
+        for(int64_t i = 0; i < deferred_intervals.size(); i++) mark(deferred_intervals[i]);
+        deferred_intervals.free_memory();
+    }
+};
+
+// Sets the index and the writer of a formula and makes space for the interval data
+template<typename formula_t>
+void init_formula(formula_t& F, BIBWT* index, Stats_writer* writer){
+    F.index = index;
+    F.writer = writer;
+    for(BD_BWT_index<>::Interval_Data* D : {&F.D_W_forward, &F.D_W_reverse, &F.D_aW_reverse}){
+        D->symbols.resize(index->get_alphabet().size());
+        D->ranks_start.resize(index->get_alphabet().size());
+        D->ranks_end.resize(index->get_alphabet().size());
+    }
+}
+
+// Makes a local copy of a formula for a parallel traversal. The copy shares the index and the
+// topology mapper of F, and collects its marks and statistics into memory.
+template<typename formula_t>
+std::shared_ptr<Mergeable_Callback> init_local_formula(formula_t& F, std::shared_ptr<formula_t> local){
+    local->local_writer.init_local(*F.writer);
+    init_formula(*local, F.index, &local->local_writer);
+    local->marks.init_local(F.marks);
+    return local;
+}
+
+template<typename formula_t>
+void merge_local_formula(formula_t& F, formula_t& local){
+    F.marks.merge(local.marks);
+    F.n_candidates += local.n_candidates;
+    F.writer->append(local.local_writer);
+}
+
 // Formulas to define which strings are contexts
 
 class Entropy_Formula : public Context_Callback{
@@ -79,11 +293,11 @@ public:
     double threshold;
     BIBWT* index;
     int64_t rev_st_bpr_size;
-    Topology_Mapper* mapper;
-    sdsl::bit_vector marks;
+    Context_Marks marks;
     int64_t depth_bound;
     int64_t n_candidates;
     Stats_writer* writer;
+    Stats_writer local_writer; // Used by local copies in a parallel traversal
 
     // Reusable space
     BD_BWT_index<>::Interval_Data D_W_forward;
@@ -94,26 +308,19 @@ public:
     Entropy_Formula(double threshold, double depth_bound) : threshold(threshold), depth_bound(depth_bound), n_candidates(0), writer(nullptr) {}
     
     virtual void init(BIBWT* index, int64_t rev_st_bpr_size, Topology_Mapper& mapper, Stats_writer* writer){
-        this->index = index;
         this->rev_st_bpr_size = rev_st_bpr_size;
-        this->mapper = &mapper;
-        this->writer = writer;
-        
-        marks = sdsl::bit_vector(rev_st_bpr_size, 0);
-        
-        // Always mark root
-        marks[0] = 1;
-        marks[marks.size()-1] = 1;
-        
-        D_W_forward.symbols.resize(index->get_alphabet().size());
-        D_W_forward.ranks_start.resize(index->get_alphabet().size());
-        D_W_forward.ranks_end.resize(index->get_alphabet().size());
-        D_W_reverse.symbols.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_end.resize(index->get_alphabet().size());
-        D_aW_reverse.symbols.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_end.resize(index->get_alphabet().size());
+        init_formula(*this, index, writer);
+        marks.init(rev_st_bpr_size, mapper); // Also marks the root
+    }
+    
+    virtual void init_deferred(BIBWT* index, Stats_writer* writer){
+        assert(!writer->is_enabled()); // The open parentheses are not known yet
+        init_formula(*this, index, writer);
+        marks.init_deferred(index->size());
+    }
+    
+    virtual void resolve_deferred(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        marks.resolve(rev_st_bpr_size, mapper);
     }
     
     virtual void callback(const Iterator::Stack_frame& top){
@@ -148,10 +355,7 @@ public:
         }
         
         if(EQ7 >= threshold){
-            int64_t open = mapper->leaves_to_node(I.reverse);
-            int64_t close = mapper->find_close(open);
-            marks[open] = 1;
-            marks[close] = 1;
+            int64_t open = marks.mark(I.reverse, EQ7);
             writer->write_depths(top.depth, open);
             *writer << EQ7 << "\n";
         }
@@ -171,10 +375,18 @@ public:
         return ans;
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        return init_local_formula(*this, make_shared<Entropy_Formula>(threshold, depth_bound));
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        merge_local_formula(*this, dynamic_cast<Entropy_Formula&>(local));
+    }
+    
     virtual void finish(){}
     
     virtual sdsl::bit_vector get_result(){
-        return marks;
+        return marks.bits;
     }
     
     virtual int64_t get_number_of_candidates(){
@@ -198,12 +410,12 @@ public:
     BD_BWT_index<>::Interval_Data D_W_forward;
     BD_BWT_index<>::Interval_Data D_aW_reverse;
     BD_BWT_index<>::Interval_Data D_W_reverse;
-    sdsl::bit_vector marks;
-    Topology_Mapper* mapper;
+    Context_Marks marks;
     BIBWT* index;
     int64_t depth_bound;
     int64_t n_candidates;
     Stats_writer* writer;
+    Stats_writer local_writer; // Used by local copies in a parallel traversal
     
     EQ234_Formula(double tau1, double tau2, double tau3, double tau4) 
     : tau1(tau1), tau2(tau2), tau3(tau3), tau4(tau4), depth_bound(1e18), n_candidates(0), writer(nullptr) {
@@ -217,24 +429,19 @@ public:
     
     virtual void init(BIBWT* index, int64_t rev_st_bpr_size, Topology_Mapper& mapper, Stats_writer* writer){
         assert(tau1 > 0 && tau2 > 0 && tau3 < 1 && tau3 > 0 && tau4 > 1);
-        marks = sdsl::bit_vector(rev_st_bpr_size,0);
-        this->mapper = &mapper;
-        this->index = index;
-        this->writer = writer;
-        
-        // Always mark root
-        marks[0] = 1;
-        marks[marks.size()-1] = 1;
-        
-        D_W_forward.symbols.resize(index->get_alphabet().size());
-        D_W_forward.ranks_start.resize(index->get_alphabet().size());
-        D_W_forward.ranks_end.resize(index->get_alphabet().size());
-        D_W_reverse.symbols.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_end.resize(index->get_alphabet().size());
-        D_aW_reverse.symbols.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_end.resize(index->get_alphabet().size());
+        init_formula(*this, index, writer);
+        marks.init(rev_st_bpr_size, mapper); // Also marks the root
+    }
+    
+    virtual void init_deferred(BIBWT* index, Stats_writer* writer){
+        assert(tau1 > 0 && tau2 > 0 && tau3 < 1 && tau3 > 0 && tau4 > 1);
+        assert(!writer->is_enabled()); // The open parentheses are not known yet
+        init_formula(*this, index, writer);
+        marks.init_deferred(index->size());
+    }
+    
+    virtual void resolve_deferred(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        marks.resolve(rev_st_bpr_size, mapper);
     }
     
     virtual void callback(const Iterator::Stack_frame& top){
@@ -272,10 +479,7 @@ public:
                 double eq4 = eq4_numerator / eq4_denominator;
                 if(eq3 >= tau2 && (eq4 <= tau3 || eq4 >= tau4)){
                     // Mark aW, or more precisely the child of W with label starting with a in the reverse st
-                    int64_t open = mapper->leaves_to_node(I_aW.reverse);
-                    int64_t close = mapper->find_close(open);
-                    marks[open] = 1;
-                    marks[close] = 1;
+                    int64_t open = marks.mark(I_aW.reverse);
                     writer->write_depths(top.depth + 1, open);
                     *writer << eq2 << " " << eq3 << " " << eq4 << "\n";
                     break;
@@ -284,10 +488,18 @@ public:
         }
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        return init_local_formula(*this, make_shared<EQ234_Formula>(tau1, tau2, tau3, tau4, depth_bound));
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        merge_local_formula(*this, dynamic_cast<EQ234_Formula&>(local));
+    }
+    
     virtual void finish(){}
     
     virtual sdsl::bit_vector get_result(){
-        return marks;
+        return marks.bits;
     }
     
     virtual int64_t get_number_of_candidates(){
@@ -314,36 +526,31 @@ public:
     BD_BWT_index<>::Interval_Data D_W_reverse;
     BD_BWT_index<>::Interval_Data D_aW_reverse;
     
-    sdsl::bit_vector marks;
-    Topology_Mapper* mapper;
+    Context_Marks marks;
     BIBWT* index;
     int64_t depth_bound;
     int64_t n_candidates;
     Stats_writer* writer;
+    Stats_writer local_writer; // Used by local copies in a parallel traversal
     
     pnorm_Formula(int64_t p, double threshold) : p(p), threshold(threshold), depth_bound(1e18), n_candidates(0), writer(nullptr)  {}
     pnorm_Formula(int64_t p, double threshold, double depth_bound) : p(p), threshold(threshold), depth_bound(depth_bound), n_candidates(0), writer(nullptr)  {}
     
     virtual void init(BIBWT* index, int64_t rev_st_bpr_size, Topology_Mapper& mapper, Stats_writer* writer){
         assert(threshold >= 0);
-        marks = sdsl::bit_vector(rev_st_bpr_size,0);
-        this->mapper = &mapper;
-        this->index = index;
-        this->writer = writer;
-        
-        // Always mark root
-        marks[0] = 1;
-        marks[marks.size()-1] = 1;
-            
-        D_W_forward.symbols.resize(index->get_alphabet().size());
-        D_W_forward.ranks_start.resize(index->get_alphabet().size());
-        D_W_forward.ranks_end.resize(index->get_alphabet().size());
-        D_W_reverse.symbols.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_end.resize(index->get_alphabet().size()); 
-        D_aW_reverse.symbols.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_end.resize(index->get_alphabet().size());
+        init_formula(*this, index, writer);
+        marks.init(rev_st_bpr_size, mapper); // Also marks the root
+    }
+    
+    virtual void init_deferred(BIBWT* index, Stats_writer* writer){
+        assert(threshold >= 0);
+        assert(!writer->is_enabled()); // The open parentheses are not known yet
+        init_formula(*this, index, writer);
+        marks.init_deferred(index->size());
+    }
+    
+    virtual void resolve_deferred(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        marks.resolve(rev_st_bpr_size, mapper);
     }
     
     virtual void callback(const Iterator::Stack_frame& top){
@@ -377,20 +584,25 @@ public:
             }
             p_norm = f_aW * pow(p_norm, 1.0/p);
             if(p_norm >= threshold){
-                int64_t open = mapper->leaves_to_node(I_aW.reverse);
-                int64_t close = mapper->find_close(open);
-                marks[open] = 1;
-                marks[close] = 1;
+                int64_t open = marks.mark(I_aW.reverse, p_norm);
                 writer->write_depths(top.depth + 1, open);
                 *writer << p_norm << "\n";
             }
         }
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        return init_local_formula(*this, make_shared<pnorm_Formula>(p, threshold, depth_bound));
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        merge_local_formula(*this, dynamic_cast<pnorm_Formula&>(local));
+    }
+    
     virtual void finish(){}
     
     virtual sdsl::bit_vector get_result(){
-        return marks;
+        return marks.bits;
     }
     
     virtual int64_t get_number_of_candidates(){
@@ -415,36 +627,31 @@ public:
     BD_BWT_index<>::Interval_Data D_aW_reverse;
     BD_BWT_index<>::Interval_Data D_W_reverse;
     
-    sdsl::bit_vector marks;
-    Topology_Mapper* mapper;
+    Context_Marks marks;
     BIBWT* index;
     int64_t depth_bound;
     int64_t n_candidates;
     Stats_writer* writer;
+    Stats_writer local_writer; // Used by local copies in a parallel traversal
     
     KL_Formula(double threshold) : threshold(threshold), depth_bound(1e18), n_candidates(0), writer(nullptr) {}
     KL_Formula(double threshold, double depth_bound) : threshold(threshold), depth_bound(depth_bound), n_candidates(0), writer(nullptr) {}
     
     virtual void init(BIBWT* index, int64_t rev_st_bpr_size, Topology_Mapper& mapper, Stats_writer* writer){
         assert(threshold >= 0);
-        marks = sdsl::bit_vector(rev_st_bpr_size,0);
-        this->mapper = &mapper;
-        this->index = index;
-        this->writer = writer;
-
-        // Always mark root
-        marks[0] = 1;
-        marks[marks.size()-1] = 1;
-
-        D_W_forward.symbols.resize(index->get_alphabet().size());
-        D_W_forward.ranks_start.resize(index->get_alphabet().size());
-        D_W_forward.ranks_end.resize(index->get_alphabet().size());
-        D_W_reverse.symbols.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_W_reverse.ranks_end.resize(index->get_alphabet().size());
-        D_aW_reverse.symbols.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_start.resize(index->get_alphabet().size());
-        D_aW_reverse.ranks_end.resize(index->get_alphabet().size());
+        init_formula(*this, index, writer);
+        marks.init(rev_st_bpr_size, mapper); // Also marks the root
+    }
+    
+    virtual void init_deferred(BIBWT* index, Stats_writer* writer){
+        assert(threshold >= 0);
+        assert(!writer->is_enabled()); // The open parentheses are not known yet
+        init_formula(*this, index, writer);
+        marks.init_deferred(index->size());
+    }
+    
+    virtual void resolve_deferred(int64_t rev_st_bpr_size, Topology_Mapper& mapper){
+        marks.resolve(rev_st_bpr_size, mapper);
     }
     
     virtual void callback(const Iterator::Stack_frame& top){
@@ -476,20 +683,25 @@ public:
                     KL_divergence += f_aWb * log((f_aWb / f_aW) / (f_Wb / f_W));
             }
             if(KL_divergence >= threshold){
-                int64_t open = mapper->leaves_to_node(I_aW.reverse);
-                int64_t close = mapper->find_close(open);
-                marks[open] = 1;
-                marks[close] = 1;
+                int64_t open = marks.mark(I_aW.reverse, KL_divergence);
                 writer->write_depths(top.depth + 1, open);
                 *writer << KL_divergence << "\n";
             }
         }
     }
     
+    virtual std::shared_ptr<Mergeable_Callback> new_local(){
+        return init_local_formula(*this, make_shared<KL_Formula>(threshold, depth_bound));
+    }
+    
+    virtual void merge(Mergeable_Callback& local){
+        merge_local_formula(*this, dynamic_cast<KL_Formula&>(local));
+    }
+    
     virtual void finish(){}
     
     virtual sdsl::bit_vector get_result(){
-        return marks;
+        return marks.bits;
     }
     
     virtual int64_t get_number_of_candidates(){
@@ -497,6 +709,40 @@ public:
     }
 };
 
+// Keeping the scores of the contexts. Only the formulas that compare a single score against a
+// threshold can do this, so these return false or null for EQ234_Formula.
+
+template<typename formula_t>
+bool keep_context_scores_of(Context_Callback& cf, double threshold){
+    formula_t* F = dynamic_cast<formula_t*>(&cf);
+    if(F == nullptr) return false;
+    F->threshold = threshold;
+    F->marks.keep_scores = true;
+    return true;
+}
+
+// Makes cf mark the contexts with the given threshold and keep their scores. Call before init.
+bool keep_context_scores(Context_Callback& cf, double threshold){
+    return keep_context_scores_of<Entropy_Formula>(cf, threshold)
+        || keep_context_scores_of<KL_Formula>(cf, threshold)
+        || keep_context_scores_of<pnorm_Formula>(cf, threshold);
+}
+
+template<typename formula_t>
+Context_Scores* get_context_scores_of(Context_Callback& cf){
+    formula_t* F = dynamic_cast<formula_t*>(&cf);
+    if(F == nullptr) return nullptr;
+    F->marks.scores.min_threshold = F->threshold;
+    return &F->marks.scores;
+}
+
+// The scores kept after keep_context_scores and a traversal
+Context_Scores* get_context_scores(Context_Callback& cf){
+    if(Context_Scores* S = get_context_scores_of<Entropy_Formula>(cf)) return S;
+    if(Context_Scores* S = get_context_scores_of<KL_Formula>(cf)) return S;
+    return get_context_scores_of<pnorm_Formula>(cf);
+}
+
 void iterate_with_callback(Iterator& iterator, Iterator_Callback* cb){
     
     iterator.init();
@@ -8,17 +8,59 @@
 #include <memory>
 #include "UniBWT.h"
 #include "RLEBWT.hh"
+#include "InterleavedBWT.hh"
 #include "Basic_bitvector.hh"
 #include "RLE_bitvector.hh"
+#include "Compact_BPR_bitvector.hh"
 #include "All_Ones_Bitvector.hh"
+#include "model_container.hh"
+#include "context_count_table.hh"
+#include "lma_pointer_table.hh"
 #include <sstream>
 #include <string>
 #include <vector>
+#include <set>
 #include <stdexcept>
 #include <memory>
+#include <map>
+#include <dirent.h>
+#include <sys/stat.h>
 
 using namespace std;
 
+// Which structures a stored model has. Each profile has everything that the one before it has.
+// LIN has what --lin-scoring needs: the reverse BWT, the reverse suffix tree BPR and the pruning
+// marks. SCORING has also what the other scoring methods need. FULL has also the BiBWT, which only
+// reconstruct needs. The string depths of SCORING come from the SLT or from the stored depths,
+// depending on how the model was built (see structures_of), and only that one is stored.
+enum class Model_Profile {LIN, SCORING, FULL};
+
+string model_profile_to_string(Model_Profile profile){
+    if(profile == Model_Profile::LIN) return "lin";
+    if(profile == Model_Profile::SCORING) return "scoring";
+    return "full";
+}
+
+Model_Profile parse_model_profile(string S){
+    if(S == "lin") return Model_Profile::LIN;
+    if(S == "scoring") return Model_Profile::SCORING;
+    if(S == "full") return Model_Profile::FULL;
+    throw std::runtime_error("Unknown model profile: " + S);
+}
+
+// Sums the sizes of named parts by the structure they belong to. A part belongs to the structure
+// with the longest name that it starts with. Parts of no structure are left out.
+map<string, int64_t> group_by_structure(const vector<pair<string, int64_t>>& parts, const vector<string>& structures){
+    map<string, int64_t> bytes;
+    for(const pair<string, int64_t>& part : parts){
+        string owner;
+        for(const string& name : structures)
+            if(part.first.compare(0, name.size(), name) == 0 && name.size() > owner.size()) owner = name;
+        if(owner != "") bytes[owner] += part.second;
+    }
+    return bytes;
+}
+
 
 // This class constains all the data needed to represent the markov model in a succinct indexed form.
 class Global_Data {
@@ -44,6 +86,8 @@ class Global_Data {
     std::shared_ptr<BWT> revbwt; // Constructed during build time, used during scoring time.
 
     std::shared_ptr<sdsl::int_vector<0>> string_depths; // Built only if used
+    std::shared_ptr<Context_Count_Table> context_counts; // Built only if asked for, otherwise null
+    std::shared_ptr<LMA_Pointer_Table> rev_st_lma_pointers; // Built only if asked for, otherwise null
 
     Global_Data() {}
     
@@ -64,20 +108,92 @@ class Global_Data {
         return ss.str();
     }
 
-    void store_all_to_disk(string directory, string filename_prefix) {
+    // Names of the structures of a profile, as in the file names and the container entries.
+    // The set follows the built model: a model built with stored string depths has no SLT, and
+    // otherwise the string depths are computed from the SLT, so only one of the two is stored.
+    vector<string> structures_of(Model_Profile profile){
+        vector<string> names = {"rev_bwt", "rev_st_bpr", "pruning_marks"};
+        if(profile >= Model_Profile::SCORING){
+            for(string name : {"rev_st_bpr_context_only", "rev_st_maximal_marks", "rev_st_context_marks"})
+                names.push_back(name);
+            if(have_slt()){
+                names.push_back("slt_bpr");
+                names.push_back("slt_maximal_marks");
+            } else names.push_back("string_depths");
+            if(context_counts != nullptr) names.push_back("context_counts");
+            if(rev_st_lma_pointers != nullptr) names.push_back("rev_st_lma_pointers");
+        }
+        if(profile == Model_Profile::FULL) names.push_back("bibwt");
+        return names;
+    }
+
+    // The profile is written to filename_prefix + ".profile", followed by the number of bytes
+    // of each structure
+    void store_all_to_disk(string directory, string filename_prefix, Model_Profile profile = Model_Profile::FULL) {
+        string prefix = directory + "/" + filename_prefix;
         revbwt->save_to_disk(directory, filename_prefix + ".rev_bwt");
-        bibwt->save_to_disk(directory, filename_prefix + ".bibwt");
+        rev_st_bpr->serialize(prefix + ".rev_st_bpr");
+        pruning_marks->serialize(prefix + ".pruning_marks");
         
-        slt_bpr->serialize(directory + "/" + filename_prefix + ".slt_bpr");
-        rev_st_bpr->serialize(directory + "/" + filename_prefix + ".rev_st_bpr");
-        rev_st_bpr_context_only->serialize(directory + "/" + filename_prefix + ".rev_st_bpr_context_only");
-        rev_st_maximal_marks->serialize(directory + "/" + filename_prefix + ".rev_st_maximal_marks");
-        slt_maximal_marks->serialize(directory + "/" + filename_prefix + ".slt_maximal_marks");
-        rev_st_context_marks->serialize(directory + "/" + filename_prefix + ".rev_st_context_marks");
-        pruning_marks->serialize(directory + "/" + filename_prefix + ".pruning_marks");
+        if(profile >= Model_Profile::SCORING){
+            rev_st_bpr_context_only->serialize(prefix + ".rev_st_bpr_context_only");
+            rev_st_maximal_marks->serialize(prefix + ".rev_st_maximal_marks");
+            rev_st_context_marks->serialize(prefix + ".rev_st_context_marks");
+            if(have_slt()){
+                slt_bpr->serialize(prefix + ".slt_bpr");
+                slt_maximal_marks->serialize(prefix + ".slt_maximal_marks");
+            } else store_to_file(*string_depths, prefix + ".string_depths");
+            if(context_counts != nullptr) context_counts->serialize(prefix + ".context_counts");
+            if(rev_st_lma_pointers != nullptr) rev_st_lma_pointers->serialize(prefix + ".rev_st_lma_pointers");
+        }
         
-        store_to_file(*string_depths, directory + "/" + filename_prefix + ".string_depths");
+        if(profile == Model_Profile::FULL) bibwt->save_to_disk(directory, filename_prefix + ".bibwt");
         
+        ofstream out(prefix + ".profile");
+        out << model_profile_to_string(profile) << "\n";
+        for(auto& keyval : disk_size_breakdown(directory, filename_prefix, profile))
+            out << keyval.first << " " << keyval.second << "\n";
+        if(!out.good()) throw std::runtime_error("Error writing to disk: " + prefix + ".profile");
+    }
+    
+    // Bytes of each structure of the profile in the files of the model
+    map<string, int64_t> disk_size_breakdown(string directory, string filename_prefix, Model_Profile profile){
+        vector<pair<string, int64_t>> files;
+        DIR* dir = opendir(directory.c_str());
+        if(dir == nullptr) throw std::runtime_error("Could not open directory: " + directory);
+        string start = filename_prefix + ".";
+        while(dirent* entry = readdir(dir)){
+            string name = entry->d_name;
+            struct stat info;
+            if(name.compare(0, start.size(), start) != 0 || stat((directory + "/" + name).c_str(), &info) != 0) continue;
+            files.push_back({name.substr(start.size()), info.st_size});
+        }
+        closedir(dir);
+        return group_by_structure(files, structures_of(profile));
+    }
+    
+    // The profile of a model stored with store_all_to_disk or store_all_to_container. Models
+    // stored before there were profiles are FULL on disk and SCORING in a single file.
+    static Model_Profile stored_profile(string directory, string filename_prefix){
+        string container_path = directory + "/" + filename_prefix + ".model";
+        if(ifstream(container_path).good()){
+            Model_Container in(container_path);
+            return in.contains("profile") ? parse_model_profile(in.get_string("profile")) : Model_Profile::SCORING;
+        }
+        ifstream file(directory + "/" + filename_prefix + ".profile");
+        string profile;
+        if(!(file >> profile)) return Model_Profile::FULL;
+        return parse_model_profile(profile);
+    }
+    
+    // The structures listed in the .profile file of a model stored with store_all_to_disk. Empty
+    // for models stored before there were profiles, which have all structures.
+    static set<string> stored_structures(string directory, string filename_prefix){
+        set<string> names;
+        ifstream file(directory + "/" + filename_prefix + ".profile");
+        string name; int64_t bytes;
+        if(file >> name) while(file >> name >> bytes) names.insert(name);
+        return names;
     }
     
     void load_bitvector(std::shared_ptr<Bitvector>& destination, string path){
@@ -89,8 +205,12 @@ class Global_Data {
         info.close();
         if(type == "basic"){
             destination = make_shared<Basic_bitvector>();
-        } else if(type == "rle"){
+        } else if(type == "rle_sd"){
             destination = make_shared<RLE_bitvector>();
+        } else if(type == "rle"){
+            throw(std::runtime_error("The run-length bit vectors of this model are in an old format. Rebuild the model with build_model"));
+        } else if(type == "compact_bpr"){
+            destination = make_shared<Compact_BPR_bitvector>();
         } else if(type == "all-ones"){
             destination = make_shared<All_Ones_Bitvector>();
         } else {
@@ -111,6 +231,8 @@ class Global_Data {
             destination = make_shared<Basic_BWT<>>();
         } else if(type == "rle_bwt"){
             destination = make_shared<RLEBWT<>>();            
+        } else if(type == "interleaved_bwt"){
+            destination = make_shared<Interleaved_BWT>();
         } else{
             throw(std::runtime_error("Unknown BWT type: " + type));    
         }
@@ -126,17 +248,183 @@ class Global_Data {
         
         load_bwt(revbwt, directory, filename_prefix);
         
-        load_bitvector(slt_bpr, directory + "/" + filename_prefix + ".slt_bpr");
         load_bitvector(rev_st_bpr, directory + "/" + filename_prefix + ".rev_st_bpr");
         load_bitvector(rev_st_bpr_context_only, directory + "/" + filename_prefix + ".rev_st_bpr_context_only");
         load_bitvector(rev_st_maximal_marks, directory + "/" + filename_prefix + ".rev_st_maximal_marks");
-        load_bitvector(slt_maximal_marks, directory + "/" + filename_prefix + ".slt_maximal_marks");
         load_bitvector(rev_st_context_marks, directory + "/" + filename_prefix + ".rev_st_context_marks");
         load_bitvector(pruning_marks, directory + "/" + filename_prefix + ".pruning_marks");
         
+        // Only one of the SLT and the string depths is stored (see structures_of), and the other
+        // one is left empty. The files of the other one may be left over from an earlier model with
+        // the same prefix, so the .profile file decides. Older models have both.
+        set<string> stored = stored_structures(directory, filename_prefix);
+        if(stored.empty() || stored.count("slt_bpr")){
+            load_bitvector(slt_bpr, directory + "/" + filename_prefix + ".slt_bpr");
+            load_bitvector(slt_maximal_marks, directory + "/" + filename_prefix + ".slt_maximal_marks");
+        } else{
+            slt_bpr = make_shared<Basic_bitvector>();
+            slt_maximal_marks = make_shared<Basic_bitvector>();
+        }
+        
         string_depths = shared_ptr<sdsl::int_vector<0>>(new sdsl::int_vector<0>());
-        load_from_file(*string_depths, directory + "/" + filename_prefix + ".string_depths");
+        if(stored.empty() || stored.count("string_depths"))
+            load_from_file(*string_depths, directory + "/" + filename_prefix + ".string_depths");
+        
+        string context_counts_path = directory + "/" + filename_prefix + ".context_counts";
+        if(ifstream(context_counts_path + "_totals").good()){
+            context_counts = make_shared<Context_Count_Table>();
+            context_counts->load(context_counts_path);
+        }
+        
+        rev_st_lma_pointers = nullptr;
+        string lma_pointers_path = directory + "/" + filename_prefix + ".rev_st_lma_pointers";
+        if(ifstream(lma_pointers_path + "_info").good()){
+            rev_st_lma_pointers = make_shared<LMA_Pointer_Table>();
+            rev_st_lma_pointers->load(lma_pointers_path);
+        }
+        
+    }
+    
+    // The structures that depend on the contexts, stored next to a model with the given prefix.
+    // Another set of contexts for the same model takes just these files.
+    void store_contexts_to_disk(string directory, string filename_prefix){
+        rev_st_context_marks->serialize(directory + "/" + filename_prefix + ".rev_st_context_marks");
+        rev_st_bpr_context_only->serialize(directory + "/" + filename_prefix + ".rev_st_bpr_context_only");
+        if(context_counts != nullptr) context_counts->serialize(directory + "/" + filename_prefix + ".context_counts");
+        if(rev_st_lma_pointers != nullptr) rev_st_lma_pointers->serialize(directory + "/" + filename_prefix + ".rev_st_lma_pointers");
+    }
+    
+    // Replaces the contexts of a loaded model with ones stored by store_contexts_to_disk
+    void load_contexts_from_disk(string directory, string filename_prefix){
+        load_bitvector(rev_st_context_marks, directory + "/" + filename_prefix + ".rev_st_context_marks");
+        load_bitvector(rev_st_bpr_context_only, directory + "/" + filename_prefix + ".rev_st_bpr_context_only");
+        
+        context_counts = nullptr;
+        string context_counts_path = directory + "/" + filename_prefix + ".context_counts";
+        if(ifstream(context_counts_path + "_totals").good()){
+            context_counts = make_shared<Context_Count_Table>();
+            context_counts->load(context_counts_path);
+        }
+        
+        rev_st_lma_pointers = nullptr;
+        string lma_pointers_path = directory + "/" + filename_prefix + ".rev_st_lma_pointers";
+        if(ifstream(lma_pointers_path + "_info").good()){
+            rev_st_lma_pointers = make_shared<LMA_Pointer_Table>();
+            rev_st_lma_pointers->load(lma_pointers_path);
+        }
+    }
+    
+    // Single-file model. Everything except bibwt, which is only needed at build time, so
+    // FULL is the same as SCORING.
+    void store_all_to_container(string path, Model_Profile profile = Model_Profile::SCORING) {
+        if(profile == Model_Profile::FULL) profile = Model_Profile::SCORING;
+        Model_Container_Writer out(path);
+        out.add_string("profile", model_profile_to_string(profile));
+        revbwt->save_to_container(out, "rev_bwt");
+        rev_st_bpr->serialize(out, "rev_st_bpr");
+        pruning_marks->serialize(out, "pruning_marks");
         
+        if(profile == Model_Profile::SCORING){
+            rev_st_bpr_context_only->serialize(out, "rev_st_bpr_context_only");
+            rev_st_maximal_marks->serialize(out, "rev_st_maximal_marks");
+            rev_st_context_marks->serialize(out, "rev_st_context_marks");
+            if(have_slt()){
+                slt_bpr->serialize(out, "slt_bpr");
+                slt_maximal_marks->serialize(out, "slt_maximal_marks");
+            } else out.add_int_vector("string_depths", *string_depths);
+            if(context_counts != nullptr) context_counts->serialize(out, "context_counts");
+            if(rev_st_lma_pointers != nullptr) rev_st_lma_pointers->serialize(out, "rev_st_lma_pointers");
+        }
+        out.finish();
+    }
+    
+    // Bytes of each structure of the profile in a single-file model
+    map<string, int64_t> container_size_breakdown(string path, Model_Profile profile){
+        Model_Container in(path);
+        return group_by_structure(in.entry_sizes(), structures_of(profile));
+    }
+    
+    void load_bitvector(std::shared_ptr<Bitvector>& destination, std::shared_ptr<Model_Container> in, string name){
+        string type;
+        stringstream info(in->get_string(name + "_info"));
+        info >> type;
+        if(type == "basic"){
+            destination = make_shared<Basic_bitvector>();
+        } else if(type == "rle_sd"){
+            destination = make_shared<RLE_bitvector>();
+        } else if(type == "rle"){
+            throw(std::runtime_error("The run-length bit vectors of this model are in an old format. Rebuild the model with build_model"));
+        } else if(type == "compact_bpr"){
+            destination = make_shared<Compact_BPR_bitvector>();
+        } else if(type == "all-ones"){
+            destination = make_shared<All_Ones_Bitvector>();
+        } else {
+            throw(std::runtime_error("Unknown bit vector type: " + type));    
+        }
+        destination->load(in, name);
+    }
+    
+    void load_bwt(std::shared_ptr<BWT>& destination, std::shared_ptr<Model_Container> in){
+        string type = in->get_string("rev_bwt_bwt_info");
+        if(type == "basic_bwt"){
+            destination = make_shared<Basic_BWT<>>();
+        } else if(type == "rle_bwt"){
+            destination = make_shared<RLEBWT<>>();            
+        } else if(type == "interleaved_bwt"){
+            destination = make_shared<Interleaved_BWT>();
+        } else{
+            throw(std::runtime_error("Unknown BWT type: " + type));    
+        }
+        destination->load_from_container(in, "rev_bwt");
+    }
+    
+    // The bit vectors and the string depths are used in place from the memory mapping of the
+    // file, so they are shared in the page cache between processes that load the same model.
+    void load_all_from_container(string path) {
+        std::shared_ptr<Model_Container> in = make_shared<Model_Container>(path);
+        
+        load_bwt(revbwt, in);
+        
+        load_bitvector(rev_st_bpr, in, "rev_st_bpr");
+        load_bitvector(rev_st_bpr_context_only, in, "rev_st_bpr_context_only");
+        load_bitvector(rev_st_maximal_marks, in, "rev_st_maximal_marks");
+        load_bitvector(rev_st_context_marks, in, "rev_st_context_marks");
+        load_bitvector(pruning_marks, in, "pruning_marks");
+        
+        // Only one of the SLT and the string depths is stored, as in load_all_from_disk
+        if(in->contains("slt_bpr_info")){
+            load_bitvector(slt_bpr, in, "slt_bpr");
+            load_bitvector(slt_maximal_marks, in, "slt_maximal_marks");
+        } else{
+            slt_bpr = make_shared<Basic_bitvector>();
+            slt_maximal_marks = make_shared<Basic_bitvector>();
+        }
+        
+        if(in->contains("string_depths")){
+            // The deleter releases the view and keeps the mapping alive as long as the vector
+            string_depths = shared_ptr<sdsl::int_vector<0>>(new sdsl::int_vector<0>(), [in](sdsl::int_vector<0>* v){
+                Model_Container::release_int_vector(*v);
+                delete v;
+            });
+            in->view_int_vector("string_depths", *string_depths);
+        } else string_depths = make_shared<sdsl::int_vector<0>>();
+        
+        if(in->contains("context_counts_totals")){
+            context_counts = make_shared<Context_Count_Table>();
+            context_counts->load(in, "context_counts");
+        }
+        
+        if(in->contains("rev_st_lma_pointers_info")){
+            rev_st_lma_pointers = make_shared<LMA_Pointer_Table>();
+            rev_st_lma_pointers->load(in, "rev_st_lma_pointers");
+        }
+    }
+    
+    void load_structures_that_lin_scoring_needs_from_container(string path){
+        std::shared_ptr<Model_Container> in = make_shared<Model_Container>(path);
+        load_bwt(revbwt, in);
+        load_bitvector(rev_st_bpr, in, "rev_st_bpr");
+        load_bitvector(pruning_marks, in, "pruning_marks");
     }
     
     void load_structures_that_lin_scoring_needs(string directory, string filename_prefix){
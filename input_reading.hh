@@ -6,30 +6,159 @@
 #include <vector>
 #include <algorithm>
 #include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Position of the first byte in [begin, end) that is equal to a, b or c, or end if there is none.
+// Compares 16 bytes at a time with SSE2.
+inline const char* find_first_of(const char* begin, const char* end, char a, char b, char c){
+    const char* p = begin;
+#ifdef __SSE2__
+    const __m128i A = _mm_set1_epi8(a), B = _mm_set1_epi8(b), C = _mm_set1_epi8(c);
+    for(; end - p >= 16; p += 16){
+        __m128i x = _mm_loadu_si128((const __m128i*)p);
+        __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, A), _mm_cmpeq_epi8(x, B)), _mm_cmpeq_epi8(x, C));
+        int mask = _mm_movemask_epi8(eq);
+        if(mask != 0) return p + __builtin_ctz(mask);
+    }
+#endif
+    for(; p != end; p++) if(*p == a || *p == b || *p == c) return p;
+    return end;
+}
+
+// Reads a file in large blocks. Regular files are mapped to memory as one block, other
+// files (like pipes) are read with read() into a buffer of buffer_size bytes. The mapping
+// can be turned off with map_to_memory = false.
+class Block_File{
 
-class Raw_file_stream{
 private:
-    
-    std::ifstream file;
-    
+
+    Block_File(const Block_File&); // Prevent copy-construction
+    Block_File& operator=(const Block_File&);  // Prevent assignment
+
+    static const int64_t buffer_size = (1 << 20);
+
+    int fd;
+    char* map; // Null if not mapped
+    int64_t map_size;
+    std::vector<char> buffer;
+    bool eof;
+
+    // Returns false if there is nothing left in the file
+    bool refill(){
+        if(map != nullptr || eof){
+            eof = true; // The mapping is the whole file
+            return false;
+        }
+        buffer.resize(buffer_size);
+        ssize_t n;
+        do{ n = read(fd, buffer.data(), buffer.size()); } while(n < 0 && errno == EINTR);
+        if(n < 0){
+            cerr << "Error reading file" << endl;
+            exit(-1);
+        }
+        if(n == 0){
+            eof = true;
+            return false;
+        }
+        cur = buffer.data();
+        end = buffer.data() + n;
+        return true;
+    }
+
 public:
-    
-    Raw_file_stream(string filename) : file(filename, ios::in | ios::binary) {
-        if(file.bad()){
+
+    const char* cur; // The bytes [cur, end) have been read but not consumed
+    const char* end;
+
+    Block_File(string filename, bool map_to_memory = true) : fd(-1), map(nullptr), map_size(0), eof(false), cur(nullptr), end(nullptr) {
+        fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0){
             cerr << "Error opening file " << filename << endl;
             exit(-1);
         }
+        struct stat st;
+        if(map_to_memory && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+            void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                map = (char*)p;
+                map_size = st.st_size;
+                madvise(map, map_size, MADV_SEQUENTIAL);
+                cur = map;
+                end = map + map_size;
+            }
+        }
+    }
+
+    ~Block_File(){
+        if(map != nullptr) munmap(map, map_size);
+        if(fd >= 0) close(fd);
+    }
+
+    // Makes [cur, end) nonempty. Returns false at the end of the file.
+    bool available(){
+        if(cur != end) return true;
+        return refill();
+    }
+
+    // True after an attempt to read past the end of the file, like ifstream::eof
+    bool at_eof() const{
+        return eof;
+    }
+
+    // Consumes bytes up to and including the next '\n', like getline
+    void skip_line(){
+        while(available()){
+            const char* p = (const char*)memchr(cur, '\n', end - cur);
+            if(p != nullptr){
+                cur = p + 1;
+                return;
+            }
+            cur = end;
+        }
     }
+};
+
+// Every input stream has two ways of reading: getchar(c) gives one character at a time, and
+// next_block(begin, end) gives the next characters as a span [begin, end) of memory that stays
+// valid until the next call. Both return false at the end of the stream. The scoring loops use
+// next_block.
+
+class Raw_file_stream{
+private:
+    
+    Block_File file;
+    
+public:
+    
+    Raw_file_stream(string filename, bool map_to_memory = true) : file(filename, map_to_memory) {}
     
     bool getchar(char& c){
-        if(file.eof()) return false; // End of stream
-        file.read(&c,1); // Read 1 byte
-        if(file.eof()) return false;
+        if(!file.available()) return false; // End of stream
+        c = *(file.cur++);
         if(c == '\n' || c == '\r')
             std::cerr << "Warning: file contains a newline character" << std::endl;
         return true;
     }
     
+    bool next_block(const char*& begin, const char*& end){
+        if(!file.available()) return false;
+        begin = file.cur;
+        end = file.end;
+        file.cur = file.end;
+        if(find_first_of(begin, end, '\n', '\r', '\r') != end)
+            std::cerr << "Warning: file contains a newline character" << std::endl;
+        return true;
+    }
+    
 };
 
 class Read_stream{
@@ -37,28 +166,49 @@ class Read_stream{
 private:
     
     bool end_of_read;
-    std::ifstream* file;
+    Block_File* file;
     
 public:
     
-    Read_stream(std::ifstream* file) : end_of_read(false), file(file) {
+    Read_stream(Block_File* file) : end_of_read(false), file(file) {
     
     }
 
     // Behaviour: Tries to read a byte to c. If eof or '>' was read,
     // return false and return false from here on. If c
-    // is '\n' or '\r', read another byte recursively.
+    // is '\n' or '\r', read another byte.
     bool getchar(char& c){
-        start:
-        if(end_of_read) return false;
-        file->read(&c,1);
-        if(file->eof()) end_of_read = true;
-        else{
-            // Read was successful
-            if(c == '\n' || c == '\r') goto start; // "Recursive call", but optimized so that the call stack does not grow
+        while(!end_of_read){
+            if(!file->available()){
+                end_of_read = true;
+                break;
+            }
+            c = *(file->cur++);
+            if(c == '\n' || c == '\r') continue;
             if(c == '>') end_of_read = true;
+            else return true;
+        }
+        return false;
+    }
+    
+    // The same as getchar, but gives the characters up to the next '\n', '\r' or '>' at once
+    bool next_block(const char*& begin, const char*& end){
+        while(!end_of_read){
+            if(!file->available()){
+                end_of_read = true;
+                break;
+            }
+            const char* p = find_first_of(file->cur, file->end, '\n', '\r', '>');
+            if(p != file->cur){
+                begin = file->cur;
+                end = p;
+                file->cur = p;
+                return true;
+            }
+            file->cur++; // Consume the newline or the '>'
+            if(*p == '>') end_of_read = true;
         }
-        return !end_of_read;
+        return false;
     }
 
 };
@@ -69,27 +219,31 @@ class FASTA_reader{
     
 private:
     
-    std::ifstream file;
+    Block_File file;
     
 public:
     
-    FASTA_reader(string filename) : file(filename, ios::in | ios::binary) {
-        if(file.bad()){
-            cerr << "Error opening file " << filename << endl;
-            exit(-1);
-        }
-    }
+    FASTA_reader(string filename, bool map_to_memory = true) : file(filename, map_to_memory) {}
     
     bool done(){
-        return file.eof();
+        return file.at_eof();
     }
     
     Read_stream get_next_query_stream(){
-        string line;
-        getline(file, line); // Discard the header
+        file.skip_line(); // Discard the header
         Read_stream rs(&file);
         return rs;
     }
+
+    // Reads the next query into memory. Returns false if there are no more queries.
+    bool get_next_query(string& query){
+        query.clear();
+        if(done()) return false;
+        Read_stream rs = get_next_query_stream();
+        const char* begin; const char* end;
+        while(rs.next_block(begin, end)) query.append(begin, end);
+        return true;
+    }
 };
 
 // Vector of (read, header) pairs
@@ -0,0 +1,122 @@
+//
+//  lma_benchmark.cpp
+//
+//  Times lowest marked ancestor queries on a stored model with the parenthesis operations
+//  and with LMA pointer tables of different sample rates.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include "BD_BWT_index/include/BD_BWT_index.hh"
+#include "globals.hh"
+#include "LMA_Support.hh"
+#include "Basic_bitvector.hh"
+#include "Compact_BPR_bitvector.hh"
+
+using namespace std;
+
+// Nanoseconds per query. Checks that the answers are the expected ones.
+template<typename lma_support_t>
+double time_queries(lma_support_t& LMAS, const vector<int64_t>& queries, const vector<int64_t>& expected){
+    int64_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for(int64_t node : queries) checksum += LMAS.LMA(node);
+    auto end = chrono::steady_clock::now();
+
+    int64_t expected_checksum = 0;
+    for(int64_t answer : expected) expected_checksum += answer;
+    if(checksum != expected_checksum){
+        cerr << "Error: wrong answers" << endl;
+        exit(-1);
+    }
+    return chrono::duration<double, nano>(end - start).count() / queries.size();
+}
+
+// Times the backends with the types of the static scoring engine (see static_scoring.hh)
+template<typename bpr_t>
+void run_static(Global_Data& G, const vector<int64_t>& queries, const vector<int64_t>& expected, const vector<int64_t>& sample_shifts){
+    shared_ptr<Basic_bitvector> marks = static_pointer_cast<Basic_bitvector>(G.rev_st_context_marks);
+    shared_ptr<bpr_t> bpr_marked_only = static_pointer_cast<bpr_t>(G.rev_st_bpr_context_only);
+
+    LMA_Support_Template<Basic_bitvector, bpr_t> bp(marks, bpr_marked_only);
+    cout << "static\tbp\t0\t" << time_queries(bp, queries, expected) << endl;
+    for(int64_t sample_shift : sample_shifts){
+        shared_ptr<LMA_Pointer_Table> pointers = make_shared<LMA_Pointer_Table>();
+        pointers->build(*marks, *bpr_marked_only, sample_shift);
+        LMA_Support_Template<Basic_bitvector, bpr_t> LMAS(marks, bpr_marked_only, pointers);
+        cout << "static\t" << (1LL << sample_shift) << "\t" << pointers->size_in_bytes() << "\t" << time_queries(LMAS, queries, expected) << endl;
+    }
+}
+
+int main(int argc, char** argv){
+
+    if(argc < 5){
+        cerr << "Times lowest marked ancestor queries with and without LMA pointer tables" << endl;
+        cerr << "Usage: lma_benchmark --dir [model directory] --file [reference filename] (--queries [number]) (--max-sample-rate [power of two])" << endl;
+        return -1;
+    }
+
+    string modeldir, filename;
+    int64_t n_queries = 10000000;
+    int64_t max_sample_rate = 64;
+    for(int64_t i = 1; i < argc; i++){
+        if(argv[i] == string("--dir")){
+            i++;
+            modeldir = argv[i];
+        } else if(argv[i] == string("--file")){
+            i++;
+            filename = argv[i];
+        } else if(argv[i] == string("--queries")){
+            i++;
+            n_queries = stoll(argv[i]);
+        } else if(argv[i] == string("--max-sample-rate")){
+            i++;
+            max_sample_rate = stoll(argv[i]);
+        } else{
+            cerr << "Invalid argument: " << argv[i] << endl;
+            return -1;
+        }
+    }
+
+    Global_Data G;
+    string container_path = modeldir + "/" + filename + ".model";
+    if(ifstream(container_path).good()) G.load_all_from_container(container_path);
+    else G.load_all_from_disk(modeldir, filename, false);
+
+    // Uniformly random nodes of the reverse suffix tree
+    vector<int64_t> opens;
+    for(int64_t i = 0; i < G.rev_st_bpr->size(); i++)
+        if(G.rev_st_bpr->at(i)) opens.push_back(i);
+    srand(1);
+    vector<int64_t> queries(n_queries);
+    for(int64_t& node : queries) node = opens[rand() % opens.size()];
+
+    vector<int64_t> sample_shifts;
+    for(int64_t sample_shift = 0; (1LL << sample_shift) <= max_sample_rate; sample_shift++) sample_shifts.push_back(sample_shift);
+
+    LMA_Support bp(G.rev_st_context_marks, G.rev_st_bpr_context_only);
+    vector<int64_t> expected;
+    for(int64_t node : queries) expected.push_back(bp.LMA(node));
+
+    cout << "# " << opens.size() << " nodes, " << G.rev_st_bpr_context_only->size() / 2 << " contexts, " << n_queries << " queries" << endl;
+    cout << "# types\tsample_rate\ttable_bytes\tns_per_query" << endl;
+    cout << "virtual\tbp\t0\t" << time_queries(bp, queries, expected) << endl;
+    for(int64_t sample_shift : sample_shifts){
+        shared_ptr<LMA_Pointer_Table> pointers = make_shared<LMA_Pointer_Table>();
+        pointers->build(*G.rev_st_context_marks, *G.rev_st_bpr_context_only, sample_shift);
+        LMA_Support LMAS(G.rev_st_context_marks, G.rev_st_bpr_context_only, pointers);
+        cout << "virtual\t" << (1LL << sample_shift) << "\t" << pointers->size_in_bytes() << "\t" << time_queries(LMAS, queries, expected) << endl;
+    }
+
+    if(dynamic_cast<Basic_bitvector*>(G.rev_st_context_marks.get())){
+        if(dynamic_cast<Basic_bitvector*>(G.rev_st_bpr_context_only.get()))
+            run_static<Basic_bitvector>(G, queries, expected, sample_shifts);
+        else if(dynamic_cast<Compact_BPR_bitvector*>(G.rev_st_bpr_context_only.get()))
+            run_static<Compact_BPR_bitvector>(G, queries, expected, sample_shifts);
+    }
+
+    return 0;
+}
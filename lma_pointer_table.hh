@@ -0,0 +1,109 @@
+#ifndef LMA_POINTER_TABLE_HH
+#define LMA_POINTER_TABLE_HH
+
+#include "Interfaces.hh"
+#include "model_container.hh"
+#include "sdsl/int_vector.hpp"
+#include "sdsl/io.hpp"
+#include <memory>
+#include <string>
+#include <fstream>
+#include <vector>
+
+// Optional part of the model: precomputed answers of lowest marked ancestor queries for
+// LMA_Support. An unmarked node of the reverse suffix tree lies in a gap between two consecutive
+// parentheses of the BPR of contexts only, and its lowest marked ancestor depends only on the
+// gap: it is the context whose parentheses enclose the gap. The table stores that context, as
+// the position of its open parenthesis in the full BPR, for every 2^sample_shift-th gap. A query
+// that falls on a stored gap then takes a rank and an array access instead of find_open or
+// double_enclose and a select. With sample_shift = 0 every query is answered from the table,
+// and the table takes (2 * number of contexts + 1) * log2(size of the BPR) bits. Every
+// increment of sample_shift halves the space and the fraction of queries answered from it.
+class LMA_Pointer_Table{
+
+private:
+
+    LMA_Pointer_Table(const LMA_Pointer_Table&); // Prevent copy-construction
+    LMA_Pointer_Table& operator=(const LMA_Pointer_Table&);  // Prevent assignment
+
+    std::shared_ptr<Model_Container> container; // Non-null if the pointers point into its memory mapping
+    int64_t sample_mask;
+
+public:
+
+    sdsl::int_vector<0> pointers; // pointers[j] = 1 + answer at gap j * 2^sample_shift, or 0 if there is no marked ancestor
+    int64_t sample_shift;
+
+    LMA_Pointer_Table() : sample_mask(0), sample_shift(0) {}
+
+    ~LMA_Pointer_Table(){
+        if(container != nullptr) Model_Container::release_int_vector(pointers);
+    }
+
+    // marks: the context marks on both parentheses of the full BPR. bpr_marked_only: the marked
+    // parentheses only. The gaps are walked in order with a stack of the open contexts.
+    void build(Bitvector& marks, Bitvector& bpr_marked_only, int64_t sample_shift){
+        this->sample_shift = sample_shift;
+        sample_mask = (1LL << sample_shift) - 1;
+        int64_t n_marked = bpr_marked_only.size();
+        uint8_t width = sdsl::bits::hi(std::max(marks.size(), (int64_t)1)) + 1;
+        pointers = sdsl::int_vector<0>((n_marked >> sample_shift) + 1, 0, width);
+
+        std::vector<int64_t> open_contexts;
+        for(int64_t k = 0; k <= n_marked; k++){
+            if((k & sample_mask) == 0)
+                pointers[k >> sample_shift] = open_contexts.empty() ? 0 : open_contexts.back() + 1;
+            if(k == n_marked) break;
+            if(bpr_marked_only.at(k)) open_contexts.push_back(marks.select(k+1));
+            else open_contexts.pop_back();
+        }
+    }
+
+    // Whether the answer at gap k is stored
+    bool is_sampled(int64_t k) const{
+        return (k & sample_mask) == 0;
+    }
+
+    // The position of the open parenthesis of the context that encloses gap k, or -1 if there is
+    // none. Gap k must be sampled.
+    int64_t lma(int64_t k) const{
+        return (int64_t)pointers[k >> sample_shift] - 1;
+    }
+
+    int64_t size_in_bytes() const{
+        return sdsl::size_in_bytes(pointers);
+    }
+
+    void serialize(std::string path){
+        std::ofstream info(path + "_info");
+        info << sample_shift << "\n";
+        if(!info.good() || !sdsl::store_to_file(pointers, path + "_pointers")){
+            cerr << "Error writing to disk: " << path << endl;
+            exit(-1);
+        }
+    }
+
+    void load(std::string path){
+        std::ifstream info(path + "_info");
+        if(!(info >> sample_shift) || !sdsl::load_from_file(pointers, path + "_pointers")){
+            cerr << "Error loading data structure from disk: " << path << endl;
+            exit(-1);
+        }
+        sample_mask = (1LL << sample_shift) - 1;
+    }
+
+    void serialize(Model_Container_Writer& out, std::string name){
+        out.add_string(name + "_info", std::to_string(sample_shift));
+        out.add_int_vector(name + "_pointers", pointers);
+    }
+
+    // The pointers are used in place from the memory mapping
+    void load(std::shared_ptr<Model_Container> in, std::string name){
+        container = in;
+        sample_shift = std::stoll(in->get_string(name + "_info"));
+        sample_mask = (1LL << sample_shift) - 1;
+        in->view_int_vector(name + "_pointers", pointers);
+    }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define LOGGING_HH
 
 #include <iostream>
+#include <sys/resource.h>
 
 string getTimeString(){
     std::time_t result = std::time(NULL);
@@ -25,4 +26,15 @@ void write_log(string message){
     }
 }
 
+// Peak resident set size of the process so far, in bytes
+int64_t get_peak_memory_bytes(){
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return (int64_t)usage.ru_maxrss * 1024; // ru_maxrss is in kilobytes on Linux
+}
+
+void write_peak_memory_log(){
+    write_log("Peak memory usage so far: " + to_string(get_peak_memory_bytes() / (1 << 20)) + " MB");
+}
+
 #endif
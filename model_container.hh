@@ -0,0 +1,297 @@
+#ifndef MODEL_CONTAINER_HH
+#define MODEL_CONTAINER_HH
+
+#include "sdsl/int_vector.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <streambuf>
+#include <istream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+// The model is stored as a single file that is mapped to memory with mmap. The file starts with
+// a header page, followed by the payloads of the entries and finally a table of contents. Every
+// payload starts at a page boundary, so that the words of an int_vector can be used in place
+// straight from the mapping. All other entries, such as the wavelet trees and the sdsl rank and
+// select supports, are in the usual serialization format of their type and are deserialized
+// from the mapping into the memory of the process.
+const int64_t MODEL_CONTAINER_ALIGNMENT = 4096;
+const char MODEL_CONTAINER_MAGIC[8] = {'V','O','M','M','C','O','N','T'};
+const uint64_t MODEL_CONTAINER_VERSION = 1;
+
+struct Model_Container_Entry{
+    enum Kind : uint64_t {STREAM = 0, INT_VECTOR = 1};
+    uint64_t offset;
+    uint64_t size; // Bytes
+    uint64_t kind;
+    uint64_t size_in_bits; // Only for int vectors
+    uint64_t width; // Only for int vectors
+    Model_Container_Entry() : offset(0), size(0), kind(STREAM), size_in_bits(0), width(0) {}
+};
+
+// Read-only stream buffer over a range of memory
+class Memory_Streambuf : public std::streambuf{
+public:
+    Memory_Streambuf(const char* data, int64_t size){
+        char* p = const_cast<char*>(data);
+        setg(p, p, p + size);
+    }
+
+protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in){
+        (void) which;
+        char* target;
+        if(dir == std::ios_base::beg) target = eback() + off;
+        else if(dir == std::ios_base::cur) target = gptr() + off;
+        else target = egptr() + off;
+        if(target < eback() || target > egptr()) return pos_type(off_type(-1));
+        setg(eback(), target, egptr());
+        return pos_type(target - eback());
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in){
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+class Model_Container_Writer{
+
+private:
+
+    Model_Container_Writer(const Model_Container_Writer&); // Prevent copy-construction
+    Model_Container_Writer& operator=(const Model_Container_Writer&);  // Prevent assignment
+
+    std::string path;
+    std::ofstream out;
+    std::map<std::string, Model_Container_Entry> entries;
+
+    void write_uint64(uint64_t x){
+        out.write((char*)&x, sizeof(x));
+    }
+
+    void pad_to_alignment(){
+        int64_t pos = out.tellp();
+        int64_t padding = (MODEL_CONTAINER_ALIGNMENT - pos % MODEL_CONTAINER_ALIGNMENT) % MODEL_CONTAINER_ALIGNMENT;
+        std::vector<char> zeros(padding, 0);
+        out.write(zeros.data(), padding);
+    }
+
+    Model_Container_Entry& new_entry(std::string name){
+        if(entries.count(name) != 0)
+            throw std::runtime_error("Duplicate model container entry: " + name);
+        pad_to_alignment();
+        Model_Container_Entry& E = entries[name];
+        E.offset = out.tellp();
+        return E;
+    }
+
+    void check_error(){
+        if(!out.good()) throw std::runtime_error("Error writing to disk: " + path);
+    }
+
+public:
+
+    Model_Container_Writer(std::string path) : path(path), out(path, std::ios::out | std::ios::binary) {
+        check_error();
+        // Header is written in finish. Reserve the first page for it.
+        pad_to_alignment();
+        std::vector<char> zeros(MODEL_CONTAINER_ALIGNMENT, 0);
+        out.write(zeros.data(), zeros.size());
+        check_error();
+    }
+
+    // Appends an object that has the member function serialize(std::ostream&)
+    template<typename T>
+    void add_serializable(std::string name, T& x){
+        Model_Container_Entry& E = new_entry(name);
+        x.serialize(out);
+        E.size = (int64_t)out.tellp() - E.offset;
+        check_error();
+    }
+
+    // Appends only the words of the int vector so that it can be viewed in place
+    template<uint8_t t_width>
+    void add_int_vector(std::string name, const sdsl::int_vector<t_width>& v){
+        Model_Container_Entry& E = new_entry(name);
+        E.kind = Model_Container_Entry::INT_VECTOR;
+        E.size_in_bits = v.bit_size();
+        E.width = v.width();
+        E.size = ((v.bit_size() + 63) >> 6) << 3;
+        out.write((const char*)v.data(), E.size);
+        check_error();
+    }
+
+    void add_string(std::string name, std::string S){
+        Model_Container_Entry& E = new_entry(name);
+        out.write(S.data(), S.size());
+        E.size = S.size();
+        check_error();
+    }
+
+    // Writes the table of contents and the header. Must be called after all entries are added.
+    void finish(){
+        pad_to_alignment();
+        uint64_t toc_offset = out.tellp();
+        for(auto& keyval : entries){
+            write_uint64(keyval.first.size());
+            out.write(keyval.first.data(), keyval.first.size());
+            const Model_Container_Entry& E = keyval.second;
+            write_uint64(E.offset); write_uint64(E.size); write_uint64(E.kind);
+            write_uint64(E.size_in_bits); write_uint64(E.width);
+        }
+        out.seekp(0);
+        out.write(MODEL_CONTAINER_MAGIC, sizeof(MODEL_CONTAINER_MAGIC));
+        write_uint64(MODEL_CONTAINER_VERSION);
+        write_uint64(toc_offset);
+        write_uint64(entries.size());
+        out.flush();
+        check_error();
+        out.close();
+    }
+};
+
+class Model_Container{
+
+private:
+
+    Model_Container(const Model_Container&); // Prevent copy-construction
+    Model_Container& operator=(const Model_Container&);  // Prevent assignment
+
+    std::string path;
+    const char* data;
+    uint64_t file_size;
+    std::map<std::string, Model_Container_Entry> entries;
+
+    void error(std::string message){
+        throw std::runtime_error("Error reading model container " + path + ": " + message);
+    }
+
+    uint64_t read_uint64(uint64_t& pos){
+        if(pos > file_size || file_size - pos < sizeof(uint64_t)) error("truncated file");
+        uint64_t x;
+        memcpy(&x, data + pos, sizeof(x));
+        pos += sizeof(x);
+        return x;
+    }
+
+    // A deserialized entry is not read again. Its pages are dropped from the resident set of
+    // this process, so that the copy on the heap is not counted twice. They stay in the page cache.
+    void drop_pages(const Model_Container_Entry& E){
+        if(E.size > 0) madvise((void*)(data + E.offset), E.size, MADV_DONTNEED);
+    }
+
+    const Model_Container_Entry& get_entry(std::string name){
+        auto it = entries.find(name);
+        if(it == entries.end()) error("no entry " + name);
+        return it->second;
+    }
+
+public:
+
+    Model_Container(std::string path) : path(path), data(nullptr), file_size(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd == -1) error("could not open file");
+        struct stat st;
+        if(fstat(fd, &st) == -1){
+            close(fd);
+            error("could not stat file");
+        }
+        file_size = st.st_size;
+        if(file_size < MODEL_CONTAINER_ALIGNMENT){
+            close(fd);
+            error("file is too small");
+        }
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd); // The mapping stays valid after closing
+        if(mapping == MAP_FAILED) error("mmap failed");
+        data = (const char*)mapping;
+
+        if(memcmp(data, MODEL_CONTAINER_MAGIC, sizeof(MODEL_CONTAINER_MAGIC)) != 0) error("not a model container");
+        uint64_t pos = sizeof(MODEL_CONTAINER_MAGIC);
+        if(read_uint64(pos) != MODEL_CONTAINER_VERSION) error("unsupported version");
+        uint64_t toc_pos = read_uint64(pos);
+        uint64_t n_entries = read_uint64(pos);
+        for(uint64_t i = 0; i < n_entries; i++){
+            uint64_t name_length = read_uint64(toc_pos);
+            if(name_length > file_size - toc_pos) error("truncated file");
+            std::string name(data + toc_pos, name_length);
+            toc_pos += name_length;
+            Model_Container_Entry E;
+            E.offset = read_uint64(toc_pos); E.size = read_uint64(toc_pos); E.kind = read_uint64(toc_pos);
+            E.size_in_bits = read_uint64(toc_pos); E.width = read_uint64(toc_pos);
+            if(E.offset > file_size || E.size > file_size - E.offset) error("entry " + name + " is out of bounds"); // No overflow
+            entries[name] = E;
+        }
+    }
+
+    ~Model_Container(){
+        if(data != nullptr) munmap((void*)data, file_size);
+    }
+
+    bool contains(std::string name){
+        return entries.count(name) != 0;
+    }
+
+    std::string get_string(std::string name){
+        const Model_Container_Entry& E = get_entry(name);
+        return std::string(data + E.offset, E.size);
+    }
+
+    // Deserializes an object that has the member function load(std::istream&)
+    template<typename T>
+    void load_serializable(std::string name, T& x){
+        const Model_Container_Entry& E = get_entry(name);
+        Memory_Streambuf buf(data + E.offset, E.size);
+        std::istream in(&buf);
+        x.load(in);
+        if(in.fail()) error("could not deserialize " + name);
+        drop_pages(E);
+    }
+
+    // Deserializes an sdsl support structure for the vector v
+    template<typename S, typename V>
+    void load_support(std::string name, S& support, const V* v){
+        const Model_Container_Entry& E = get_entry(name);
+        Memory_Streambuf buf(data + E.offset, E.size);
+        std::istream in(&buf);
+        support.load(in, v);
+        if(in.fail()) error("could not deserialize " + name);
+        drop_pages(E);
+    }
+
+    // Points v to the words of the vector in the mapping without copying. The vector is
+    // read-only, must be released with release_int_vector before it is destroyed, and
+    // must not outlive the container.
+    template<uint8_t t_width>
+    void view_int_vector(std::string name, sdsl::int_vector<t_width>& v){
+        const Model_Container_Entry& E = get_entry(name);
+        if(E.kind != Model_Container_Entry::INT_VECTOR) error(name + " is not an int vector");
+        if(t_width != 0 && E.width != t_width) error(name + " has the wrong width");
+        if(E.size / 8 < E.size_in_bits / 64 + (E.size_in_bits % 64 != 0)) error(name + " is truncated"); // Fewer words than bits, without overflow
+        v.attach((const uint64_t*)(data + E.offset), E.size_in_bits, E.width);
+    }
+
+    template<uint8_t t_width>
+    static void release_int_vector(sdsl::int_vector<t_width>& v){
+        v.detach();
+    }
+
+    int64_t size_in_bytes(){
+        return file_size;
+    }
+
+    // The name and the number of bytes of every entry
+    std::vector<std::pair<std::string, int64_t>> entry_sizes(){
+        std::vector<std::pair<std::string, int64_t>> sizes;
+        for(auto& keyval : entries) sizes.push_back({keyval.first, (int64_t)keyval.second.size});
+        return sizes;
+    }
+};
+
+#endif
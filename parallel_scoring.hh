@@ -0,0 +1,50 @@
+#ifndef PARALLEL_SCORING_HH
+#define PARALLEL_SCORING_HH
+
+#include "score_string.hh"
+#include "batch_scoring.hh"
+#include "static_scoring.hh"
+#include "globals.hh"
+#include "Interfaces.hh"
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// Scores a batch of queries with n_threads threads. Every thread owns its own
+// scoring engine (see static_scoring.hh), and the model in G is shared read-only between the
+// threads. The scorer and the updater are shared too, so they must not have mutable
+// state. results[i] is set to the score of queries[i], so results come out in the
+// same order as the input regardless of which thread scored which query.
+void score_strings_parallel(const vector<string>& queries, vector<double>& results, Global_Data& G,
+                            Scoring_Function& scorer, Loop_Invariant_Updater& updater, bool lin_scoring, int64_t n_threads){
+
+    assert(n_threads >= 1);
+    results.resize(queries.size());
+
+    // Queries are handed out in small groups from a shared counter, so that threads
+    // that get short reads keep on taking more work
+    const int64_t group_size = 16;
+    std::atomic<int64_t> next_query(0);
+
+    auto worker = [&](){
+        std::shared_ptr<Scoring_Engine> engine;
+        if(!lin_scoring) engine = make_scoring_engine(G, scorer, updater);
+        while(true){
+            int64_t start = next_query.fetch_add(group_size);
+            if(start >= (int64_t)queries.size()) break;
+            int64_t end = min((int64_t)queries.size(), start + group_size);
+            if(lin_scoring) score_strings_lin_batched(queries, start, end, results, G);
+            else engine->score_batch(queries, start, end, results);
+        }
+    };
+
+    n_threads = max((int64_t)1, min(n_threads, (int64_t)queries.size()));
+    vector<std::thread> threads;
+    for(int64_t t = 0; t < n_threads - 1; t++) threads.push_back(std::thread(worker));
+    worker(); // The calling thread works too
+    for(std::thread& t : threads) t.join();
+}
+
+#endif
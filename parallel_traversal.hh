@@ -0,0 +1,132 @@
+#ifndef PARALLEL_TRAVERSAL_HH
+#define PARALLEL_TRAVERSAL_HH
+
+#include "Interfaces.hh"
+#include "Precalc.hh"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+// Parallel version of iterate_with_callbacks.
+//
+// The iterators are depth-first with an explicit stack, so after any number of steps the rest
+// of a sequential traversal is the traversal of the subtree of the top of the stack, then of
+// the next frame on the stack, and so on. The traversal is split into tasks in that order:
+// a task is either the subtree of a single frame, or a single node that was visited while
+// splitting. Tasks whose interval is large are split further by stepping an iterator started
+// from the frame of the task. The tasks are then run by n_threads threads, each task feeding
+// its own local copies of the callbacks. The local copies are merged back in task order, so
+// the callbacks see the results in the same order as in a sequential traversal.
+
+class Traversal_Task{
+public:
+    Iterator::Stack_frame frame;
+    bool whole_subtree; // If false, only the node itself is given to the callbacks
+    Traversal_Task(Iterator::Stack_frame frame, bool whole_subtree) : frame(frame), whole_subtree(whole_subtree) {}
+};
+
+// Splits the traversal into tasks such that no subtree task has an interval longer than
+// 1/granularity of the interval of the first visited node (the root), unless max_splits
+// is reached first.
+vector<Traversal_Task> split_traversal(Iterator& iterator, int64_t granularity, int64_t max_splits){
+
+    std::shared_ptr<Iterator> it = iterator.new_copy();
+    it->init();
+
+    vector<Traversal_Task> tasks;
+    if(!it->next()) return tasks; // Empty traversal
+    int64_t max_interval_size = max((int64_t)1, it->get_top().intervals.forward.size() / granularity);
+    tasks.push_back(Traversal_Task(it->get_top(), false));
+    for(Iterator::Stack_frame& F : it->get_pending()) tasks.push_back(Traversal_Task(F, true));
+
+    int64_t splits = 0;
+    bool changed = true;
+    while(changed && splits < max_splits){
+        changed = false;
+        vector<Traversal_Task> new_tasks;
+        for(Traversal_Task& T : tasks){
+            if(!T.whole_subtree || T.frame.intervals.forward.size() <= max_interval_size || splits >= max_splits){
+                new_tasks.push_back(T);
+                continue;
+            }
+            // Replace the task with the first node of the subtree and the subtrees that remain on the stack
+            changed = true;
+            splits++;
+            it->init(T.frame);
+            if(!it->next()) continue;
+            new_tasks.push_back(Traversal_Task(it->get_top(), false));
+            for(Iterator::Stack_frame& F : it->get_pending()) new_tasks.push_back(Traversal_Task(F, true));
+        }
+        tasks.swap(new_tasks);
+    }
+    return tasks;
+}
+
+void iterate_with_callbacks_parallel(Iterator& iterator, vector<Mergeable_Callback*>& callbacks, int64_t n_threads){
+
+    if(n_threads <= 1){
+        vector<Iterator_Callback*> sequential(callbacks.begin(), callbacks.end());
+        iterate_with_callbacks(iterator, sequential);
+        return;
+    }
+
+    // Make many more tasks than threads so that the threads that get small subtrees keep taking more work
+    vector<Traversal_Task> tasks = split_traversal(iterator, n_threads * 64, n_threads * 1024);
+
+    // Local results of finished tasks that have not been merged yet
+    vector<vector<std::shared_ptr<Mergeable_Callback>>> results(tasks.size());
+    vector<bool> done(tasks.size(), false);
+    int64_t next_to_merge = 0;
+    std::mutex merge_mutex;
+    std::atomic<int64_t> next_task(0);
+
+    auto worker = [&](){
+        std::shared_ptr<Iterator> it = iterator.new_copy();
+        while(true){
+            int64_t task_id = next_task.fetch_add(1);
+            if(task_id >= (int64_t)tasks.size()) break;
+
+            vector<std::shared_ptr<Mergeable_Callback>> locals;
+            for(Mergeable_Callback* cb : callbacks) locals.push_back(cb->new_local());
+
+            Traversal_Task& T = tasks[task_id];
+            if(T.whole_subtree){
+                it->init(T.frame);
+                while(it->next()){
+                    Iterator::Stack_frame top = it->get_top();
+                    for(std::shared_ptr<Mergeable_Callback>& cb : locals) cb->callback(top);
+                }
+            } else{
+                for(std::shared_ptr<Mergeable_Callback>& cb : locals) cb->callback(T.frame);
+            }
+
+            // Merge all finished tasks that are next in order
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            results[task_id].swap(locals);
+            done[task_id] = true;
+            while(next_to_merge < (int64_t)tasks.size() && done[next_to_merge]){
+                for(int64_t i = 0; i < (int64_t)callbacks.size(); i++)
+                    callbacks[i]->merge(*results[next_to_merge][i]);
+                results[next_to_merge].clear(); // Free memory
+                next_to_merge++;
+            }
+        }
+    };
+
+    vector<std::thread> threads;
+    for(int64_t t = 0; t < n_threads - 1; t++) threads.push_back(std::thread(worker));
+    worker(); // The calling thread works too
+    for(std::thread& t : threads) t.join();
+    assert(next_to_merge == (int64_t)tasks.size());
+
+    for(Mergeable_Callback* cb : callbacks) cb->finish();
+}
+
+void iterate_with_callbacks_parallel(Iterator& iterator, Mergeable_Callback* cb, int64_t n_threads){
+    vector<Mergeable_Callback*> callbacks = {cb};
+    iterate_with_callbacks_parallel(iterator, callbacks, n_threads);
+}
+
+#endif
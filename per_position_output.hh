@@ -0,0 +1,244 @@
+#ifndef PER_POSITION_OUTPUT_HH
+#define PER_POSITION_OUTPUT_HH
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdexcept>
+
+// Binary per-position output of score_string. All values are little-endian.
+//
+//   Header:  8 bytes "VOMMPOS1", u64 value format (0 = float32, 1 = float16),
+//            u64 fields (bit 0: window aggregate, bit 1: match depth, bit 2: context node),
+//            u64 window length (0 if no window aggregate)
+//   Records: one per character of every query, the queries one after another. A record is
+//            the log2-probability of the character, then the optional fields in this order:
+//            the sum of the log2-probabilities of the last min(window, position + 1)
+//            characters of the query in the value format, the length of the longest match
+//            before the character as u32 (saturated), and the topology node of that match as u64.
+//   Trailer: u64 length of every query, then u64 number of queries. The trailer comes last so
+//            that queries of unknown length can be streamed; readers find it from the end.
+
+enum class Per_Position_Format {F32 = 0, F16 = 1};
+
+const uint64_t PER_POSITION_WINDOW = 1;
+const uint64_t PER_POSITION_DEPTH = 2;
+const uint64_t PER_POSITION_NODE = 4;
+
+// IEEE 754 binary16 with round-to-nearest-even
+inline uint16_t float_to_half(float f){
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t raw_exp = (x >> 23) & 0xFF;
+    uint32_t mant = x & 0x7FFFFF;
+    if(raw_exp == 0xFF) return sign | 0x7C00 | (mant != 0 ? 0x200 : 0); // Infinity or NaN
+    int32_t exp = (int32_t)raw_exp - 127 + 15;
+    if(exp >= 31) return sign | 0x7C00; // Overflow to infinity
+    if(exp <= 0){
+        // Subnormal or zero
+        if(exp < -10) return sign;
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(rem > halfway || (rem == halfway && (half & 1))) half++;
+        return sign | half;
+    }
+    uint32_t half = sign | (exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1FFF;
+    if(rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++; // A carry into the exponent is correct
+    return half;
+}
+
+inline float half_to_float(uint16_t h){
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F;
+    uint32_t mant = h & 0x3FF;
+    if(exp == 0){
+        float v = ldexp((float)mant, -24);
+        return sign ? -v : v;
+    }
+    uint32_t bits;
+    if(exp == 31) bits = sign | 0x7F800000 | (mant << 13);
+    else bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Sum of the last window values, updated in constant time per value
+class Sliding_Window_Sum{
+
+private:
+
+    std::deque<double> values;
+    int64_t window;
+    long double sum; // Extra precision so that the additions and subtractions do not drift on long queries
+
+public:
+
+    Sliding_Window_Sum(int64_t window) : window(window), sum(0) {}
+
+    double add(double x){
+        values.push_back(x);
+        sum += x;
+        if((int64_t)values.size() > window){
+            sum -= values.front();
+            values.pop_front();
+        }
+        return sum;
+    }
+
+    void clear(){
+        values.clear();
+        sum = 0;
+    }
+};
+
+// Writes per-position records through a fixed-size buffer
+class Per_Position_Writer{
+
+private:
+
+    Per_Position_Writer(const Per_Position_Writer&); // Prevent copy-construction
+    Per_Position_Writer& operator=(const Per_Position_Writer&);  // Prevent assignment
+
+    std::string path;
+    FILE* out;
+    std::vector<char> buffer;
+    int64_t buffer_size;
+    Per_Position_Format format;
+    bool write_depth;
+    bool write_node;
+    int64_t window;
+    Sliding_Window_Sum window_sum;
+    std::vector<uint64_t> lengths; // Lengths of the finished queries
+    uint64_t current_length;
+
+    void flush(){
+        if(buffer_size > 0 && fwrite(buffer.data(), 1, buffer_size, out) != (size_t)buffer_size)
+            throw std::runtime_error("Error writing to disk: " + path);
+        buffer_size = 0;
+    }
+
+    template<typename T>
+    void put(T x){
+        if(buffer_size + (int64_t)sizeof(T) > (int64_t)buffer.size()) flush();
+        memcpy(buffer.data() + buffer_size, &x, sizeof(T));
+        buffer_size += sizeof(T);
+    }
+
+    void put_value(double x){
+        if(format == Per_Position_Format::F32) put<float>(x);
+        else put<uint16_t>(float_to_half(x));
+    }
+
+public:
+
+    // window = 0 means no window aggregate
+    Per_Position_Writer(std::string path, Per_Position_Format format, int64_t window, bool write_depth, bool write_node, int64_t buffer_bytes = (1 << 20))
+        : path(path), buffer(buffer_bytes), buffer_size(0), format(format), write_depth(write_depth), write_node(write_node),
+          window(window), window_sum(window), current_length(0) {
+        out = fopen(path.c_str(), "wb");
+        if(out == NULL) throw std::runtime_error("Could not open file for writing: " + path);
+        const char magic[8] = {'V','O','M','M','P','O','S','1'};
+        for(char c : magic) put<char>(c);
+        put<uint64_t>((uint64_t)format);
+        put<uint64_t>((window > 0 ? PER_POSITION_WINDOW : 0) | (write_depth ? PER_POSITION_DEPTH : 0) | (write_node ? PER_POSITION_NODE : 0));
+        put<uint64_t>(window);
+    }
+
+    ~Per_Position_Writer(){
+        if(out != NULL) fclose(out);
+    }
+
+    // Record of the next character of the current query
+    void add(double logprob, int64_t depth, int64_t node){
+        put_value(logprob);
+        if(window > 0) put_value(window_sum.add(logprob));
+        if(write_depth) put<uint32_t>(depth > (int64_t)UINT32_MAX ? UINT32_MAX : depth);
+        if(write_node) put<uint64_t>(node);
+        current_length++;
+    }
+
+    void end_query(){
+        lengths.push_back(current_length);
+        current_length = 0;
+        window_sum.clear();
+    }
+
+    // Writes the trailer. No records can be added after this.
+    void close(){
+        for(uint64_t x : lengths) put<uint64_t>(x);
+        put<uint64_t>(lengths.size());
+        flush();
+        if(fclose(out) != 0) throw std::runtime_error("Error writing to disk: " + path);
+        out = NULL;
+    }
+};
+
+// Reads a whole per-position file into memory. Fields that are not in the file are left empty.
+class Per_Position_File{
+
+private:
+
+    template<typename T>
+    T get(const std::vector<char>& data, int64_t& pos){
+        if(pos + (int64_t)sizeof(T) > (int64_t)data.size()) throw std::runtime_error("Per-position file is truncated");
+        T x;
+        memcpy(&x, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return x;
+    }
+
+public:
+
+    Per_Position_Format format;
+    int64_t window;
+    std::vector<uint64_t> lengths;
+    std::vector<std::vector<double>> logprobs; // One vector per query
+    std::vector<std::vector<double>> window_sums;
+    std::vector<std::vector<uint32_t>> depths;
+    std::vector<std::vector<uint64_t>> nodes;
+
+    Per_Position_File(std::string path){
+        FILE* in = fopen(path.c_str(), "rb");
+        if(in == NULL) throw std::runtime_error("Could not open file: " + path);
+        std::vector<char> data;
+        char block[1 << 16];
+        size_t n;
+        while((n = fread(block, 1, sizeof(block), in)) > 0) data.insert(data.end(), block, block + n);
+        fclose(in);
+
+        int64_t pos = 0;
+        if(data.size() < 32 || memcmp(data.data(), "VOMMPOS1", 8) != 0) throw std::runtime_error("Not a per-position file: " + path);
+        pos = 8;
+        format = (Per_Position_Format)get<uint64_t>(data, pos);
+        uint64_t fields = get<uint64_t>(data, pos);
+        window = get<uint64_t>(data, pos);
+
+        int64_t trailer_pos = (int64_t)data.size() - 8;
+        uint64_t n_queries = get<uint64_t>(data, trailer_pos);
+        trailer_pos = (int64_t)data.size() - 8 * (1 + (int64_t)n_queries);
+        for(uint64_t i = 0; i < n_queries; i++) lengths.push_back(get<uint64_t>(data, trailer_pos));
+
+        for(uint64_t length : lengths){
+            logprobs.push_back({}); window_sums.push_back({}); depths.push_back({}); nodes.push_back({});
+            for(uint64_t j = 0; j < length; j++){
+                for(int64_t k = 0; k < ((fields & PER_POSITION_WINDOW) ? 2 : 1); k++){
+                    double x = (format == Per_Position_Format::F32) ? get<float>(data, pos) : half_to_float(get<uint16_t>(data, pos));
+                    (k == 0 ? logprobs : window_sums).back().push_back(x);
+                }
+                if(fields & PER_POSITION_DEPTH) depths.back().push_back(get<uint32_t>(data, pos));
+                if(fields & PER_POSITION_NODE) nodes.back().push_back(get<uint64_t>(data, pos));
+            }
+        }
+    }
+};
+
+#endif
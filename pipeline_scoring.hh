@@ -0,0 +1,314 @@
+#ifndef PIPELINE_SCORING_HH
+#define PIPELINE_SCORING_HH
+
+#include "score_string.hh"
+#include "batch_scoring.hh"
+#include "static_scoring.hh"
+#include "input_reading.hh"
+#include "globals.hh"
+#include "logging.hh"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+// Scoring of a multi-FASTA file in three stages that run at the same time: a parser thread
+// reads the queries into batches, n_threads workers score the batches, and the calling thread
+// writes the scores in the order of the input. The stages are connected by bounded queues, so
+// a slow stage makes the others wait instead of filling the memory.
+
+// Waits with increasing pauses: first spins, then yields the processor, then sleeps
+class Backoff{
+
+private:
+
+    int64_t n_waits;
+
+public:
+
+    Backoff() : n_waits(0) {}
+
+    void wait(){
+        n_waits++;
+        if(n_waits < 64) return;
+        else if(n_waits < 256) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+};
+
+// Bounded multi-producer multi-consumer queue without locks (Dmitry Vyukov's algorithm). Every
+// cell has a sequence number that tells whether it is free for the producer or full for the
+// consumer of the current round. The capacity is rounded up to a power of two.
+template<typename T>
+class Bounded_Queue{
+
+private:
+
+    Bounded_Queue(const Bounded_Queue&); // Prevent copy-construction
+    Bounded_Queue& operator=(const Bounded_Queue&);  // Prevent assignment
+
+    struct Cell{
+        std::atomic<uint64_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> enqueue_pos; // On their own cache lines so that producers and consumers do not contend
+    alignas(64) std::atomic<uint64_t> dequeue_pos;
+    alignas(64) std::atomic<bool> closed;
+
+public:
+
+    Bounded_Queue(int64_t capacity) : enqueue_pos(0), dequeue_pos(0), closed(false) {
+        uint64_t size = 1;
+        while(size < (uint64_t)max(capacity, (int64_t)2)) size *= 2;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for(uint64_t i = 0; i < size; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Returns false if the queue is full
+    bool try_push(T& x){
+        uint64_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true){
+            cell = &cells[pos & mask];
+            int64_t diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)pos;
+            if(diff == 0){
+                if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if(diff < 0) return false;
+            else pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+        cell->data = std::move(x);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool try_pop(T& x){
+        uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true){
+            cell = &cells[pos & mask];
+            int64_t diff = (int64_t)cell->sequence.load(std::memory_order_acquire) - (int64_t)(pos + 1);
+            if(diff == 0){
+                if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if(diff < 0) return false;
+            else pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+        x = std::move(cell->data);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Waits until there is space
+    void push(T& x){
+        Backoff backoff;
+        while(!try_push(x)) backoff.wait();
+    }
+
+    // Waits until there is an element. Returns false if the queue is empty and closed.
+    bool pop(T& x){
+        Backoff backoff;
+        while(true){
+            if(try_pop(x)) return true;
+            if(closed.load(std::memory_order_acquire)) return try_pop(x); // Pushes made before closing are visible now
+            backoff.wait();
+        }
+    }
+
+    // No more pushes after this
+    void close(){
+        closed.store(true, std::memory_order_release);
+    }
+};
+
+// Work done by one stage of the pipeline. Busy and waiting times are summed over the threads of the stage.
+struct Stage_Counters{
+    std::atomic<int64_t> items; // Queries
+    std::atomic<int64_t> bytes;
+    std::atomic<int64_t> busy_ns;
+    std::atomic<int64_t> wait_ns; // Waiting for the neighbouring stages
+    Stage_Counters() : items(0), bytes(0), busy_ns(0), wait_ns(0) {}
+
+    string summary(string name, int64_t n_threads) const{
+        double busy = busy_ns / 1e9, wait = wait_ns / 1e9;
+        stringstream ss;
+        ss << std::fixed << std::setprecision(2) << name << ": " << items << " queries, " << bytes / 1e6 << " MB, busy "
+           << busy << " s, waiting " << wait << " s";
+        if(busy > 0) ss << ", " << bytes / 1e6 / (busy / n_threads) << " MB/s";
+        return ss.str();
+    }
+};
+
+class Timer{
+
+private:
+
+    std::chrono::steady_clock::time_point start;
+
+public:
+
+    Timer() : start(std::chrono::steady_clock::now()) {}
+
+    // Nanoseconds since the previous call or construction
+    int64_t lap(){
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+        start = now;
+        return ns;
+    }
+};
+
+struct Query_Batch{
+    int64_t id; // Position of the batch in the input
+    vector<string> queries;
+    vector<double> results;
+    string output; // The scores as text, one per line
+    Query_Batch() : id(-1) {}
+};
+
+class Scoring_Pipeline{
+
+private:
+
+    Scoring_Pipeline(const Scoring_Pipeline&); // Prevent copy-construction
+    Scoring_Pipeline& operator=(const Scoring_Pipeline&);  // Prevent assignment
+
+    Global_Data& G;
+    Scoring_Function& scorer;
+    Loop_Invariant_Updater& updater;
+    bool lin_scoring;
+    int64_t n_threads;
+    int64_t batch_size;
+
+    void parse(FASTA_reader& reader, Bounded_Queue<Query_Batch>& work){
+        Timer timer;
+        int64_t busy = 0, wait = 0;
+        for(int64_t id = 0; ; id++){
+            Query_Batch batch;
+            batch.id = id;
+            string query;
+            while((int64_t)batch.queries.size() < batch_size && reader.get_next_query(query)){
+                parser_counters.bytes += query.size();
+                batch.queries.push_back(query);
+            }
+            if(batch.queries.size() == 0) break;
+            parser_counters.items += batch.queries.size();
+            busy += timer.lap();
+            work.push(batch);
+            wait += timer.lap();
+        }
+        work.close();
+        busy += timer.lap();
+        parser_counters.busy_ns += busy;
+        parser_counters.wait_ns += wait;
+    }
+
+    void score(Bounded_Queue<Query_Batch>& work, Bounded_Queue<Query_Batch>& done){
+        std::shared_ptr<Scoring_Engine> engine;
+        if(!lin_scoring) engine = make_scoring_engine(G, scorer, updater);
+        Timer timer;
+        int64_t busy = 0, wait = 0;
+        Query_Batch batch;
+        while(true){
+            bool got = work.pop(batch);
+            wait += timer.lap();
+            if(!got) break;
+            int64_t n = batch.queries.size();
+            batch.results.resize(n);
+            if(lin_scoring) score_strings_lin_batched(batch.queries, 0, n, batch.results, G);
+            else engine->score_batch(batch.queries, 0, n, batch.results);
+            stringstream ss; // Formatted here so that the writer only copies bytes
+            for(double x : batch.results) ss << x << "\n";
+            batch.output = ss.str();
+            for(const string& S : batch.queries) scorer_counters.bytes += S.size();
+            scorer_counters.items += n;
+            batch.queries.clear();
+            busy += timer.lap();
+            done.push(batch);
+            wait += timer.lap();
+        }
+        scorer_counters.busy_ns += busy;
+        scorer_counters.wait_ns += wait;
+    }
+
+    void write(Bounded_Queue<Query_Batch>& done, std::ostream& out){
+        const int64_t flush_size = (1 << 20);
+        Timer timer;
+        int64_t busy = 0, wait = 0;
+        std::map<int64_t, Query_Batch> pending; // Batches that came before the ones preceding them
+        int64_t next_id = 0;
+        string buffer;
+        Query_Batch batch;
+        while(true){
+            bool got = done.pop(batch);
+            wait += timer.lap();
+            if(!got) break;
+            pending[batch.id] = std::move(batch);
+            while(pending.size() > 0 && pending.begin()->first == next_id){
+                Query_Batch& B = pending.begin()->second;
+                buffer += B.output;
+                writer_counters.items += B.results.size();
+                writer_counters.bytes += B.output.size();
+                pending.erase(pending.begin());
+                next_id++;
+                if((int64_t)buffer.size() >= flush_size){
+                    out.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            busy += timer.lap();
+        }
+        assert(pending.size() == 0);
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        busy += timer.lap();
+        writer_counters.busy_ns += busy;
+        writer_counters.wait_ns += wait;
+    }
+
+public:
+
+    Stage_Counters parser_counters;
+    Stage_Counters scorer_counters;
+    Stage_Counters writer_counters;
+
+    // The scorer and the updater are shared by the workers, so they must not have mutable state
+    Scoring_Pipeline(Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater, bool lin_scoring, int64_t n_threads, int64_t batch_size = 1024)
+        : G(G), scorer(scorer), updater(updater), lin_scoring(lin_scoring), n_threads(n_threads), batch_size(batch_size) {
+        assert(n_threads >= 1 && batch_size >= 1);
+    }
+
+    // Writes the score of every query of the FASTA file to out, one per line
+    void run(string fasta_filename, std::ostream& out){
+        FASTA_reader reader(fasta_filename);
+        Bounded_Queue<Query_Batch> work(2 * n_threads);
+        Bounded_Queue<Query_Batch> done(2 * n_threads);
+
+        std::thread parser([&](){ parse(reader, work); });
+        vector<std::thread> workers;
+        for(int64_t t = 0; t < n_threads; t++) workers.push_back(std::thread([&](){ score(work, done); }));
+        std::thread closer([&](){
+            for(std::thread& T : workers) T.join();
+            done.close();
+        });
+        write(done, out);
+        parser.join();
+        closer.join();
+    }
+
+    void write_counters_to_log(){
+        write_log("Pipeline " + parser_counters.summary("parser", 1));
+        write_log("Pipeline " + scorer_counters.summary("scorers", n_threads));
+        write_log("Pipeline " + writer_counters.summary("writer", 1));
+    }
+};
+
+#endif
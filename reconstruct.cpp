@@ -41,6 +41,18 @@ string read_raw_file(string filename){
     return str;
 }
 
+vector<string> split(string s, char delimiter){
+    stringstream test(s);
+    string segment;
+    vector<string> seglist;
+
+    while(getline(test, segment, delimiter))
+    {
+        seglist.push_back(segment);
+    }
+    return seglist;
+}
+
 class Reconstruction_Config{
     
 private:
@@ -51,6 +63,7 @@ private:
 public:
         
     bool context_stats;
+    bool from_scores;
     bool only_maxreps;
     bool run_length_coding;
     int64_t depth_bound;
@@ -59,14 +72,27 @@ public:
 
     string modeldir;
     string filename;
+    vector<string> sweep; // Thresholds of --sweep as given
     
-    Reconstruction_Config() : context_stats(false), only_maxreps(false), run_length_coding(false), depth_bound(-1), cf(nullptr) {}
+    Reconstruction_Config() : context_stats(false), from_scores(false), only_maxreps(false), run_length_coding(false), depth_bound(-1), cf(nullptr) {}
     
     void assert_all_ok(){
         assert(modeldir != "");
         assert(filename != "");
-        assert(cf != nullptr);
+        assert(cf != nullptr || from_scores);
         assert(depth_bound != -1);
+        if(from_scores && sweep.size() == 0){
+            cerr << "Error: --from-scores needs --sweep" << endl;
+            exit(-1);
+        }
+        if(context_stats && sweep.size() > 0){
+            cerr << "Error: --context-stats can not be used with --sweep" << endl;
+            exit(-1);
+        }
+    }
+    
+    string context_scores_path(){
+        return modeldir + "/" + filename + ".context_scores";
     }
     
     void load_info_file(){
@@ -84,6 +110,50 @@ public:
     
 };
 
+// One traversal of the BiBWT with the formula of C. Sets the contexts of G.
+void mark_contexts(Global_Data& G, Reconstruction_Config& C){
+    Depth_Bounded_SLT_Iterator iterator (G.bibwt.get(), C.depth_bound);
+    Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+    Stats_writer wr;
+    if(C.context_stats){
+        wr.set_file(C.modeldir + "/stats.depths_and_scores.txt");
+    }
+    C.cf->init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
+    iterate_with_callback(iterator, C.cf);
+    set_context_marks(G, C.cf->get_result());
+}
+
+// Marks the contexts with every threshold of --sweep. The scores of the contexts with the
+// smallest threshold are computed in one traversal, or loaded if --from-scores was given, and
+// every threshold then takes one pass over them. The contexts of threshold t are written next
+// to the model with the prefix filename + ".contexts_" + t, and the model itself is not changed.
+void sweep_thresholds(Global_Data& G, Reconstruction_Config& C){
+    Context_Scores scores;
+    if(C.from_scores){
+        write_log("Loading context scores from " + C.context_scores_path());
+        scores.load(C.context_scores_path());
+    } else{
+        double min_threshold = stod(C.sweep[0]);
+        for(string& t : C.sweep) min_threshold = min(min_threshold, stod(t));
+        if(!keep_context_scores(*C.cf, min_threshold)){
+            cerr << "Error: --sweep works only with --entropy, --KL and --pnorm" << endl;
+            exit(-1);
+        }
+        write_log("Scoring contexts with threshold " + to_string(min_threshold));
+        mark_contexts(G, C);
+        scores = *get_context_scores(*C.cf);
+        scores.finish();
+        scores.serialize(C.context_scores_path());
+        write_log("Stored " + to_string(scores.size()) + " context scores to " + C.context_scores_path());
+    }
+    
+    for(string& t : C.sweep){
+        set_context_marks(G, scores.get_marks(*G.rev_st_bpr, stod(t)));
+        G.store_contexts_to_disk(C.modeldir, C.filename + ".contexts_" + t);
+        write_log("Threshold " + t + ": " + to_string(G.rev_st_bpr_context_only->size() / 2) + " contexts");
+    }
+}
+
 int score_string_main(int argc, char** argv){
     
     if(argc < 4){
@@ -124,6 +194,11 @@ int score_string_main(int argc, char** argv){
             C.cf = new EQ234_Formula(t1,t2,t3,t4);
         } else if(argv[i] == string("--context-stats")){
             C.context_stats = true;
+        } else if(argv[i] == string("--sweep")){
+            i++;
+            C.sweep = split(argv[i], ',');
+        } else if(argv[i] == string("--from-scores")){
+            C.from_scores = true;
         } else{
             cerr << "Invalid argument: " << argv[i] << endl;
             return -1;
@@ -133,22 +208,26 @@ int score_string_main(int argc, char** argv){
     C.load_info_file();
     C.assert_all_ok();
     
+    Model_Profile stored_profile = Global_Data::stored_profile(C.modeldir, C.filename);
+    Model_Profile needed_profile = C.from_scores ? Model_Profile::SCORING : Model_Profile::FULL; // The BiBWT is needed for a traversal
+    if(stored_profile < needed_profile){
+        cerr << "Error: the model was stored with profile " << model_profile_to_string(stored_profile)
+             << ", but this needs profile " << model_profile_to_string(needed_profile) << endl;
+        return -1;
+    }
+    
     write_log("Loading the model from " + C.modeldir);
     Global_Data G;
-    G.load_all_from_disk(C.modeldir, C.filename, true);
-    write_log("Starting to rebuild contexts");
+    G.load_all_from_disk(C.modeldir, C.filename, !C.from_scores);
     
-    Depth_Bounded_SLT_Iterator iterator (G.bibwt.get(), C.depth_bound);
-    Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
-    Stats_writer wr;
-    if(C.context_stats){
-        wr.set_file(C.modeldir + "/stats.depths_and_scores.txt");
+    if(C.sweep.size() > 0){
+        sweep_thresholds(G, C);
+        write_log("Done");
+        return 0;
     }
-    C.cf->init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
-    iterate_with_callback(iterator, C.cf);
-    G.rev_st_context_marks = make_shared<Basic_bitvector>(C.cf->get_result());
-    G.rev_st_context_marks->init_rank_support();
-    G.rev_st_context_marks->init_select_support();
+    
+    write_log("Starting to rebuild contexts");
+    mark_contexts(G, C);
     
     if(C.context_stats){ 
         write_context_summary(G, C.cf->get_number_of_candidates(), C.modeldir + "/stats.context_summary.txt");
@@ -0,0 +1,130 @@
+#ifndef REFERENCE_READING_HH
+#define REFERENCE_READING_HH
+
+#include <zlib.h>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdio>
+#include <sys/stat.h>
+#include <iostream>
+
+// Reads the reference for build_model in fixed-size chunks straight into the string that is
+// given to the BWT construction, without buffering the whole file or the individual reads.
+// The files may be compressed with gzip. Uncompressed files are read as they are.
+
+class Reference_Reader{
+
+private:
+
+    Reference_Reader(const Reference_Reader&); // Prevent copy-construction
+    Reference_Reader& operator=(const Reference_Reader&);  // Prevent assignment
+
+    std::string filename;
+    gzFile file;
+    std::vector<char> chunk;
+
+    void error(std::string message){
+        std::cerr << "Error reading file " << filename << ": " << message << std::endl;
+        exit(-1);
+    }
+
+    // Returns the number of bytes read into the chunk. 0 means end of file.
+    int64_t read_chunk(){
+        int bytes = gzread(file, chunk.data(), chunk.size());
+        if(bytes < 0){
+            int errnum;
+            error(gzerror(file, &errnum));
+        }
+        return bytes;
+    }
+
+public:
+
+    Reference_Reader(std::string filename, int64_t chunk_size = (1 << 20)) : filename(filename), chunk(chunk_size) {
+        file = gzopen(filename.c_str(), "rb");
+        if(file == NULL) error("could not open file");
+        gzbuffer(file, chunk_size);
+    }
+
+    ~Reference_Reader(){
+        gzclose(file);
+    }
+
+    // Estimate of the number of bytes after decompression. For a gzip file this is the size
+    // stored at the end of the file, which is the true size modulo 2^32.
+    int64_t estimate_size(){
+        struct stat st;
+        if(stat(filename.c_str(), &st) != 0) return 0;
+        int64_t file_size = st.st_size;
+
+        FILE* fp = fopen(filename.c_str(), "rb");
+        if(fp == NULL) return file_size;
+        unsigned char magic[2] = {0,0};
+        int64_t estimate = file_size;
+        if(fread(magic, 1, 2, fp) == 2 && magic[0] == 0x1f && magic[1] == 0x8b && file_size >= 18){
+            unsigned char isize[4];
+            if(fseek(fp, -4, SEEK_END) == 0 && fread(isize, 1, 4, fp) == 4){
+                int64_t size_mod_32 = isize[0] | (isize[1] << 8) | (isize[2] << 16) | ((int64_t)isize[3] << 24);
+                estimate = size_mod_32;
+                while(estimate < file_size) estimate += ((int64_t)1 << 32); // Compressed data is never much larger
+            }
+        }
+        fclose(fp);
+        return estimate;
+    }
+
+    // Every byte of the file is a character of the reference
+    void read_raw(std::string& reference){
+        reference.clear();
+        reference.reserve(estimate_size());
+        append_raw(reference);
+    }
+    
+    // Concatenation of all the sequences in a multi-FASTA file. Header lines are skipped and
+    // the trailing whitespace of every sequence line is removed, like in parse_FASTA.
+    void read_FASTA(std::string& reference){
+        reference.clear();
+        reference.reserve(estimate_size()); // Upper bound
+        append_FASTA(reference);
+    }
+    
+    // Versions that append the characters to any sink with push_back(char) and append(const char*, size_t)
+    template<typename sink_t>
+    void append_raw(sink_t& sink){
+        int64_t bytes;
+        while((bytes = read_chunk()) > 0) sink.append(chunk.data(), bytes);
+    }
+    
+    template<typename sink_t>
+    void append_FASTA(sink_t& sink){
+        bool line_start = true;
+        bool in_header = false;
+        std::string pending_whitespace; // Written only if the line continues after it
+        int64_t bytes;
+        while((bytes = read_chunk()) > 0){
+            for(int64_t i = 0; i < bytes; i++){
+                char c = chunk[i];
+                if(line_start){
+                    in_header = (c == '>');
+                    line_start = false;
+                }
+                if(c == '\n'){
+                    pending_whitespace.clear();
+                    line_start = true;
+                } else if(!in_header){
+                    if(isspace((unsigned char)c)) pending_whitespace += c;
+                    else{
+                        if(pending_whitespace.size() > 0){
+                            sink.append(pending_whitespace.data(), pending_whitespace.size());
+                            pending_whitespace.clear();
+                        }
+                        sink.push_back(c);
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,108 @@
+//
+//  score_server.cpp
+//
+//  Loads VOMM models once and scores queries sent to a Unix domain socket.
+//  The protocol is described in score_server.hh.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <csignal>
+#include "score_server.hh"
+#include "logging.hh"
+
+using namespace std;
+
+Score_Server* running_server = nullptr; // Stopped by SIGINT and SIGTERM
+
+void stop_running_server(int signal){
+    (void) signal; // Silence unused variable compiler warning
+    if(running_server != nullptr) running_server->stop();
+}
+
+int main(int argc, char** argv){
+
+    if(argc == 1){
+        cerr << "Keeps VOMM indexes in memory and scores queries sent to a Unix domain socket" << endl;
+        cerr << "Usage: see README.md" << endl;
+        return -1;
+    }
+
+    string socket_path;
+    int64_t n_threads = 1;
+    Score_Server_Limits limits;
+    vector<vector<string> > model_args; // name, directory, file
+    for(int64_t i = 1; i < argc; i++){
+        if(argv[i] == string("--socket")){
+            i++;
+            if(i >= argc){
+                cerr << "Error: --socket needs a path" << endl;
+                return -1;
+            }
+            socket_path = argv[i];
+        } else if(argv[i] == string("--model")){
+            if(i + 3 >= argc){
+                cerr << "Error: --model needs a name, a directory and a file" << endl;
+                return -1;
+            }
+            model_args.push_back({argv[i+1], argv[i+2], argv[i+3]});
+            i += 3;
+        } else if(argv[i] == string("--threads")){
+            i++;
+            n_threads = stoll(argv[i]);
+            if(n_threads < 1){
+                cerr << "Error: number of threads must be at least 1" << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--max-sequence-length") || argv[i] == string("--max-request-bytes") || argv[i] == string("--max-sequences")){
+            string flag = argv[i];
+            i++;
+            if(i >= argc || stoll(argv[i]) < 1){
+                cerr << "Error: " << flag << " needs a positive integer" << endl;
+                return -1;
+            }
+            uint64_t value = stoll(argv[i]);
+            if(flag == "--max-sequence-length") limits.max_sequence_length = value;
+            if(flag == "--max-request-bytes") limits.max_request_bytes = value;
+            if(flag == "--max-sequences") limits.max_sequences = value;
+        } else{
+            cerr << "Invalid argument: " << argv[i] << endl;
+            return -1;
+        }
+    }
+
+    if(socket_path == ""){
+        cerr << "Error: socket path not given" << endl;
+        return -1;
+    }
+    if(model_args.size() == 0){
+        cerr << "Error: no models given" << endl;
+        return -1;
+    }
+
+    try{
+        Score_Server server(socket_path, n_threads, limits);
+        for(vector<string>& args : model_args){
+            write_log("Loading model " + args[0] + " from " + args[1]);
+            server.add_model(args[0], load_server_model(args[1], args[2]));
+        }
+        server.listen();
+        running_server = &server;
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stop_running_server;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        write_log("Listening on " + socket_path + " with " + to_string(n_threads) + " threads");
+        server.run(); // Removes the socket file when stopped
+        running_server = nullptr;
+        write_log("Stopped");
+    } catch(const std::runtime_error& e){
+        cerr << "Error: " << e.what() << endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,672 @@
+#ifndef SCORE_SERVER_HH
+#define SCORE_SERVER_HH
+
+#include "score_string.hh"
+#include "batch_scoring.hh"
+#include "static_scoring.hh"
+#include "globals.hh"
+#include "logging.hh"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <queue>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+// Keeps models in memory and scores sequences against them for clients that connect to a Unix
+// domain socket. One thread reads the requests and writes the responses of all connections
+// without waiting for any of them, and a fixed pool of threads scores the requests that have
+// been read in full. A connection can send any number of requests one after another, and they
+// are answered in order.
+//
+// Wire format. All integers are unsigned 64-bit little-endian, doubles are IEEE 754 binary64
+// little-endian, and a string is its length followed by its bytes.
+//   Request:  string model name, string options, integer n, n strings (the sequences)
+//   Response: integer status. If the status is 0: integer n and n doubles, the log-probabilities
+//             of the sequences in the order of the request. Otherwise: string error message.
+// The options are separated by spaces: "escapeprob=<probability>", "recursive-fallback" and
+// "lin-scoring", with the same meaning as the flags of score_string.
+
+const uint64_t SCORE_SERVER_STATUS_OK = 0;
+const uint64_t SCORE_SERVER_STATUS_ERROR = 1;
+const uint64_t SCORE_SERVER_MAX_NAME_LENGTH = (uint64_t)1 << 16; // Of the model name and the options
+const uint64_t SCORE_SERVER_MAX_MESSAGE_LENGTH = (uint64_t)1 << 20; // Of an error message, read by the client
+
+// Bounds on one request, so that a corrupt or hostile request can not make the server allocate
+// without limit. A request over a limit gets an error response, and the connection is closed
+// because the rest of the request is not read.
+class Score_Server_Limits{
+public:
+    uint64_t max_sequence_length; // Bytes of one sequence
+    uint64_t max_request_bytes; // Bytes of a whole request on the wire
+    uint64_t max_sequences; // Sequences in one request
+
+    Score_Server_Limits() : max_sequence_length((uint64_t)1 << 24), max_request_bytes((uint64_t)1 << 28), max_sequences((uint64_t)1 << 20) {}
+};
+
+// A message that is over a limit
+class Score_Server_Limit_Error : public std::runtime_error{
+public:
+    Score_Server_Limit_Error(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Reads and writes the wire format on a connected socket. Throws std::runtime_error on errors.
+// read_u64 and read_string return false on a clean end of stream.
+class Socket_Stream{
+
+private:
+
+    int fd;
+
+public:
+
+    Socket_Stream(int fd) : fd(fd) {}
+
+    // Returns false if the stream ended before the first byte
+    bool read_exact(char* data, int64_t size){
+        int64_t done = 0;
+        while(done < size){
+            ssize_t n = recv(fd, data + done, size - done, 0);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0) throw std::runtime_error("Error reading from socket: " + std::string(strerror(errno)));
+            if(n == 0){
+                if(done == 0) return false;
+                throw std::runtime_error("Connection closed in the middle of a message");
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    void write_all(const char* data, int64_t size){
+        int64_t done = 0;
+        while(done < size){
+            ssize_t n = send(fd, data + done, size - done, MSG_NOSIGNAL);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0) throw std::runtime_error("Error writing to socket: " + std::string(strerror(errno)));
+            done += n;
+        }
+    }
+
+    static uint64_t decode_u64(const char* bytes){
+        uint64_t x = 0;
+        for(int64_t i = 7; i >= 0; i--) x = (x << 8) | (uint8_t)bytes[i];
+        return x;
+    }
+
+    bool read_u64(uint64_t& x){
+        char bytes[8];
+        if(!read_exact(bytes, 8)) return false;
+        x = decode_u64(bytes);
+        return true;
+    }
+
+    uint64_t read_u64(){
+        uint64_t x;
+        if(!read_u64(x)) throw std::runtime_error("Connection closed in the middle of a message");
+        return x;
+    }
+
+    // Throws Score_Server_Limit_Error if the string is longer than max_length
+    bool read_string(std::string& S, uint64_t max_length){
+        uint64_t length;
+        if(!read_u64(length)) return false;
+        if(length > max_length) throw Score_Server_Limit_Error("String of " + std::to_string(length) + " bytes in message is longer than the limit of " + std::to_string(max_length));
+        S.assign(length, '\0');
+        if(length > 0 && !read_exact(&S[0], length)) throw std::runtime_error("Connection closed in the middle of a message");
+        return true;
+    }
+
+    std::string read_string(uint64_t max_length){
+        std::string S;
+        if(!read_string(S, max_length)) throw std::runtime_error("Connection closed in the middle of a message");
+        return S;
+    }
+
+    double read_double(){
+        uint64_t bits = read_u64();
+        double x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    // The append functions encode into a buffer that is sent later
+    static void append_u64(std::string& out, uint64_t x){
+        for(int64_t i = 0; i < 8; i++){
+            out.push_back((char)(x & 0xFF));
+            x >>= 8;
+        }
+    }
+
+    static void append_string(std::string& out, const std::string& S){
+        append_u64(out, S.size());
+        out.append(S);
+    }
+
+    static void append_double(std::string& out, double x){
+        uint64_t bits;
+        memcpy(&bits, &x, sizeof(x));
+        append_u64(out, bits);
+    }
+
+    void write_u64(uint64_t x){
+        std::string bytes;
+        append_u64(bytes, x);
+        write_all(bytes.data(), bytes.size());
+    }
+
+    void write_string(const std::string& S){
+        write_u64(S.size());
+        write_all(S.data(), S.size());
+    }
+
+    void write_double(double x){
+        uint64_t bits;
+        memcpy(&bits, &x, sizeof(x));
+        write_u64(bits);
+    }
+};
+
+class Score_Request{
+public:
+    std::string model;
+    double escapeprob;
+    bool recursive_fallback;
+    bool lin_scoring;
+    std::vector<std::string> sequences;
+
+    Score_Request() : escapeprob(-1), recursive_fallback(false), lin_scoring(false) {}
+
+    void parse_options(const std::string& options){
+        std::stringstream ss(options);
+        std::string option;
+        while(ss >> option){
+            if(option.substr(0, 11) == "escapeprob="){
+                try{
+                    escapeprob = std::stod(option.substr(11));
+                } catch(const std::exception& e){
+                    throw std::runtime_error("Invalid escape probability: " + option);
+                }
+            }
+            else if(option == "recursive-fallback") recursive_fallback = true;
+            else if(option == "lin-scoring") lin_scoring = true;
+            else throw std::runtime_error("Invalid option: " + option);
+        }
+        if(!lin_scoring && (escapeprob < 0 || escapeprob > 1))
+            throw std::runtime_error("Option escapeprob=<probability> is required unless lin-scoring is given");
+    }
+};
+
+// Parses requests from the bytes of a connection as they arrive, so that reading a request
+// never waits for the client. Throws Score_Server_Limit_Error if a request is over the limits.
+class Request_Reader{
+
+private:
+
+    Score_Server_Limits limits;
+    std::string buffer; // Bytes that have arrived but are not parsed yet
+    int64_t field; // Next field of the request: 0 model name, 1 options, 2 number of sequences, 3 sequences
+    uint64_t n; // Number of sequences in the request
+    uint64_t bytes; // Bytes of the request parsed so far
+
+    // Parses a string at buffer[pos..] if it has arrived in full
+    bool parse_string(int64_t& pos, std::string& S, uint64_t max_length){
+        if(buffer.size() - pos < 8) return false;
+        uint64_t length = Socket_Stream::decode_u64(&buffer[pos]);
+        if(length > max_length) throw Score_Server_Limit_Error("String of " + std::to_string(length) + " bytes in message is longer than the limit of " + std::to_string(max_length));
+        if(bytes + 8 + length > limits.max_request_bytes) throw Score_Server_Limit_Error("Request is longer than the limit of " + std::to_string(limits.max_request_bytes) + " bytes");
+        if(buffer.size() - pos - 8 < length) return false;
+        S.assign(buffer, pos + 8, length);
+        pos += 8 + length;
+        bytes += 8 + length;
+        return true;
+    }
+
+    // Continues from the field where the previous call stopped
+    bool parse_fields(int64_t& pos){
+        if(field == 0){
+            if(!parse_string(pos, request.model, SCORE_SERVER_MAX_NAME_LENGTH)) return false;
+            field = 1;
+        }
+        if(field == 1){
+            if(!parse_string(pos, options, SCORE_SERVER_MAX_NAME_LENGTH)) return false;
+            field = 2;
+        }
+        if(field == 2){
+            if(buffer.size() - pos < 8) return false;
+            n = Socket_Stream::decode_u64(&buffer[pos]);
+            if(n > limits.max_sequences) throw Score_Server_Limit_Error("Request has " + std::to_string(n) + " sequences, more than the limit of " + std::to_string(limits.max_sequences));
+            pos += 8;
+            bytes += 8;
+            field = 3;
+        }
+        while(request.sequences.size() < n){
+            std::string S;
+            if(!parse_string(pos, S, limits.max_sequence_length)) return false;
+            request.sequences.push_back(S);
+        }
+        return true;
+    }
+
+public:
+
+    Score_Request request;
+    std::string options;
+
+    Request_Reader(const Score_Server_Limits& limits) : limits(limits), field(0), n(0), bytes(0) {}
+
+    void append(const char* data, int64_t size){
+        buffer.append(data, size);
+    }
+
+    // True if a request has started to arrive but is not complete
+    bool in_request() const{
+        return field > 0 || buffer.size() > 0;
+    }
+
+    // Parses what has arrived. Returns true if request and options have a whole request. After
+    // that the request must be taken with next before parsing again.
+    bool parse(){
+        int64_t pos = 0;
+        bool complete = parse_fields(pos);
+        buffer.erase(0, pos);
+        return complete;
+    }
+
+    void next(){
+        request = Score_Request();
+        options.clear();
+        field = 0;
+        n = 0;
+        bytes = 0;
+    }
+};
+
+// A model that stays in memory for the lifetime of the server
+class Server_Model{
+public:
+    std::shared_ptr<Global_Data> G;
+    bool only_maxreps;
+    bool entropy_contexts; // Context type of the model is entropy
+    Model_Profile profile; // With LIN, only the structures of lin scoring are loaded
+
+    Server_Model(std::shared_ptr<Global_Data> G, bool only_maxreps, bool entropy_contexts, Model_Profile profile)
+        : G(G), only_maxreps(only_maxreps), entropy_contexts(entropy_contexts), profile(profile) {}
+};
+
+// Loads a model built by build_model from directory/filename, like score_string does
+std::shared_ptr<Server_Model> load_server_model(std::string directory, std::string filename){
+    std::string info_path = directory + "/" + filename + ".info";
+    std::ifstream info(info_path);
+    bool only_maxreps, run_length_coding;
+    std::string context_type;
+    int64_t depth_bound;
+    info >> only_maxreps >> context_type >> run_length_coding >> depth_bound;
+    if(!info.good()) throw std::runtime_error("Error reading file: " + info_path);
+
+    std::shared_ptr<Global_Data> G = make_shared<Global_Data>();
+    Model_Profile profile = Global_Data::stored_profile(directory, filename);
+    std::string container_path = directory + "/" + filename + ".model";
+    bool container = std::ifstream(container_path).good();
+    if(profile == Model_Profile::LIN){
+        if(container) G->load_structures_that_lin_scoring_needs_from_container(container_path);
+        else G->load_structures_that_lin_scoring_needs(directory, filename);
+    } else{
+        if(container) G->load_all_from_container(container_path);
+        else G->load_all_from_disk(directory, filename, false);
+    }
+    return make_shared<Server_Model>(G, only_maxreps, context_type == "entropy", profile);
+}
+
+class Score_Server{
+
+private:
+
+    Score_Server(const Score_Server&); // Prevent copy-construction
+    Score_Server& operator=(const Score_Server&);  // Prevent assignment
+
+    // A client. While a request of the connection is queued or scored, or its response has not
+    // been sent in full, the connection is not read, so that its requests are answered in order
+    // and a client that does not read its responses can not make the server buffer without limit.
+    class Connection{
+    public:
+        int fd;
+        Request_Reader reader;
+        bool busy; // The request is with the workers
+        std::string response; // Not sent yet
+        int64_t response_pos; // Bytes of response sent so far
+        bool close_after_response; // The rest of the request was not read
+        Connection(int fd, const Score_Server_Limits& limits) : fd(fd), reader(limits), busy(false), response_pos(0), close_after_response(false) {}
+    };
+
+    std::map<std::string, std::shared_ptr<Server_Model>> models;
+    std::string socket_path;
+    int listen_fd;
+    int wake_pipe[2]; // A byte to wake_pipe[1] wakes up the poll of run
+    int64_t n_threads;
+    Score_Server_Limits limits;
+
+    std::atomic<bool> stopping;
+    std::map<int, std::shared_ptr<Connection>> connections; // Only run touches these
+    std::queue<std::shared_ptr<Connection>> pending_requests; // Read in full, waiting for a worker
+    std::vector<std::shared_ptr<Connection>> answered; // Back from the workers, waiting for run
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+
+    std::vector<double> score(Score_Request& request){
+        auto it = models.find(request.model);
+        if(it == models.end()) throw std::runtime_error("No such model: " + request.model);
+        Server_Model& M = *it->second;
+
+        std::vector<double> results(request.sequences.size());
+        if(request.lin_scoring){
+            score_strings_lin_batched(request.sequences, 0, request.sequences.size(), results, *M.G);
+            return results;
+        }
+        if(M.profile < Model_Profile::SCORING)
+            throw std::runtime_error("Model " + request.model + " was stored with profile " + model_profile_to_string(M.profile) + ", which supports only lin-scoring");
+
+        std::shared_ptr<Scoring_Function> scorer;
+        if(request.recursive_fallback) scorer = make_shared<Recursive_Scorer>(request.escapeprob, M.entropy_contexts);
+        else scorer = make_shared<Basic_Scorer>(request.escapeprob, M.entropy_contexts);
+        scorer->use_context_counts(M.G->context_counts.get());
+        std::shared_ptr<Loop_Invariant_Updater> updater;
+        if(M.only_maxreps) updater = make_shared<Maxrep_Pruned_Updater>();
+        else updater = make_shared<Basic_Updater>();
+
+        make_scoring_engine(*M.G, *scorer, *updater)->score_batch(request.sequences, 0, request.sequences.size(), results);
+        return results;
+    }
+
+    // Scores the request that the reader of the connection has and encodes the response. The
+    // thread of run sends it.
+    void answer(Connection& C){
+        // Errors in the request are reported to the client, and the connection stays open
+        Score_Request& request = C.reader.request;
+        std::vector<double> results;
+        std::string error;
+        try{
+            request.parse_options(C.reader.options);
+            results = score(request);
+        } catch(const std::exception& e){
+            error = e.what();
+        }
+
+        if(error == ""){
+            Socket_Stream::append_u64(C.response, SCORE_SERVER_STATUS_OK);
+            Socket_Stream::append_u64(C.response, results.size());
+            for(double x : results) Socket_Stream::append_double(C.response, x);
+        } else{
+            Socket_Stream::append_u64(C.response, SCORE_SERVER_STATUS_ERROR);
+            Socket_Stream::append_string(C.response, error);
+        }
+    }
+
+    void worker(){
+        while(true){
+            std::shared_ptr<Connection> C;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_cv.wait(lock, [this](){ return stopping || !pending_requests.empty(); });
+                if(stopping) return;
+                C = pending_requests.front();
+                pending_requests.pop();
+            }
+            answer(*C);
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                answered.push_back(C);
+            }
+            wake();
+        }
+    }
+
+    // Async-signal-safe
+    void wake(){
+        char byte = 0;
+        ssize_t ignored = write(wake_pipe[1], &byte, 1); // If the pipe is full, run wakes up anyway
+        (void)ignored;
+    }
+
+    void close_connection(int fd){
+        close(fd);
+        connections.erase(fd);
+    }
+
+    // Queues the request of the connection for the workers if it has arrived in full
+    void parse_request(std::shared_ptr<Connection> C){
+        try{
+            if(!C->reader.parse()) return;
+        } catch(const Score_Server_Limit_Error& e){
+            // The rest of the request is not read, so the connection can not continue
+            write_log(std::string("Dropping a connection: ") + e.what());
+            Socket_Stream::append_u64(C->response, SCORE_SERVER_STATUS_ERROR);
+            Socket_Stream::append_string(C->response, e.what());
+            C->close_after_response = true;
+            write_to(C);
+            return;
+        } catch(const std::exception& e){
+            write_log(std::string("Dropping a connection: ") + e.what());
+            close_connection(C->fd);
+            return;
+        }
+        C->busy = true;
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        pending_requests.push(C);
+        queue_cv.notify_one();
+    }
+
+    // Sends as much of the response as the socket takes without waiting. The rest is sent when
+    // poll reports that the socket can take more. Once the response is sent in full, the next
+    // request of the connection is parsed.
+    void write_to(std::shared_ptr<Connection> C){
+        while(C->response_pos < (int64_t)C->response.size()){
+            ssize_t n = send(C->fd, C->response.data() + C->response_pos, C->response.size() - C->response_pos, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if(n < 0 && errno == EINTR) continue;
+            if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if(n < 0){
+                write_log("Dropping a connection: Error writing to socket: " + std::string(strerror(errno)));
+                close_connection(C->fd);
+                return;
+            }
+            C->response_pos += n;
+        }
+        C->response.clear();
+        C->response_pos = 0;
+        if(C->close_after_response){
+            close_connection(C->fd);
+            return;
+        }
+        C->reader.next();
+        parse_request(C); // The next request may have arrived already
+    }
+
+    void read_from(std::shared_ptr<Connection> C){
+        char data[1 << 16];
+        ssize_t n = recv(C->fd, data, sizeof(data), MSG_DONTWAIT);
+        if(n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if(n < 0) write_log("Dropping a connection: Error reading from socket: " + std::string(strerror(errno)));
+        if(n == 0 && C->reader.in_request()) write_log("Dropping a connection: Connection closed in the middle of a message");
+        if(n <= 0){
+            close_connection(C->fd);
+            return;
+        }
+        C->reader.append(data, n);
+        parse_request(C);
+    }
+
+    void accept_connection(){
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if(fd == -1){
+            if(errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+                write_log("Error accepting a connection: " + std::string(strerror(errno)));
+            return;
+        }
+        connections[fd] = std::make_shared<Connection>(fd, limits);
+    }
+
+    // Starts sending the responses that the workers have encoded
+    void take_answered(){
+        char bytes[256];
+        while(read(wake_pipe[0], bytes, sizeof(bytes)) > 0); // Drain
+        std::vector<std::shared_ptr<Connection>> done;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            done.swap(answered);
+        }
+        for(std::shared_ptr<Connection>& C : done){
+            C->busy = false;
+            write_to(C);
+        }
+    }
+
+public:
+
+    Score_Server(std::string socket_path, int64_t n_threads, Score_Server_Limits limits = Score_Server_Limits())
+        : socket_path(socket_path), listen_fd(-1), n_threads(n_threads), limits(limits), stopping(false) {
+        assert(n_threads >= 1);
+        if(pipe(wake_pipe) == -1) throw std::runtime_error("Could not create a pipe: " + std::string(strerror(errno)));
+        for(int fd : {wake_pipe[0], wake_pipe[1]}) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~Score_Server(){
+        if(listen_fd != -1) close(listen_fd);
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+    }
+
+    void add_model(std::string name, std::shared_ptr<Server_Model> model){
+        if(models.count(name) != 0) throw std::runtime_error("Duplicate model name: " + name);
+        models[name] = model;
+    }
+
+    // Creates the socket. After this clients can connect, and they are served once run is called.
+    void listen(){
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(socket_path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long: " + socket_path);
+        strcpy(address.sun_path, socket_path.c_str());
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listen_fd == -1) throw std::runtime_error("Could not create socket: " + std::string(strerror(errno)));
+        fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK); // A client may leave before accept
+        unlink(socket_path.c_str()); // Left over from an earlier server
+        if(bind(listen_fd, (sockaddr*)&address, sizeof(address)) == -1)
+            throw std::runtime_error("Could not bind socket " + socket_path + ": " + std::string(strerror(errno)));
+        if(::listen(listen_fd, 128) == -1)
+            throw std::runtime_error("Could not listen on socket " + socket_path + ": " + std::string(strerror(errno)));
+    }
+
+    // Serves clients until stop is called. Then removes the socket file.
+    void run(){
+        assert(listen_fd != -1);
+        std::vector<std::thread> threads;
+        for(int64_t t = 0; t < n_threads; t++) threads.push_back(std::thread(&Score_Server::worker, this));
+
+        while(!stopping){
+            std::vector<pollfd> polled = {{wake_pipe[0], POLLIN, 0}, {listen_fd, POLLIN, 0}};
+            for(auto& keyval : connections){
+                if(keyval.second->busy) continue;
+                short events = keyval.second->response.empty() ? POLLIN : POLLOUT;
+                polled.push_back({keyval.first, events, 0});
+            }
+            if(poll(polled.data(), polled.size(), -1) == -1){
+                if(errno == EINTR) continue;
+                write_log("Error waiting for clients: " + std::string(strerror(errno)));
+                break;
+            }
+            if(stopping) break;
+            if(polled[0].revents != 0) take_answered();
+            if(polled[1].revents != 0) accept_connection();
+            for(int64_t i = 2; i < polled.size(); i++){
+                if(polled[i].revents == 0) continue;
+                auto it = connections.find(polled[i].fd);
+                if(it == connections.end() || it->second->busy) continue; // Closed or requeued by take_answered
+                if(polled[i].events == POLLOUT) write_to(it->second);
+                else read_from(it->second);
+            }
+        }
+
+        // The workers finish the request they are scoring and take no more
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+            while(!pending_requests.empty()) pending_requests.pop();
+        }
+        queue_cv.notify_all();
+        for(std::thread& t : threads) t.join();
+        for(auto& keyval : connections) close(keyval.first);
+        connections.clear();
+        answered.clear();
+        unlink(socket_path.c_str());
+    }
+
+    // Makes run return. The requests that have not been answered are dropped, and the
+    // connections are closed. Async-signal-safe, so it can be called from a signal handler.
+    void stop(){
+        stopping = true;
+        wake();
+    }
+};
+
+// Client side of the protocol
+class Score_Client{
+
+private:
+
+    Score_Client(const Score_Client&); // Prevent copy-construction
+    Score_Client& operator=(const Score_Client&);  // Prevent assignment
+
+    int fd;
+
+public:
+
+    Score_Client(std::string socket_path){
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(socket_path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long: " + socket_path);
+        strcpy(address.sun_path, socket_path.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd == -1) throw std::runtime_error("Could not create socket: " + std::string(strerror(errno)));
+        if(connect(fd, (sockaddr*)&address, sizeof(address)) == -1){
+            close(fd);
+            throw std::runtime_error("Could not connect to " + socket_path + ": " + std::string(strerror(errno)));
+        }
+    }
+
+    ~Score_Client(){
+        close(fd);
+    }
+
+    // Throws std::runtime_error with the message of the server if the server reports an error
+    std::vector<double> score(std::string model, std::string options, const std::vector<std::string>& sequences){
+        Socket_Stream stream(fd);
+        stream.write_string(model);
+        stream.write_string(options);
+        stream.write_u64(sequences.size());
+        for(const std::string& S : sequences) stream.write_string(S);
+
+        uint64_t status = stream.read_u64();
+        if(status != SCORE_SERVER_STATUS_OK) throw std::runtime_error(stream.read_string(SCORE_SERVER_MAX_MESSAGE_LENGTH));
+        std::vector<double> results(stream.read_u64());
+        for(double& x : results) x = stream.read_double();
+        return results;
+    }
+};
+
+#endif
@@ -21,7 +21,11 @@
 #include "Precalc.hh"
 #include "input_reading.hh"
 #include "score_string.hh"
+#include "static_scoring.hh"
+#include "chunked_scoring.hh"
+#include "pipeline_scoring.hh"
 #include "logging.hh"
+#include "per_position_output.hh"
 
 using namespace std;
 
@@ -59,16 +63,25 @@ public:
     double escapeprob;
     string modeldir;
     string reference_filename;
+    string contexts; // Threshold of a set of contexts from reconstruct --sweep, or empty
     bool run_length_coding;
     bool recursive_fallback;
     bool lin_scoring;
     int64_t depth_bound;
+    int64_t n_threads;
+    string per_position_path; // Empty if no per-position output
+    Per_Position_Format per_position_format;
+    int64_t per_position_window;
+    bool per_position_depth;
+    bool per_position_node;
+    string instrumentation_path; // Empty if no instrumentation output
     
     Scoring_Function* scorer;
     Loop_Invariant_Updater* updater;
     
     Scoring_Config() : input_mode(Input_Mode::UNDEFINED), only_maxreps(false), context_type(Context_Type::UNDEFINED), 
-    escapeprob(-1), run_length_coding(false), recursive_fallback(false), lin_scoring(false), depth_bound(-1), scorer(nullptr), updater(nullptr)
+    escapeprob(-1), run_length_coding(false), recursive_fallback(false), lin_scoring(false), depth_bound(-1), n_threads(1),
+    per_position_format(Per_Position_Format::F32), per_position_window(0), per_position_depth(false), per_position_node(false), scorer(nullptr), updater(nullptr)
      {}
     
     ~Scoring_Config(){
@@ -86,6 +99,9 @@ public:
         assert(scorer != nullptr);
         assert(updater != nullptr);
         assert(depth_bound != -1);
+        assert(n_threads >= 1);
+        assert(per_position_window >= 0);
+        if(lin_scoring) assert(!per_position_depth && !per_position_node);
     }
     
     void load_info_file(){
@@ -110,6 +126,16 @@ public:
     
 };
 
+// Scores one query and writes its per-position records
+template<typename input_stream_t>
+double score_per_position(input_stream_t& input, Global_Data& G, Scoring_Config& C, Topology_Supports* supports, Per_Position_Writer& writer){
+    double score;
+    if(C.lin_scoring) score = score_string_lin_per_position(input, G, writer);
+    else score = main_loop_per_position(input, G, *supports->topology, *C.scorer, *C.updater, writer);
+    writer.end_query();
+    return score;
+}
+
 int main(int argc, char** argv){
     if(argc < 4){
         cerr << "Computes the probability of string against a VOMM index" << endl;
@@ -134,6 +160,9 @@ int main(int argc, char** argv){
         } else if(argv[i] == string("--file")){
             i++;
             C.reference_filename = argv[i];
+        } else if(argv[i] == string("--contexts")){
+            i++;
+            C.contexts = argv[i];
         } else if(argv[i] == string("--escapeprob")){
             i++;
             C.escapeprob = stod(argv[i]);
@@ -141,6 +170,38 @@ int main(int argc, char** argv){
             C.recursive_fallback = true;
         } else if(argv[i] == string("--lin-scoring")){
             C.lin_scoring = true;
+        } else if(argv[i] == string("--threads")){
+            i++;
+            C.n_threads = stoll(argv[i]);
+            if(C.n_threads < 1){
+                cerr << "Error: number of threads must be at least 1" << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--per-position")){
+            i++;
+            C.per_position_path = argv[i];
+        } else if(argv[i] == string("--per-position-format")){
+            i++;
+            if(argv[i] == string("f32")) C.per_position_format = Per_Position_Format::F32;
+            else if(argv[i] == string("f16")) C.per_position_format = Per_Position_Format::F16;
+            else{
+                cerr << "Error: per-position format must be f32 or f16" << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--per-position-window")){
+            i++;
+            C.per_position_window = stoll(argv[i]);
+            if(C.per_position_window < 1){
+                cerr << "Error: window must be at least 1" << endl;
+                return -1;
+            }
+        } else if(argv[i] == string("--per-position-depth")){
+            C.per_position_depth = true;
+        } else if(argv[i] == string("--per-position-node")){
+            C.per_position_node = true;
+        } else if(argv[i] == string("--instrumentation")){
+            i++;
+            C.instrumentation_path = argv[i];
         } else{
             cerr << "Invalid argument: " << argv[i] << endl;
             return -1;
@@ -149,6 +210,27 @@ int main(int argc, char** argv){
     
     C.load_info_file();
     
+    if(C.lin_scoring && (C.per_position_depth || C.per_position_node)){
+        cerr << "Error: --per-position-depth and --per-position-node are not available with --lin-scoring" << endl;
+        return -1;
+    }
+    
+    if(C.lin_scoring && C.contexts != ""){
+        cerr << "Error: --contexts is not available with --lin-scoring, which does not use contexts" << endl;
+        return -1;
+    }
+    
+    if(C.instrumentation_path != ""){
+        if(!SCORING_INSTRUMENTATION_ENABLED){
+            cerr << "Error: --instrumentation needs a build with instrumentation (make score_string_instrumented)" << endl;
+            return -1;
+        }
+        if(C.lin_scoring || C.n_threads > 1 || C.per_position_path != ""){
+            cerr << "Error: --instrumentation is not available with --lin-scoring, --threads or --per-position" << endl;
+            return -1;
+        }
+    }
+    
     if(C.recursive_fallback){
         C.scorer = new Recursive_Scorer(C.escapeprob, (C.context_type == Scoring_Config::Context_Type::ENTROPY));
     } else{
@@ -164,33 +246,126 @@ int main(int argc, char** argv){
 
     C.assert_all_ok();
     
+    Model_Profile stored_profile = Global_Data::stored_profile(C.modeldir, C.reference_filename);
+    if(!C.lin_scoring && stored_profile < Model_Profile::SCORING){
+        cerr << "Error: the model was stored with profile " << model_profile_to_string(stored_profile)
+             << ", which has only the structures that --lin-scoring needs" << endl;
+        return -1;
+    }
+    
     write_log("Loading the model from " + C.modeldir);
     Global_Data G;
-    if(C.lin_scoring)
-        G.load_structures_that_lin_scoring_needs(C.modeldir, C.reference_filename);
-    else
-        G.load_all_from_disk(C.modeldir, C.reference_filename, false);
+    string container_path = C.modeldir + "/" + C.reference_filename + ".model";
+    if(ifstream(container_path).good()){
+        // Single-file model: memory-mapped
+        if(C.lin_scoring)
+            G.load_structures_that_lin_scoring_needs_from_container(container_path);
+        else
+            G.load_all_from_container(container_path);
+    } else{
+        if(C.lin_scoring)
+            G.load_structures_that_lin_scoring_needs(C.modeldir, C.reference_filename);
+        else
+            G.load_all_from_disk(C.modeldir, C.reference_filename, false);
+    }
+    if(C.contexts != ""){
+        if(ifstream(container_path).good()){
+            cerr << "Error: --contexts needs a model that is not a single file" << endl;
+            return -1;
+        }
+        G.load_contexts_from_disk(C.modeldir, C.reference_filename + ".contexts_" + C.contexts);
+    }
+    C.scorer->use_context_counts(G.context_counts.get()); // Null if the model has no table
     write_log("Starting to score ");
+    
+    if(C.instrumentation_path != ""){
+        // One query at a time on this thread, so that the counts of the thread after a FASTA
+        // record are the counts of that record
+        ofstream out(C.instrumentation_path);
+        std::shared_ptr<Scoring_Engine> engine = make_scoring_engine(G, *C.scorer, *C.updater);
+        Scoring_Instrumentation& counts = Scoring_Instrumentation::local();
+        Scoring_Instrumentation run;
+        int64_t n_records = 0;
+        if(C.input_mode == Scoring_Config::Input_Mode::RAW){
+            Raw_file_stream rfs(C.query_filename);
+            counts.reset();
+            cout << engine->score(rfs) << endl;
+            run += counts;
+        } else{
+            FASTA_reader fr(C.query_filename);
+            for(; !fr.done(); n_records++){
+                Read_stream input = fr.get_next_query_stream();
+                counts.reset();
+                double score = engine->score(input);
+                cout << score << "\n";
+                out << "{\"scope\": \"record\", \"record\": " << n_records << ", \"score\": " << score << ", \"counters\": " << counts.to_json() << "}\n";
+                run += counts;
+            }
+            cout << flush;
+        }
+        out << "{\"scope\": \"run\", \"records\": " << n_records << ", \"counters\": " << run.to_json() << "}\n";
+        if(!out.good()){
+            cerr << "Error writing to file " << C.instrumentation_path << endl;
+            return -1;
+        }
+        write_log("Done");
+        return 0;
+    }
+    
+    if(C.per_position_path != ""){
+        // One query at a time, streaming the records of every character to the file
+        Per_Position_Writer writer(C.per_position_path, C.per_position_format, C.per_position_window, C.per_position_depth, C.per_position_node);
+        Topology_Supports* supports = C.lin_scoring ? nullptr : new Topology_Supports(G);
+        if(C.input_mode == Scoring_Config::Input_Mode::RAW){
+            Raw_file_stream rfs(C.query_filename);
+            cout << score_per_position(rfs, G, C, supports, writer) << "\n";
+        } else{
+            FASTA_reader fr(C.query_filename);
+            while(!fr.done()){
+                Read_stream input = fr.get_next_query_stream();
+                cout << score_per_position(input, G, C, supports, writer) << "\n";
+            }
+        }
+        cout << flush;
+        writer.close();
+        delete supports;
+        write_log("Done");
+        return 0;
+    }
         
     if(C.input_mode == Scoring_Config::Input_Mode::RAW){
         Raw_file_stream rfs(C.query_filename);
         if(C.lin_scoring){
             cout << score_string_lin(rfs,G) << endl;
+        } else if(C.n_threads > 1){
+            // Split the query into chunks that are scored in parallel
+            Chunked_Raw_Scorer chunked(G, *C.scorer, *C.updater, C.n_threads);
+            cout << chunked.score_file(C.query_filename) << endl;
         } else{
-            cout << score_string(rfs, G, *C.scorer, *C.updater) << endl;
+            std::shared_ptr<Scoring_Engine> engine = make_scoring_engine(G, *C.scorer, *C.updater);
+            cout << engine->score(rfs) << endl;
         }
     }
     
-    if(C.input_mode == Scoring_Config::Input_Mode::FASTA){
+    if(C.input_mode == Scoring_Config::Input_Mode::FASTA && C.n_threads > 1){
+        // Parse, score and write at the same time. The queries are scored in parallel.
+        Scoring_Pipeline pipeline(G, *C.scorer, *C.updater, C.lin_scoring, C.n_threads);
+        pipeline.run(C.query_filename, cout);
+        pipeline.write_counters_to_log();
+    }
+    else if(C.input_mode == Scoring_Config::Input_Mode::FASTA){
         FASTA_reader fr(C.query_filename);
+        std::shared_ptr<Scoring_Engine> engine;
+        if(!C.lin_scoring) engine = make_scoring_engine(G, *C.scorer, *C.updater);
         while(!fr.done()){
             Read_stream input = fr.get_next_query_stream();
             if(C.lin_scoring){
-                cout << score_string_lin(input,G) << endl;
+                cout << score_string_lin(input,G) << "\n";
             } else{
-                cout << score_string(input, G, *C.scorer, *C.updater) << endl;
+                cout << engine->score(input) << "\n";
             }
         }
+        cout << flush;
     }
     
     write_log("Done");
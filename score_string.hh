@@ -16,6 +16,7 @@
 #include "Basic_bitvector.hh"
 #include "RLE_bitvector.hh"
 #include "logging.hh"
+#include "scoring_instrumentation.hh"
 #include <stack>
 #include <vector>
 #include <memory>
@@ -26,6 +27,10 @@ class Full_Topology_Mapper;
 //enum Context_Type {ENTROPY,EQ234,PNORM,KL}; // Should be made into a class so it can take arbitrary parameters for thresholds
 
 sdsl::bit_vector get_rev_st_bpr_context_only(Global_Data* G){ // Todo: move to precalc.hh?
+    Basic_bitvector* bpr = dynamic_cast<Basic_bitvector*>(G->rev_st_bpr.get());
+    Basic_bitvector* marks = dynamic_cast<Basic_bitvector*>(G->rev_st_context_marks.get());
+    if(bpr != nullptr && marks != nullptr) return compact_under_mask(bpr->bv, marks->bv); // 64 positions at a time
+    
     int64_t nMarked = G->rev_st_context_marks->rank(G->rev_st_context_marks->size());
     
     // Build bpr for marked only
@@ -63,55 +68,94 @@ public:
 
     // Operations in topology:
     int64_t rev_st_string_depth(node_t node){
-        return SDS->string_depth(node);
+        return INSTRUMENTED(STRING_DEPTH, SDS->string_depth(node));
     }
     
     node_t rev_st_parent(node_t node){
         int64_t close = data->rev_st_bpr->find_close(node);
-        return PS.parent(Interval(node,close)).left;
+        return INSTRUMENTED(PARENT, PS.parent(Interval(node,close)).left);
     }
     
     node_t rev_st_lma(node_t node){
-        return LMAS.LMA(node);
+        return INSTRUMENTED(LMA, LMAS.LMA(node));
+    }
+    
+    bool rev_st_is_maxrep(node_t node){
+        return data->rev_st_maximal_marks->at(node);
+    }
+    
+    int64_t rev_st_context_rank(node_t node){
+        return INSTRUMENTED(CONTEXT_RANK, LMAS.marked_preorder_rank(node));
     }
     
     // Mapping between colex intervals and topology nodes
     node_t leaves_to_node(Interval I){
-        return mapper->leaves_to_node(I);
+        return INSTRUMENTED(LEAVES_TO_NODE, mapper->leaves_to_node(I));
     };
     
     Interval node_to_leaves(node_t node){
-        return mapper->node_to_leaves(node);
+        return INSTRUMENTED(NODE_TO_LEAVES, mapper->node_to_leaves(node));
     }
 };
 
+// The loop invariant of main_loop between two characters of the query
+struct Main_Loop_State{
+    Interval I; // Colex interval of the longest match
+    int64_t string_depth; // Length of the longest match
+    double logprob; // Score so far
+    int64_t node; // Topology node of the longest match before the last character
+    Main_Loop_State(Global_Data& data) : I(0,data.revbwt->size()-1), string_depth(0), logprob(0), node(0) {} // todo: or: index.empty_string()
+};
+
+// Processes the next character c of the query. Returns the log-probability of c.
+inline double main_loop_step(Main_Loop_State& state, char c, Global_Data& data, Topology& topo_alg, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    int64_t node = topo_alg.leaves_to_node(state.I);
+    state.node = node;
+
+    // Compute log-probability of c
+    double logprob = scorer.score(/*I,*/ node, state.string_depth, c, topo_alg, *data.revbwt, data);
+    state.logprob += logprob;
+
+    // Update I and string_depth
+    pair<Interval, int64_t> new_values = updater.update(state.I, node, state.string_depth, c, data, topo_alg, *data.revbwt);
+    state.I = new_values.first;
+    state.string_depth = new_values.second;
+    INSTRUMENT_END_CHARACTER();
+    return logprob;
+}
+
 template<typename inputstream_t>
 double main_loop(inputstream_t& S, Global_Data& data, Topology& topo_alg, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
-    double logprob = 0;
-    Interval I(0,data.revbwt->size()-1); // todo: or: index.empty_string()
-    int64_t node; 
-    int64_t string_depth = 0;
-    char c;
+    Main_Loop_State state(data);
+    const char* begin; const char* end;
     
-    while(S.getchar(c)){
-        node=topo_alg.leaves_to_node(I);
+    while(S.next_block(begin, end))
+        for(const char* p = begin; p != end; p++) main_loop_step(state, *p, data, topo_alg, scorer, updater);
+    return state.logprob;
+}
 
-        // Compute log-probability of c
-        logprob += scorer.score(/*I,*/ node, string_depth, c, topo_alg, *data.revbwt, data);
-        
-        // Update I and string_depth
-	pair<Interval, int64_t> new_values = updater.update(I,node,string_depth, c, data, topo_alg, *data.revbwt);
-        I = new_values.first;
-        string_depth = new_values.second;
+// Like main_loop, but also gives the log-probability, the length of the longest match and the
+// node of the longest match at every character to sink.add(logprob, depth, node)
+template<typename inputstream_t, typename sink_t>
+double main_loop_per_position(inputstream_t& S, Global_Data& data, Topology& topo_alg, Scoring_Function& scorer, Loop_Invariant_Updater& updater, sink_t& sink){
+    Main_Loop_State state(data);
+    const char* begin; const char* end;
+    
+    while(S.next_block(begin, end)){
+        for(const char* p = begin; p != end; p++){
+            int64_t depth = state.string_depth;
+            double logprob = main_loop_step(state, *p, data, topo_alg, scorer, updater);
+            sink.add(logprob, depth, state.node);
+        }
     }
-    return logprob;
+    return state.logprob;
 }
 
 template<typename T> void init_support(T&, Global_Data*);
 
 template<> void init_support<LMA_Support>(LMA_Support& LMAS, Global_Data* G){
     LMAS = LMA_Support(G->rev_st_context_marks,
-             G->rev_st_bpr_context_only);
+             G->rev_st_bpr_context_only, G->rev_st_lma_pointers);
 
 }
 
@@ -127,7 +171,10 @@ template<> void init_support<Pruned_Topology_Mapper>(Pruned_Topology_Mapper& map
     mapper = Pruned_Topology_Mapper(G->rev_st_bpr, G->pruning_marks);
 }
 
-class Basic_Updater : public Loop_Invariant_Updater {
+// The updaters and the scorers implement their function in a template on the topology and
+// the BWT, so that Static_Scoring_Engine can call it with concrete types (see static_scoring.hh).
+
+class Basic_Updater final : public Loop_Invariant_Updater {
 
 // Right-extend. If failure, take parent and try again untill success
     
@@ -135,10 +182,15 @@ public:
 
     pair<Interval, int64_t> update(Interval I,int64_t node, int64_t d, char c, Global_Data& data, Topology& topology, BWT& index){
         (void) data; // Not needed. Make the compiler happy.
+        return update_impl(I, node, d, c, topology, index);
+    }
+    
+    template<typename topology_t, typename bwt_t>
+    pair<Interval, int64_t> update_impl(Interval I,int64_t node, int64_t d, char c, topology_t& topology, bwt_t& index){
         bool recalculate_depth = false;
         Interval I_Wc;
         while(true){
-            I_Wc = index.search(I,c);
+            I_Wc = INSTRUMENTED(BWT_SEARCH, index.search(I,c));
             if(I_Wc.size() != 0) break;
             node = topology.rev_st_parent(node); // Take parent
             I = topology.node_to_leaves(node); // Map back to colex interval
@@ -148,7 +200,7 @@ public:
         
         if(recalculate_depth){
             // Need to recalculate depth
-            assert(data.rev_st_maximal_marks->at(node)); // Should be at a maxrep
+            assert(topology.rev_st_is_maxrep(node)); // Should be at a maxrep
             d = topology.rev_st_string_depth(node); // Guaranteed to be at a maxrep
         }
         
@@ -158,7 +210,7 @@ public:
 
 
 
-class Maxrep_Pruned_Updater : public Loop_Invariant_Updater { // The same as non-depth bounded?
+class Maxrep_Pruned_Updater final : public Loop_Invariant_Updater { // The same as non-depth bounded?
 
 // Right-extend. If failure, go to the nearest non-pruned node and try again.
 // If failure, take parent and try again until successs
@@ -167,16 +219,22 @@ public:
         
     // See the base class for documentation on what this function is suppposed to do
     pair<Interval, int64_t> update(Interval I, int64_t node,int64_t d, char c, Global_Data& data, Topology& topology, BWT& index){
+        (void) data; // Not needed. Make the compiler happy.
+        return update_impl(I, node, d, c, topology, index);
+    }
+    
+    template<typename topology_t, typename bwt_t>
+    pair<Interval, int64_t> update_impl(Interval I, int64_t node,int64_t d, char c, topology_t& topology, bwt_t& index){
         bool recalculate_depth = false;
         bool first_iteration = true;
         Interval I_Wc;
         while(true){
-            I_Wc = index.search(I,c);
+            I_Wc = INSTRUMENTED(BWT_SEARCH, index.search(I,c));
             if(I_Wc.size() != 0) break;
             if(I.size() == index.size()) return {I,0}; // c not found in the index at all
             if(first_iteration){
-                // Go up to the nearest non-pruned node
-                node = topology.leaves_to_node(I);
+                // Go up to the nearest non-pruned node, which is the given node of I, so it
+                // does not need to be mapped again
                 I = topology.node_to_leaves(node);
                 first_iteration = false;
             } else{
@@ -189,11 +247,11 @@ public:
         if(recalculate_depth){
             // Need to recalculate depth
             int64_t bpr_pos = node;
-            if(data.rev_st_maximal_marks->at(bpr_pos)){
+            if(topology.rev_st_is_maxrep(bpr_pos)){
                 d = topology.rev_st_string_depth(bpr_pos);
             } else{
                 int64_t parent = topology.rev_st_parent(bpr_pos);
-                assert(data.rev_st_maximal_marks->at(parent)); // Should be at a maxrep
+                assert(topology.rev_st_is_maxrep(parent)); // Should be at a maxrep
                 d = topology.rev_st_string_depth(parent) + 1; // One character left-extension of a maxrep
             }
         }
@@ -203,18 +261,44 @@ public:
 };
 
 
-class Basic_Scorer : public Scoring_Function {
+// Number of occurrences of c after the context at node, and the number of occurrences of the
+// context. From the table if there is one, otherwise from the BWT.
+template<typename topology_t, typename bwt_t>
+inline void context_counts_of(int64_t node, char c, topology_t& topology, bwt_t& index, Context_Count_Table* table, int64_t& count, int64_t& total){
+    if(table != nullptr){
+        int64_t context = topology.rev_st_context_rank(node);
+        count = table->count(context, c);
+        total = table->total(context);
+    } else{
+        Interval I = topology.node_to_leaves(node);
+        count = INSTRUMENTED(BWT_SEARCH, index.search(I, c)).size();
+        total = I.size();
+    }
+}
+
+class Basic_Scorer final : public Scoring_Function {
 
 public:
 
     double escape_prob;
     bool maxrep_contexts;
+    Context_Count_Table* context_counts; // Null if the counts are taken from the BWT
 
-    Basic_Scorer(double escape_prob, bool maxrep_contexts) : escape_prob(escape_prob), maxrep_contexts(maxrep_contexts) {}
+    Basic_Scorer(double escape_prob, bool maxrep_contexts) : escape_prob(escape_prob), maxrep_contexts(maxrep_contexts), context_counts(nullptr) {}
+    
+    void use_context_counts(Context_Count_Table* table){
+        context_counts = table;
+    }
 
     // See the base class for documentation on what this function is suppposed to do
     double score(/*Interval I,*/int64_t node, int64_t d, char c, Topology& topology, BWT& index, Global_Data& G){
-        if(maxrep_contexts && G.rev_st_maximal_marks->at(node) == 1 && topology.rev_st_string_depth(node) > d){
+        (void) G; // Not needed. Make the compiler happy.
+        return score_impl(node, d, c, topology, index);
+    }
+    
+    template<typename topology_t, typename bwt_t>
+    double score_impl(int64_t node, int64_t d, char c, topology_t& topology, bwt_t& index){
+        if(maxrep_contexts && topology.rev_st_is_maxrep(node) && topology.rev_st_string_depth(node) > d){
             // Inside an edge -> lex interval I represents the node at the end that is further
             // away from the root -> need to go to the edge closest to the root first
             // before taking the lowest marked ancestor, because otherwise the lowest common
@@ -223,29 +307,30 @@ public:
             node = topology.rev_st_parent(node);
         }
         node = topology.rev_st_lma(node);
-        Interval I = topology.node_to_leaves(node);
-
-        // Compute the probability of S[i]
-        Interval R = index.search(I, c);
+        int64_t count, total;
+        context_counts_of(node, c, topology, index, context_counts, count, total);
         
-        if(R.size() == 0){
+        if(count == 0){
+            INSTRUMENT_ESCAPE();
             return log2(escape_prob);
         } else{
             // don't count in the dollar in the interval of the empty string, hence -1
-            return log2((double)R.size()) - log2(min(I.size(), index.size()-1));
+            return log2((double)count) - log2(min(total, index.size()-1));
         }
     }
 
 };
 
-class Recursive_Scorer : public Scoring_Function {
+class Recursive_Scorer final : public Scoring_Function {
 
 public:
 
     double escape_prob;
     bool maxrep_contexts;
+    Context_Count_Table* context_counts; // Null if the counts are taken from the BWT
     
-    int64_t get_context_depth(int64_t open, Topology& topology){
+    template<typename topology_t>
+    int64_t get_context_depth(int64_t open, topology_t& topology){
         if(maxrep_contexts) return topology.rev_st_string_depth(open);
         else{
             if(open == 0) return 0; // Root is a special case: It's not a left-extension of a maxrep
@@ -254,10 +339,20 @@ public:
     }
 
     Recursive_Scorer(double escape_prob, bool maxrep_contexts) 
-    : escape_prob(escape_prob), maxrep_contexts(maxrep_contexts) {}
+    : escape_prob(escape_prob), maxrep_contexts(maxrep_contexts), context_counts(nullptr) {}
+    
+    void use_context_counts(Context_Count_Table* table){
+        context_counts = table;
+    }
 
     virtual double score(/*Interval I,*/ int64_t node,int64_t d, char c, Topology& topology, BWT& index, Global_Data& G){
-        if(maxrep_contexts && G.rev_st_maximal_marks->at(node) == 1 && topology.rev_st_string_depth(node) > d){
+        (void) G; // Not needed. Make the compiler happy.
+        return score_impl(node, d, c, topology, index);
+    }
+    
+    template<typename topology_t, typename bwt_t>
+    double score_impl(int64_t node,int64_t d, char c, topology_t& topology, bwt_t& index){
+        if(maxrep_contexts && topology.rev_st_is_maxrep(node) && topology.rev_st_string_depth(node) > d){
             // Inside an edge -> lex interval I represents the node at the end that is further
             // away from the root -> need to go to the edge closest to the root first
             // before taking the lowest marked ancestor, because otherwise the lowest common
@@ -266,13 +361,12 @@ public:
             node = topology.rev_st_parent(node);
         }
         node = topology.rev_st_lma(node);
-        Interval I = topology.node_to_leaves(node);
-
-        // Compute the probability of S[i]
-        Interval R = index.search(I, c);
+        int64_t count, total;
+        context_counts_of(node, c, topology, index, context_counts, count, total);
         
-        if(R.size() == 0){
+        if(count == 0){
             // Did not find c
+            INSTRUMENT_ESCAPE();
             if(d == 0) return log2(escape_prob); // Root
             
             int64_t depth1 = get_context_depth(node, topology);
@@ -281,12 +375,12 @@ public:
             int64_t depth2 = get_context_depth(node, topology);
             assert(depth1 != depth2);
             int64_t distance_travelled = depth1 - depth2;
-            double ancestor_score = score(/*I,*/ node, depth2, c, topology, index, G);
+            double ancestor_score = score_impl(/*I,*/ node, depth2, c, topology, index);
             ancestor_score += distance_travelled * log2(escape_prob);
             return ancestor_score;
         } else{
             // Found c
-            return log2(1 - escape_prob) + log2(R.size()) - log2(min(I.size(), index.size()-1));
+            return log2(1 - escape_prob) + log2((double)count) - log2(min(total, index.size()-1));
             // Don't count in the dollar the context in the interval of the empty string, hence -1
         }
     }
@@ -300,7 +394,7 @@ public:
     std::string S;
     int64_t pos;
     
-    Input_Stream(string& S) : S(S), pos(0) {}
+    Input_Stream(const string& S) : S(S), pos(0) {}
     
     bool getchar(char& c){
         if(pos == S.size()){
@@ -311,8 +405,62 @@ public:
             return true;
         }
     }
+    
+    // The rest of the string at once
+    bool next_block(const char*& begin, const char*& end){
+        if(pos == S.size()) return false;
+        begin = S.data() + pos;
+        end = S.data() + S.size();
+        pos = S.size();
+        return true;
+    }
+};
+
+// The state of score_string_lin between two characters of the query
+struct Lin_Scoring_State{
+    Interval I_W; // BWT interval of the current context W
+    int64_t sizeFrom; // Size of I_W
+    double out; // Score so far
+    Lin_Scoring_State(Global_Data& G) : I_W(0,G.revbwt->size()-1), sizeFrom(G.revbwt->size()), out(0) {}
 };
 
+// Processes the next character c of the query. Returns the log-probability of c that was added
+// to state.out, or 0 if c does not occur in the reference.
+inline double lin_scoring_step(Lin_Scoring_State& state, char c, Global_Data& G, Pruned_Topology_Mapper& mapper, Parent_Support& PS){
+    const int64_t BWT_SIZE = G.revbwt->size();
+    int64_t sizeTo, node;
+    double logSizeFrom, logSizeTo;
+    Interval I_Wc;
+    
+    // Finding the BWT interval of the longest suffix of W that is followed by c
+    node=-1;
+    while (true) {
+        I_Wc=G.revbwt->search(state.I_W,c);
+        sizeTo=I_Wc.size();
+        if (sizeTo==0) {
+            if (state.sizeFrom==BWT_SIZE)   // c does not occur in the text
+                break;
+            if (node==-1) node=mapper.leaves_to_node(state.I_W);  // Map to topology
+            node=PS.parent(node);  // Take parent
+            state.I_W=mapper.node_to_leaves(node);  // Map back to revbwt
+            state.sizeFrom = state.I_W.size();
+        } else break;
+    }
+    
+    if (I_Wc.size() == 0) return 0;
+    logSizeFrom = log2(min(BWT_SIZE-1,state.sizeFrom)); // We don't want to count in the final dollar
+    
+    // Cumulating the probability
+    logSizeTo=log2(sizeTo);
+    double logprob = logSizeTo-logSizeFrom;
+    state.out+=logprob;
+    
+    // Next iteration
+    state.I_W=I_Wc;
+    state.sizeFrom=sizeTo;
+    return logprob;
+}
+
 /**  
  * Scores a string S using the simple method described in the paper:
  *
@@ -322,49 +470,29 @@ public:
  * @return the base-2 logarithm of the total probability of S.
  */
 template <typename input_stream_t> double score_string_lin(input_stream_t& S, Global_Data& G) {
-    const int64_t BWT_SIZE = G.revbwt->size();
-    const Interval LARGEST_INTERVAL(0,G.revbwt->size()-1);
+    const char* begin; const char* end;
+    Pruned_Topology_Mapper mapper(G.rev_st_bpr,G.pruning_marks); // Also works for non-pruned topology
+    Parent_Support PS(G.rev_st_bpr);
+    Lin_Scoring_State state(G);
     
-    char c;
-    int64_t sizeFrom, sizeTo, node;
-    double logSizeFrom, logSizeTo, out;
+    while (S.next_block(begin, end))
+        for(const char* p = begin; p != end; p++) lin_scoring_step(state, *p, G, mapper, PS);
+    return state.out;
+}
+
+// Like score_string_lin, but also gives the log-probability of every character to
+// sink.add(logprob, -1, -1). The match length and the node are not tracked by this method.
+template <typename input_stream_t, typename sink_t> double score_string_lin_per_position(input_stream_t& S, Global_Data& G, sink_t& sink) {
+    const char* begin; const char* end;
     Pruned_Topology_Mapper mapper(G.rev_st_bpr,G.pruning_marks); // Also works for non-pruned topology
     Parent_Support PS(G.rev_st_bpr);
-    Interval I_W, I_Wc;
+    Lin_Scoring_State state(G);
     
-    out=0.0;
-    I_W=LARGEST_INTERVAL;
-    sizeFrom=BWT_SIZE;
-    logSizeFrom=log2(sizeFrom-1);  // We don't want to count in the final dollar
-    while (S.getchar(c)) {
-        // Finding the BWT interval of the longest suffix of W that is followed by c
-        node=-1;
-        while (true) {
-            I_Wc=G.revbwt->search(I_W,c);
-            sizeTo=I_Wc.size();
-            if (sizeTo==0) {
-                if (sizeFrom==BWT_SIZE)   // c does not occur in the text
-                    break;
-                if (node==-1) node=mapper.leaves_to_node(I_W);  // Map to topology
-                node=PS.parent(node);  // Take parent
-                I_W=mapper.node_to_leaves(node);  // Map back to revbwt
-                sizeFrom = I_W.size();
-            } else break;
-        }
-        
-        if (I_Wc.size() == 0) continue;
-        logSizeFrom = log2(min(BWT_SIZE-1,sizeFrom));
-        
-        // Cumulating the probability
-        logSizeTo=log2(sizeTo);
-        out+=logSizeTo-logSizeFrom;
-        
-        // Next iteration
-        logSizeFrom=logSizeTo;
-        I_W=I_Wc;
-        sizeFrom=sizeTo;
+    while (S.next_block(begin, end)){
+        for(const char* p = begin; p != end; p++)
+            sink.add(lin_scoring_step(state, *p, G, mapper, PS), -1, -1);
     }
-    return out;
+    return state.out;
 }
 
 
@@ -444,31 +572,55 @@ template <typename input_stream_t> double score_string_lin(input_stream_t& S, Gl
 }
 */
 
-// Input stream must have a function getchar(char& c), which returns
-// false it the end of the stream was reached
-template <typename input_stream_t>
-double score_string(input_stream_t& S, Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+// The topology support structures that main_loop needs. They only hold pointers into
+// the Global_Data, so every scoring thread can own an instance of its own over the same
+// read-only model.
+class Topology_Supports{
     
-    assert(G.revbwt != nullptr);
-    Pruned_Topology_Mapper mapper; // Also works for non-pruned topology
-    init_support(mapper, &G);
+private:
     
-    std::shared_ptr<String_Depth_Support> SDS;
-    if(G.have_slt()){
-        SDS = make_shared<String_Depth_Support_SLT>(G.rev_st_bpr,G.slt_bpr,G.rev_st_maximal_marks,G.slt_maximal_marks);
-    } else{
-        SDS = make_shared<String_Depth_Support_Store_All>(G.string_depths, G.rev_st_maximal_marks);
-    }
+    // Forbid copying, because topology points to the other members
+    Topology_Supports(Topology_Supports const& other);
+    Topology_Supports& operator=(Topology_Supports const& other);
+    
+public:
     
+    Pruned_Topology_Mapper mapper; // Also works for non-pruned topology
+    std::shared_ptr<String_Depth_Support> SDS;
     Parent_Support PS;
     LMA_Support LMAS;
+    std::shared_ptr<Topology_Algorithms> topology;
     
-    init_support<Parent_Support>(PS, &G);
-    init_support<LMA_Support>(LMAS, &G);
-    
-    Topology_Algorithms topology(&G, &mapper, SDS.get(), PS, LMAS);
-    
-    return main_loop(S,G,topology,scorer,updater);
+    Topology_Supports(Global_Data& G){
+        assert(G.revbwt != nullptr);
+        init_support(mapper, &G);
+        
+        if(G.have_slt()){
+            SDS = make_shared<String_Depth_Support_SLT>(G.rev_st_bpr,G.slt_bpr,G.rev_st_maximal_marks,G.slt_maximal_marks);
+        } else{
+            SDS = make_shared<String_Depth_Support_Store_All>(G.string_depths, G.rev_st_maximal_marks);
+        }
+        
+        init_support<Parent_Support>(PS, &G);
+        init_support<LMA_Support>(LMAS, &G);
+        
+        topology = make_shared<Topology_Algorithms>(&G, &mapper, SDS.get(), PS, LMAS);
+    }
+};
+
+// Scores using support structures that have already been initialized, so that
+// they can be reused across many queries
+template <typename input_stream_t>
+double score_string(input_stream_t& S, Global_Data& G, Topology_Supports& supports, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    return main_loop(S,G,*supports.topology,scorer,updater);
+}
+
+// Input stream must have a function next_block(begin, end) (see input_reading.hh), which
+// returns false if the end of the stream was reached
+template <typename input_stream_t>
+double score_string(input_stream_t& S, Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    Topology_Supports supports(G);
+    return score_string(S,G,supports,scorer,updater);
 }
 
 template <typename index_t = BD_BWT_index<>,
@@ -4,6 +4,15 @@
 #include "score_string.hh"
 #include "BWT_iteration.hh"
 #include "build_model.hh"
+#include "parallel_scoring.hh"
+#include "reference_reading.hh"
+#include "semi_external_bwt.hh"
+#include "score_server.hh"
+#include "per_position_output.hh"
+#include "static_scoring.hh"
+#include "chunked_scoring.hh"
+#include "pipeline_scoring.hh"
+#include "input_reading.hh"
 #include <vector>
 #include <string>
 #include <set>
@@ -141,7 +150,9 @@ double score_string_entropy_non_brute(string S, string T, bool maxreps_only, dou
         
         Entropy_Formula formula(threshold);
         Global_Data G; 
-        build_model(G, T, formula, slt_it, rev_slt_it, true, false);
+        Build_Options options;
+        options.run_length_coding = true;
+        build_model(G, T, formula, slt_it, rev_slt_it, options);
         //cout << G.toString() << endl; exit(0);
         Basic_Scorer scorer(escape_prob, true);
         Maxrep_Pruned_Updater updater;
@@ -153,7 +164,9 @@ double score_string_entropy_non_brute(string S, string T, bool maxreps_only, dou
         Rev_ST_Iterator rev_slt_it;
         Entropy_Formula formula(threshold);
         Global_Data G;
-        build_model(G, T, formula, slt_it, rev_slt_it, true, false);
+        Build_Options options;
+        options.run_length_coding = true;
+        build_model(G, T, formula, slt_it, rev_slt_it, options);
         Basic_Scorer scorer(escape_prob, true);
         Basic_Updater updater;
         return score_string(S, G, scorer, updater);    
@@ -167,7 +180,7 @@ void test_lin(string S, string T){
     
     Entropy_Formula formula(1); // Any, does not matter
     Global_Data G1, G2;
-    build_model(G1, T, formula, slt_it, rev_st_it, false, false);
+    build_model(G1, T, formula, slt_it, rev_st_it);
     G1.store_all_to_disk("models","test");
     G2.load_structures_that_lin_scoring_needs("models","test");
     
@@ -217,7 +230,10 @@ void test_serialization(){
         Global_Data G1;
         bool rle = rand()%2;
         bool storedepth = rand()%2;
-        build_model(G1, T, formula, slt_it, *rev_st_it, rle, storedepth);
+        Build_Options options;
+        options.run_length_coding = rle;
+        options.compute_string_depths = storedepth;
+        build_model(G1, T, formula, slt_it, *rev_st_it, options);
         G1.store_all_to_disk("models","test");
         Global_Data G2;
         G2.load_all_from_disk("models","test", false);
@@ -227,6 +243,105 @@ void test_serialization(){
         double brute = score_string_entropy_brute(S,T,threshold,escape_prob);
         double nonbrute = score_string(S, G2, scorer, updater);
         assert(abs(brute-nonbrute) < 1e-6);
+        
+        // Single-file model
+        G1.store_all_to_container("models/test.model");
+        Global_Data G3;
+        G3.load_all_from_container("models/test.model");
+        assert(score_string(S, G3, scorer, updater) == nonbrute);
+        assert(G3.string_depths->size() == G1.string_depths->size());
+        for(int64_t j = 0; j < G1.string_depths->size(); j++)
+            assert((*G3.string_depths)[j] == (*G1.string_depths)[j]);
+    }
+}
+
+// Corrupt model files are rejected instead of read past the end of the data
+void test_corrupt_models(){
+    cerr << "Testing corrupt models" << endl;
+    
+    // The table of contents of a container with the single int vector entry "v" starts with
+    // the length of the name, the name, the offset and the size of the payload in bytes, its
+    // kind and its size in bits
+    sdsl::int_vector<64> v(10, 7);
+    {
+        Model_Container_Writer out("models/test_corrupt.model");
+        out.add_int_vector("v", v);
+        out.finish();
+    }
+    uint64_t toc_offset;
+    ifstream("models/test_corrupt.model", ios::binary).seekg(16).read((char*)&toc_offset, 8);
+    for(int64_t field = 0; field < 3; field++){
+        vector<uint64_t> values = {UINT64_MAX - 10, UINT64_MAX - 10, 11 * 64}; // Offset and size that wrap around, too many bits
+        uint64_t value = values[field];
+        int64_t position = toc_offset + 8 + 1 + (field == 2 ? 3 : field) * 8;
+        uint64_t original;
+        fstream f("models/test_corrupt.model", ios::in | ios::out | ios::binary);
+        f.seekg(position).read((char*)&original, 8);
+        f.seekp(position).write((char*)&value, 8);
+        f.close();
+        
+        bool rejected = false;
+        try{
+            Model_Container in("models/test_corrupt.model");
+            sdsl::int_vector<64> view;
+            in.view_int_vector("v", view);
+            Model_Container::release_int_vector(view);
+        } catch(std::runtime_error& e){
+            rejected = true;
+        }
+        assert(rejected);
+        
+        fstream("models/test_corrupt.model", ios::in | ios::out | ios::binary).seekp(position).write((char*)&original, 8);
+    }
+    Model_Container in("models/test_corrupt.model");
+    sdsl::int_vector<64> view;
+    in.view_int_vector("v", view);
+    assert(view == v);
+    Model_Container::release_int_vector(view);
+    
+    // A C-array of the wrong size
+    string T = get_random_string(100, 3);
+    for(int64_t type = 0; type < 3; type++){
+        shared_ptr<BWT> bwt;
+        if(type == 0) bwt = make_shared<Basic_BWT<>>();
+        if(type == 1) bwt = make_shared<RLEBWT<>>();
+        if(type == 2) bwt = make_shared<Interleaved_BWT>();
+        bwt->init_from_text((const uint8_t*)T.c_str());
+        bwt->save_to_disk("models", "test_corrupt");
+        sdsl::store_to_file(sdsl::int_vector<64>(10), "models/test_corrupt_gca.dat");
+        vector<bool> rejected(2, false);
+        try{
+            bwt->load_from_disk("models", "test_corrupt");
+        } catch(std::runtime_error& e){
+            rejected[0] = true;
+        }
+        
+        // The same in a container. The wavelet trees are copied as they are.
+        if(type == 2) rejected[1] = true; // The blocks of the interleaved BWT are not copied
+        else{
+            {
+                Model_Container_Writer out("models/test_corrupt.model");
+                bwt->save_to_container(out, "good");
+                out.finish();
+            }
+            shared_ptr<Model_Container> good = make_shared<Model_Container>("models/test_corrupt.model");
+            {
+                Model_Container_Writer out("models/test_corrupt2.model");
+                out.add_string("bwt_bwt.dat", good->get_string("good_bwt.dat"));
+                out.add_int_vector("bwt_gca.dat", sdsl::int_vector<64>(10));
+                sdsl::int_vector<8> alphabet;
+                good->view_int_vector("good_alphabet.dat", alphabet);
+                out.add_int_vector("bwt_alphabet.dat", alphabet);
+                Model_Container::release_int_vector(alphabet);
+                out.finish();
+            }
+            try{
+                bwt->load_from_container(make_shared<Model_Container>("models/test_corrupt2.model"), "bwt");
+            } catch(std::runtime_error& e){
+                rejected[1] = true;
+            }
+        }
+        assert(rejected[0] && rejected[1]);
     }
 }
 
@@ -245,7 +360,10 @@ void test_precomputed_depths(){
         
         Entropy_Formula formula(threshold);
         Global_Data G;
-        build_model(G, T, formula, slt_it, rev_slt_it, true, true);
+        Build_Options options;
+        options.run_length_coding = true;
+        options.compute_string_depths = true;
+        build_model(G, T, formula, slt_it, rev_slt_it, options);
         Basic_Scorer scorer(escape, true);
         Maxrep_Pruned_Updater updater;
         
@@ -268,15 +386,1338 @@ void test_RLE(){
     Rev_ST_Maxrep_Iterator rev_slt_it;
     Entropy_Formula formula(threshold);
     Global_Data G_RLE;
-    build_model(G_RLE, T, formula, slt_it, rev_slt_it, true, false);
+    Build_Options options;
+    options.run_length_coding = true;
+    build_model(G_RLE, T, formula, slt_it, rev_slt_it, options);
     Global_Data G_non_RLE;
-    build_model(G_non_RLE, T, formula, slt_it, rev_slt_it, false, false);
+    build_model(G_non_RLE, T, formula, slt_it, rev_slt_it);
     
     Basic_Scorer scorer(escape_prob, true);
     Maxrep_Pruned_Updater updater;
     assert(score_string(S, G_RLE, scorer, updater) == score_string(S, G_non_RLE, scorer, updater));
 }
 
+// The run-length coded bit vector against an uncompressed one
+void test_RLE_bitvector(){
+    cerr << "Running run-length coded bit vector tests" << endl;
+    
+    srand(1717);
+    for(int64_t i = 0; i < 300; i++){
+        int64_t n = rand() % 2000;
+        int64_t mean_run = 1 + rand() % 100;
+        sdsl::bit_vector B(n);
+        bool bit = rand() % 2;
+        for(int64_t j = 0; j < n; j++){
+            if(rand() % mean_run == 0) bit = !bit;
+            B[j] = bit;
+        }
+        if(i == 0) B = sdsl::bit_vector(0);
+        if(i == 1) B = sdsl::bit_vector(100, 0);
+        if(i == 2) B = sdsl::bit_vector(100, 1);
+        n = B.size();
+        
+        Basic_bitvector basic(B);
+        basic.init_rank_support();
+        basic.init_select_support();
+        shared_ptr<RLE_bitvector> rle = make_shared<RLE_bitvector>(B);
+        
+        // Round trips through the disk and through a single-file model
+        if(i % 3 == 1){
+            rle->serialize("models/test.rle_bitvector");
+            rle = make_shared<RLE_bitvector>();
+            rle->load("models/test.rle_bitvector");
+        } else if(i % 3 == 2){
+            Model_Container_Writer out("models/test.model");
+            rle->serialize(out, "bv");
+            out.finish();
+            rle = make_shared<RLE_bitvector>();
+            rle->load(make_shared<Model_Container>("models/test.model"), "bv");
+        }
+        
+        assert(rle->size() == basic.size());
+        assert(rle->toString() == basic.toString());
+        for(int64_t j = 0; j < n; j++) assert(rle->at(j) == basic.at(j));
+        for(int64_t j = 0; j <= n; j++) assert(rle->rank(j) == basic.rank(j));
+        for(int64_t r = 1; r <= basic.rank(n); r++) assert(rle->select(r) == basic.select(r));
+    }
+    
+    // A bit vector stored in the old layout must not be loaded as the new one
+    {
+        ofstream info("models/test.rle_bitvector_info");
+        info << "rle 0 0 0 0 0" << endl;
+    }
+    Global_Data G;
+    shared_ptr<Bitvector> loaded;
+    bool rejected = false;
+    try{
+        G.load_bitvector(loaded, "models/test.rle_bitvector");
+    } catch(std::runtime_error& e){
+        rejected = true;
+    }
+    assert(rejected);
+}
+
+// Random balanced parentheses with runs of about mean_run parentheses. A forest if single_root is false.
+sdsl::bit_vector get_random_bpr(int64_t n_runs, int64_t mean_run, bool single_root){
+    string S;
+    int64_t depth = 0;
+    if(single_root){ S += '1'; depth++; }
+    for(int64_t i = 0; i < n_runs; i++){
+        int64_t opens = 1 + rand() % mean_run;
+        int64_t closes = 1 + rand() % (depth + opens - (single_root ? 1 : 0));
+        S += string(opens, '1') + string(closes, '0');
+        depth += opens - closes;
+    }
+    S += string(depth, '0');
+    sdsl::bit_vector B(S.size());
+    for(int64_t i = 0; i < S.size(); i++) B[i] = S[i] == '1';
+    return B;
+}
+
+// The compact BPR against bp_support_g
+void test_compact_BPR_bitvector(){
+    cerr << "Running compact BPR tests" << endl;
+    
+    srand(1818);
+    for(int64_t i = 0; i < 200; i++){
+        sdsl::bit_vector B = get_random_bpr(rand() % 3000, 1 + rand() % 20, i % 2);
+        if(i == 0) B = sdsl::bit_vector(0);
+        int64_t n = B.size();
+        
+        Basic_bitvector basic(B);
+        basic.init_rank_support();
+        basic.init_select_support();
+        basic.init_rank_10_support();
+        basic.init_select_10_support();
+        basic.init_bps_support();
+        shared_ptr<Compact_BPR_bitvector> compact = make_shared<Compact_BPR_bitvector>(B);
+        
+        // Round trips through the disk and through a single-file model
+        if(i % 3 == 1){
+            compact->serialize("models/test.compact_bpr");
+            compact = make_shared<Compact_BPR_bitvector>();
+            compact->load("models/test.compact_bpr");
+        } else if(i % 3 == 2){
+            Model_Container_Writer out("models/test.model");
+            compact->serialize(out, "bpr");
+            out.finish();
+            compact = make_shared<Compact_BPR_bitvector>();
+            compact->load(make_shared<Model_Container>("models/test.model"), "bpr");
+        }
+        
+        assert(compact->size() == n);
+        assert(compact->toString() == basic.toString());
+        vector<int64_t> opens;
+        for(int64_t j = 0; j < n; j++){
+            assert(compact->at(j) == basic.at(j));
+            assert(compact->excess(j) == basic.excess(j));
+            assert(compact->find_close(j) == basic.find_close(j));
+            assert(compact->find_open(j) == basic.find_open(j));
+            assert(compact->enclose(j) == basic.enclose(j));
+            if(basic.at(j)) opens.push_back(j);
+        }
+        for(int64_t j = 0; j <= n; j++){
+            assert(compact->rank(j) == basic.rank(j));
+            assert(compact->rank_10(j) == basic.rank_10(j));
+        }
+        for(int64_t r = 1; r <= basic.rank(n); r++) assert(compact->select(r) == basic.select(r));
+        for(int64_t r = 1; r <= basic.rank_10(n); r++) assert(compact->select_10(r) == basic.select_10(r));
+        for(int64_t j = 0; j < 1000 && opens.size() > 0; j++){
+            int64_t a = opens[rand() % opens.size()];
+            int64_t b = opens[rand() % opens.size()];
+            if(a > b) swap(a,b);
+            if(basic.find_close(a) < b) assert(compact->double_enclose(a,b) == basic.double_enclose(a,b));
+        }
+    }
+}
+
+void test_parallel_scoring(){
+    cerr << "Running parallel scoring tests" << endl;
+    
+    srand(5551212);
+    string T = get_random_string(500,3);
+    vector<string> queries;
+    for(int64_t i = 0; i < 100; i++) queries.push_back(get_random_string(1 + rand() % 100, 3));
+    double threshold = 0.2;
+    double escape_prob = 0.05;
+    
+    SLT_Iterator slt_it;
+    Rev_ST_Maxrep_Iterator rev_st_it;
+    Entropy_Formula formula(threshold);
+    Global_Data G;
+    Build_Options options;
+    options.run_length_coding = true;
+    build_model(G, T, formula, slt_it, rev_st_it, options);
+    
+    Basic_Scorer scorer(escape_prob, true);
+    Maxrep_Pruned_Updater updater;
+    for(int64_t n_threads : {1,3,8}){
+        vector<double> results;
+        score_strings_parallel(queries, results, G, scorer, updater, false, n_threads);
+        assert(results.size() == queries.size());
+        for(int64_t i = 0; i < queries.size(); i++)
+            assert(results[i] == score_string(queries[i], G, scorer, updater));
+    }
+}
+
+// Compares backward search in the interleaved BWT to the wavelet tree BWT
+void test_interleaved_bwt(){
+    cerr << "Running interleaved BWT tests" << endl;
+    
+    srand(77123);
+    for(int64_t i = 0; i < 100; i++){
+        int64_t sigma = 1 + rand() % (rand() % 2 ? 4 : 60); // Small and large alphabets
+        string T = get_random_string(1 + rand() % 3000, sigma);
+        
+        Basic_BWT<> basic;
+        basic.init_from_text((const uint8_t*)T.c_str());
+        shared_ptr<Interleaved_BWT> interleaved = make_shared<Interleaved_BWT>();
+        interleaved->init_from_text((const uint8_t*)T.c_str());
+        
+        // Round trips through the disk and through a single-file model
+        if(i % 3 == 1){
+            interleaved->save_to_disk("models", "test.interleaved_bwt");
+            interleaved = make_shared<Interleaved_BWT>();
+            interleaved->load_from_disk("models", "test.interleaved_bwt");
+        } else if(i % 3 == 2){
+            Model_Container_Writer out("models/test.model");
+            interleaved->save_to_container(out, "bwt");
+            out.finish();
+            interleaved = make_shared<Interleaved_BWT>();
+            interleaved->load_from_container(make_shared<Model_Container>("models/test.model"), "bwt");
+        }
+        
+        assert(interleaved->size() == basic.size());
+        assert(interleaved->get_alphabet() == basic.get_alphabet());
+        assert(interleaved->get_global_c_array() == basic.get_global_c_array());
+        for(int64_t j = 0; j < 100; j++){
+            int64_t a = rand() % basic.size();
+            int64_t b = a + rand() % (basic.size() - a);
+            if(j == 0){ a = 0; b = basic.size() - 1; }
+            Interval I(a,b);
+            for(int64_t c = 0; c < 'a' + sigma + 1; c++){
+                Interval R1 = basic.search(I,c);
+                Interval R2 = interleaved->search(I,c);
+                assert(R1.size() == R2.size());
+                if(R1.size() != 0) assert(R1.left == R2.left && R1.right == R2.right);
+            }
+        }
+    }
+    
+    // The END byte is rejected
+    bool rejected = false;
+    try{
+        Interleaved_BWT B;
+        B.init_from_text((const uint8_t*)"ACG\x01T");
+    } catch(std::runtime_error& e){
+        rejected = true;
+    }
+    assert(rejected);
+    
+    // A whole model with the interleaved layout scores the same as with the default layout
+    string T = get_random_string(1000,4);
+    string S = get_random_string(1000,4);
+    vector<double> scores;
+    for(BWT_Layout layout : {BWT_Layout::DEFAULT, BWT_Layout::INTERLEAVED}){
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Entropy_Formula formula(0.2);
+        Global_Data G;
+        Build_Options options;
+        options.bwt_layout = layout;
+        build_model(G, T, formula, slt_it, rev_st_it, options);
+        Basic_Scorer scorer(0.05, true);
+        Maxrep_Pruned_Updater updater;
+        scores.push_back(score_string(S, G, scorer, updater));
+        Input_Stream is(S);
+        scores.push_back(score_string_lin(is, G));
+    }
+    assert(scores[0] == scores[2] && scores[1] == scores[3]);
+}
+
+void test_batched_scoring(){
+    cerr << "Running batched scoring tests" << endl;
+    
+    srand(1234987);
+    for(int64_t i = 0; i < 20; i++){
+        string T = get_random_string(1 + rand() % 1000, 2 + rand() % 3);
+        vector<string> queries;
+        for(int64_t j = 0; j < 50; j++) queries.push_back(get_random_string(rand() % 50, 4)); // Includes empty queries and unseen characters
+        bool rle = rand() % 2;
+        
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Entropy_Formula formula(0.2);
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rle;
+        build_model(G, T, formula, slt_it, rev_st_it, options);
+        
+        Basic_Scorer scorer(0.05, true);
+        Maxrep_Pruned_Updater updater;
+        Topology_Supports supports(G);
+        int64_t begin = rand() % queries.size(); // Only queries[begin..end) are scored
+        int64_t end = begin + rand() % (queries.size() - begin + 1);
+        vector<double> results(queries.size(), 1);
+        score_strings_batched(queries, begin, end, results, G, *supports.topology, scorer, updater);
+        for(int64_t j = 0; j < queries.size(); j++){
+            if(j < begin || j >= end) assert(results[j] == 1);
+            else assert(results[j] == score_string(queries[j], G, scorer, updater));
+        }
+        
+        score_strings_lin_batched(queries, begin, end, results, G);
+        for(int64_t j = begin; j < end; j++){
+            Input_Stream is(queries[j]);
+            assert(results[j] == score_string_lin(is, G));
+        }
+    }
+}
+
+// Builds the same model with one and with many threads and checks that the results are identical
+void test_parallel_build(){
+    cerr << "Running parallel model building tests" << endl;
+    
+    srand(4242);
+    for(int64_t i = 0; i < 20; i++){
+        string T = get_random_string(1 + rand() % 2000, 2 + rand() % 3);
+        bool rle = rand() % 2;
+        bool storedepth = rand() % 2;
+        int64_t formula_type = rand() % 4;
+        int64_t iterator_type = rand() % 3;
+        
+        vector<string> models;
+        vector<vector<int64_t>> depths;
+        for(int64_t n_threads : {1,2,4}){
+            shared_ptr<Context_Callback> formula;
+            if(formula_type == 0) formula = make_shared<Entropy_Formula>(0.2);
+            if(formula_type == 1) formula = make_shared<KL_Formula>(0.5);
+            if(formula_type == 2) formula = make_shared<pnorm_Formula>(2, 0.3);
+            if(formula_type == 3) formula = make_shared<EQ234_Formula>(0.1, 0.2, 0.5, 2);
+            
+            shared_ptr<Iterator> slt_it, rev_st_it;
+            if(iterator_type == 0){
+                slt_it = make_shared<SLT_Iterator>();
+                rev_st_it = make_shared<Rev_ST_Iterator>();
+            } else if(iterator_type == 1){
+                slt_it = make_shared<SLT_Iterator>();
+                rev_st_it = make_shared<Rev_ST_Maxrep_Iterator>();
+            } else{
+                slt_it = make_shared<Depth_Bounded_SLT_Iterator>(5);
+                rev_st_it = make_shared<Rev_ST_Depth_Bounded_Maxrep_Iterator>(5);
+            }
+            
+            Global_Data G;
+            Build_Options options;
+            options.run_length_coding = rle;
+            options.compute_string_depths = storedepth;
+            options.n_threads = n_threads;
+            build_model(G, T, *formula, *slt_it, *rev_st_it, options);
+            models.push_back(G.toString());
+            depths.push_back(vector<int64_t>());
+            if(storedepth) for(int64_t j = 0; j < G.string_depths->size(); j++) depths.back().push_back((*G.string_depths)[j]);
+        }
+        for(int64_t j = 1; j < models.size(); j++){
+            assert(models[j] == models[0]);
+            assert(depths[j] == depths[0]);
+        }
+    }
+}
+
+void test_fused_build(){
+    cerr << "Testing single-traversal model building" << endl;
+    
+    srand(5151);
+    for(int64_t i = 0; i < 30; i++){
+        string T = get_random_string(1 + rand() % 2000, 2 + rand() % 3);
+        bool rle = rand() % 2;
+        bool storedepth = rand() % 2;
+        int64_t formula_type = rand() % 4;
+        int64_t depth_bound = (rand() % 2 == 0) ? 1e18 : 1 + rand() % 6;
+        int64_t n_threads = 1 + rand() % 3;
+        
+        vector<string> models;
+        vector<vector<int64_t>> depths;
+        for(bool fused : {false, true}){
+            shared_ptr<Context_Callback> formula;
+            if(formula_type == 0) formula = make_shared<Entropy_Formula>(0.2);
+            if(formula_type == 1) formula = make_shared<KL_Formula>(0.5);
+            if(formula_type == 2) formula = make_shared<pnorm_Formula>(2, 0.3);
+            if(formula_type == 3) formula = make_shared<EQ234_Formula>(0.1, 0.2, 0.5, 2);
+            
+            Depth_Bounded_SLT_Iterator slt_it(depth_bound);
+            Rev_ST_Depth_Bounded_Maxrep_Iterator rev_st_it(depth_bound);
+            
+            Global_Data G;
+            Build_Options options;
+            options.run_length_coding = rle;
+            options.compute_string_depths = storedepth;
+            options.n_threads = n_threads;
+            options.allow_fused_traversal = fused;
+            build_model(G, T, *formula, slt_it, rev_st_it, options);
+            models.push_back(G.toString());
+            depths.push_back(vector<int64_t>());
+            if(storedepth) for(int64_t j = 0; j < G.string_depths->size(); j++) depths.back().push_back((*G.string_depths)[j]);
+        }
+        assert(models[0] == models[1]);
+        assert(depths[0] == depths[1]);
+    }
+}
+
+void test_reference_reading(){
+    cerr << "Testing reference reading" << endl;
+    
+    srand(6161);
+    for(int64_t i = 0; i < 20; i++){
+        // Random multi-FASTA with varying line lengths, trailing whitespace and empty lines
+        string fasta;
+        int64_t n_reads = 1 + rand() % 5;
+        for(int64_t r = 0; r < n_reads; r++){
+            fasta += ">read " + to_string(r) + "\n";
+            int64_t n_lines = rand() % 4;
+            for(int64_t l = 0; l < n_lines; l++){
+                fasta += get_random_string(rand() % 100, 4);
+                if(rand() % 3 == 0) fasta += " \r";
+                fasta += "\n";
+                if(rand() % 5 == 0) fasta += "\n";
+            }
+        }
+        if(rand() % 2 == 0 && fasta.size() > 0) fasta.pop_back(); // No final newline
+        
+        string plain_path = "models/test_reference.fa";
+        string gzip_path = "models/test_reference.fa.gz";
+        ofstream(plain_path) << fasta;
+        gzFile gz = gzopen(gzip_path.c_str(), "wb");
+        gzwrite(gz, fasta.data(), fasta.size());
+        gzclose(gz);
+        
+        string expected_fasta;
+        for(auto& read : parse_FASTA(plain_path)) expected_fasta += read.first;
+        
+        for(string path : {plain_path, gzip_path}){
+            string reference;
+            Reference_Reader(path, 1 + rand() % 64).read_FASTA(reference);
+            assert(reference == expected_fasta);
+            Reference_Reader(path, 1 + rand() % 64).read_raw(reference);
+            assert(reference == fasta);
+        }
+    }
+}
+
+void test_semi_external_bibwt(){
+    cerr << "Testing semi-external BiBWT construction" << endl;
+    
+    srand(7171);
+    for(int64_t i = 0; i < 20; i++){
+        string T = get_random_string(1 + rand() % 3000, 1 + rand() % 4);
+        BD_BWT_index<> expected((uint8_t*)T.c_str());
+        
+        string text_path = "models/test_semi_external_text";
+        {
+            Text_File_Writer writer(text_path);
+            writer.append(T.data(), T.size());
+            writer.close();
+        }
+        BD_BWT_index<> index;
+        build_bibwt_semi_external(index, text_path, "models");
+        
+        assert(index.size() == expected.size());
+        assert(index.get_alphabet() == expected.get_alphabet());
+        assert(index.get_global_c_array() == expected.get_global_c_array());
+        for(int64_t j = 0; j < index.size(); j++){
+            assert(index.forward_bwt_at(j) == expected.forward_bwt_at(j));
+            assert(index.backward_bwt_at(j) == expected.backward_bwt_at(j));
+        }
+    }
+}
+
+// Scores queries through the socket with concurrent clients and compares to direct scoring
+void test_score_server(){
+    cerr << "Testing the scoring server" << endl;
+    
+    srand(8181);
+    string T = get_random_string(2000, 3);
+    shared_ptr<Global_Data> G = make_shared<Global_Data>();
+    SLT_Iterator slt_it;
+    Rev_ST_Maxrep_Iterator rev_st_it;
+    Entropy_Formula formula(0.2);
+    Build_Options options;
+    options.run_length_coding = true;
+    build_model(*G, T, formula, slt_it, rev_st_it, options);
+    
+    string socket_path = "models/test_score_server.sock";
+    Score_Server_Limits limits;
+    limits.max_sequence_length = 1000;
+    limits.max_sequences = 30;
+    limits.max_request_bytes = 5000;
+    Score_Server server(socket_path, 2, limits);
+    server.add_model("test", make_shared<Server_Model>(G, true, true, Model_Profile::FULL));
+    server.listen();
+    thread server_thread(&Score_Server::run, &server);
+    
+    vector<vector<string>> batches(4);
+    for(vector<string>& batch : batches)
+        for(int64_t j = 0; j < 20; j++) batch.push_back(get_random_string(rand() % 100, 4));
+    
+    vector<thread> clients;
+    for(int64_t c = 0; c < batches.size(); c++){
+        clients.push_back(thread([&, c](){
+            Score_Client client(socket_path);
+            for(bool recursive : {false, true}){
+                vector<double> results = client.score("test", string("escapeprob=0.05") + (recursive ? " recursive-fallback" : ""), batches[c]);
+                assert(results.size() == batches[c].size());
+                Basic_Scorer basic(0.05, true);
+                Recursive_Scorer rec(0.05, true);
+                Maxrep_Pruned_Updater updater;
+                for(int64_t j = 0; j < batches[c].size(); j++){
+                    if(recursive) assert(results[j] == score_string(batches[c][j], *G, rec, updater));
+                    else assert(results[j] == score_string(batches[c][j], *G, basic, updater));
+                }
+            }
+            vector<double> results = client.score("test", "lin-scoring", batches[c]);
+            for(int64_t j = 0; j < batches[c].size(); j++){
+                Input_Stream is(batches[c][j]);
+                assert(results[j] == score_string_lin(is, *G));
+            }
+            
+            // Errors are reported and the connection stays usable
+            bool failed = false;
+            try{ client.score("nonexistent", "escapeprob=0.05", batches[c]); } catch(const std::runtime_error& e){ failed = true; }
+            assert(failed);
+            failed = false;
+            try{ client.score("test", "bogus", batches[c]); } catch(const std::runtime_error& e){ failed = true; }
+            assert(failed);
+            assert(client.score("test", "escapeprob=0.05", vector<string>()).size() == 0);
+        }));
+    }
+    for(thread& t : clients) t.join();
+    
+    // A request over a limit is refused and its connection is closed, but the server keeps serving
+    for(vector<string> sequences : {vector<string>(1, string(1001, 'a')), vector<string>(31, "a"), vector<string>(10, string(1000, 'a'))}){
+        Score_Client client(socket_path);
+        bool failed = false;
+        try{ client.score("test", "escapeprob=0.05", sequences); } catch(const std::runtime_error& e){ failed = true; }
+        assert(failed);
+        failed = false;
+        try{ client.score("test", "escapeprob=0.05", batches[0]); } catch(const std::runtime_error& e){ failed = true; }
+        assert(failed);
+    }
+    Score_Client client(socket_path);
+    assert(client.score("test", "escapeprob=0.05", batches[0]).size() == batches[0].size());
+    
+    server.stop();
+    server_thread.join();
+}
+
+// With one worker, idle connections and connections that stop in the middle of a request must
+// not keep the others waiting. Requests sent back to back are answered in order, and stop
+// returns with connections open and removes the socket file.
+void test_score_server_connections(){
+    cerr << "Testing connections of the scoring server" << endl;
+    
+    srand(8282);
+    string T = get_random_string(1000, 3);
+    shared_ptr<Global_Data> G = make_shared<Global_Data>();
+    SLT_Iterator slt_it;
+    Rev_ST_Maxrep_Iterator rev_st_it;
+    Entropy_Formula formula(0.2);
+    build_model(*G, T, formula, slt_it, rev_st_it);
+    vector<string> queries;
+    for(int64_t j = 0; j < 10; j++) queries.push_back(get_random_string(rand() % 100, 4));
+    vector<double> expected;
+    for(string& S : queries){
+        Input_Stream is(S);
+        expected.push_back(score_string_lin(is, *G));
+    }
+    
+    string socket_path = "models/test_score_server_connections.sock";
+    Score_Server server(socket_path, 1);
+    server.add_model("test", make_shared<Server_Model>(G, true, true, Model_Profile::FULL));
+    server.listen();
+    thread server_thread(&Score_Server::run, &server);
+    
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path.c_str());
+    int raw = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(raw != -1 && connect(raw, (sockaddr*)&address, sizeof(address)) == 0);
+    Socket_Stream raw_stream(raw);
+    
+    Score_Client idle(socket_path);
+    raw_stream.write_string("test"); // The rest of the request comes later
+    {
+        Score_Client client(socket_path);
+        assert(client.score("test", "lin-scoring", queries) == expected);
+    }
+    
+    // The first request finished, and a second one in the same write
+    raw_stream.write_string("lin-scoring");
+    raw_stream.write_u64(queries.size());
+    for(string& S : queries) raw_stream.write_string(S);
+    for(string field : {string("test"), string("lin-scoring")}) raw_stream.write_string(field);
+    raw_stream.write_u64(1);
+    raw_stream.write_string(queries[0]);
+    for(int64_t n : {(int64_t)queries.size(), (int64_t)1}){
+        assert(raw_stream.read_u64() == SCORE_SERVER_STATUS_OK);
+        assert(raw_stream.read_u64() == n);
+        for(int64_t j = 0; j < n; j++) assert(raw_stream.read_double() == expected[j]);
+    }
+    
+    // A client that never reads a response much larger than the socket buffer does not hold
+    // the only worker, and the server still stops
+    int greedy = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(greedy != -1 && connect(greedy, (sockaddr*)&address, sizeof(address)) == 0);
+    string request;
+    Socket_Stream::append_string(request, "test");
+    Socket_Stream::append_string(request, "lin-scoring");
+    Socket_Stream::append_u64(request, 1 << 19);
+    for(int64_t j = 0; j < (1 << 19); j++) Socket_Stream::append_string(request, ""); // 4 MB response
+    Socket_Stream(greedy).write_all(request.data(), request.size());
+    {
+        Score_Client client(socket_path);
+        assert(client.score("test", "lin-scoring", queries) == expected);
+    }
+    
+    raw_stream.write_string("test"); // Left in the middle of a request
+    server.stop();
+    server_thread.join();
+    struct stat info;
+    assert(stat(socket_path.c_str(), &info) != 0);
+    close(raw);
+    close(greedy);
+}
+
+// Each profile stores only its structures, and the models load and score with the methods the
+// profile is for
+void test_model_profiles(){
+    cerr << "Testing model profiles" << endl;
+    
+    srand(2020);
+    string T = get_random_string(2000, 3);
+    vector<string> queries;
+    for(int64_t j = 0; j < 20; j++) queries.push_back(get_random_string(rand() % 100, 4));
+    Global_Data G;
+    SLT_Iterator slt_it;
+    Rev_ST_Maxrep_Iterator rev_st_it;
+    Entropy_Formula formula(0.2);
+    build_model(G, T, formula, slt_it, rev_st_it);
+    Basic_Scorer scorer(0.05, true);
+    Maxrep_Pruned_Updater updater;
+    
+    int64_t previous_total = 0;
+    for(Model_Profile profile : {Model_Profile::LIN, Model_Profile::SCORING, Model_Profile::FULL}){
+        string prefix = "test_profile_" + model_profile_to_string(profile);
+        G.store_all_to_disk("models", prefix, profile);
+        assert(Global_Data::stored_profile("models", prefix) == profile);
+        assert(ifstream("models/" + prefix + ".rev_st_bpr_context_only_info").good() == (profile >= Model_Profile::SCORING));
+        assert(ifstream("models/" + prefix + ".bibwt_forward_bwt.dat").good() == (profile == Model_Profile::FULL));
+        
+        map<string, int64_t> sizes = G.disk_size_breakdown("models", prefix, profile);
+        assert(sizes.size() == G.structures_of(profile).size());
+        int64_t total = 0;
+        for(auto& keyval : sizes) total += keyval.second;
+        assert(total > previous_total);
+        previous_total = total;
+        
+        Global_Data loaded;
+        if(profile == Model_Profile::LIN) loaded.load_structures_that_lin_scoring_needs("models", prefix);
+        else loaded.load_all_from_disk("models", prefix, profile == Model_Profile::FULL);
+        for(string& S : queries){
+            Input_Stream is1(S), is2(S);
+            assert(score_string_lin(is1, loaded) == score_string_lin(is2, G));
+            if(profile >= Model_Profile::SCORING) assert(score_string(S, loaded, scorer, updater) == score_string(S, G, scorer, updater));
+        }
+    }
+    
+    // With stored string depths there is no SLT, and only the depths are stored
+    Global_Data G_depths;
+    Build_Options options;
+    options.compute_string_depths = true;
+    build_model(G_depths, T, formula, slt_it, rev_st_it, options);
+    G_depths.store_all_to_disk("models", "test_profile_depths", Model_Profile::SCORING);
+    G_depths.store_all_to_container("models/test_profile_depths.model", Model_Profile::SCORING);
+    assert(!ifstream("models/test_profile_depths.slt_bpr_info").good());
+    assert(ifstream("models/test_profile_depths.string_depths").good());
+    assert(G_depths.container_size_breakdown("models/test_profile_depths.model", Model_Profile::SCORING).count("slt_bpr") == 0);
+    Global_Data from_disk, from_container;
+    from_disk.load_all_from_disk("models", "test_profile_depths", false);
+    from_container.load_all_from_container("models/test_profile_depths.model");
+    for(string& S : queries){
+        double score = score_string(S, G_depths, scorer, updater);
+        assert(score_string(S, from_disk, scorer, updater) == score);
+        assert(score_string(S, from_container, scorer, updater) == score);
+    }
+    remove("models/test_profile_depths.model");
+    
+    // A single file has no BiBWT, so FULL is the same as SCORING
+    G.store_all_to_container("models/test_profile_single.model", Model_Profile::LIN);
+    assert(Global_Data::stored_profile("models", "test_profile_single") == Model_Profile::LIN);
+    assert(G.container_size_breakdown("models/test_profile_single.model", Model_Profile::LIN).size() == 3);
+    G.store_all_to_container("models/test_profile_single.model", Model_Profile::FULL);
+    assert(Global_Data::stored_profile("models", "test_profile_single") == Model_Profile::SCORING);
+    remove("models/test_profile_single.model");
+    
+    // The server refuses only the requests that need the missing structures
+    ofstream("models/test_profile_lin.info") << "1\nentropy\n0\n1000000000000000000\n";
+    shared_ptr<Server_Model> M = load_server_model("models", "test_profile_lin");
+    assert(M->profile == Model_Profile::LIN);
+    string socket_path = "models/test_profile.sock";
+    Score_Server server(socket_path, 1);
+    server.add_model("lin", M);
+    server.listen();
+    thread server_thread(&Score_Server::run, &server);
+    {
+        Score_Client client(socket_path);
+        vector<double> results = client.score("lin", "lin-scoring", queries);
+        for(int64_t j = 0; j < queries.size(); j++){
+            Input_Stream is(queries[j]);
+            assert(results[j] == score_string_lin(is, G));
+        }
+        bool failed = false;
+        try{ client.score("lin", "escapeprob=0.05", queries); } catch(const std::runtime_error& e){ failed = true; }
+        assert(failed);
+    }
+    server.stop();
+    server_thread.join();
+}
+
+void test_per_position_output(){
+    cerr << "Testing per-position output" << endl;
+    
+    for(float x : {0.0f, -0.0f, 1.0f, -1.5f, 65504.0f, 6e-8f, -3.14159f})
+        assert(abs(half_to_float(float_to_half(x)) - x) <= abs(x) / 1024 + 6e-8);
+    assert(half_to_float(float_to_half(-1e9f)) == -INFINITY); // Overflow
+    
+    srand(9191);
+    for(int64_t i = 0; i < 20; i++){
+        string T = get_random_string(1 + rand() % 1000, 2 + rand() % 3);
+        vector<string> queries;
+        for(int64_t j = 0; j < 5; j++) queries.push_back(get_random_string(rand() % 200, 4));
+        int64_t window = rand() % 2 == 0 ? 0 : 1 + rand() % 20;
+        Per_Position_Format format = rand() % 2 == 0 ? Per_Position_Format::F32 : Per_Position_Format::F16;
+        bool lin = rand() % 2;
+        
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Entropy_Formula formula(0.2);
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rand() % 2;
+        build_model(G, T, formula, slt_it, rev_st_it, options);
+        Basic_Scorer scorer(0.05, true);
+        Maxrep_Pruned_Updater updater;
+        Topology_Supports supports(G);
+        
+        string path = "models/test_per_position.bin";
+        vector<double> totals;
+        {
+            Per_Position_Writer writer(path, format, window, !lin, !lin, 1 + rand() % 100);
+            for(string& S : queries){
+                Input_Stream is(S);
+                if(lin) totals.push_back(score_string_lin_per_position(is, G, writer));
+                else totals.push_back(main_loop_per_position(is, G, *supports.topology, scorer, updater, writer));
+                writer.end_query();
+            }
+            writer.close();
+        }
+        
+        Per_Position_File F(path);
+        assert(F.lengths.size() == queries.size());
+        double tolerance = (format == Per_Position_Format::F32) ? 1e-5 : 1e-2;
+        for(int64_t q = 0; q < queries.size(); q++){
+            string& S = queries[q];
+            assert(F.lengths[q] == S.size());
+            Input_Stream is(S);
+            double total = lin ? score_string_lin(is, G) : score_string(is, G, scorer, updater);
+            assert(total == totals[q]);
+            
+            double sum = 0;
+            for(int64_t j = 0; j < S.size(); j++){
+                sum += F.logprobs[q][j];
+                if(window > 0){
+                    double expected = 0;
+                    for(int64_t k = max((int64_t)0, j - window + 1); k <= j; k++) expected += F.logprobs[q][k];
+                    assert(abs(F.window_sums[q][j] - expected) <= tolerance * window * 10);
+                }
+                if(!lin){
+                    // Longest suffix of S[0..j) that occurs in T
+                    int64_t d = F.depths[q][j];
+                    assert(d <= j && T.find(S.substr(j-d, d)) != string::npos);
+                    assert(d == j || T.find(S.substr(j-d-1, d+1)) == string::npos);
+                }
+            }
+            assert(abs(sum - total) <= tolerance * max((int64_t)1, (int64_t)S.size()) * 10);
+        }
+    }
+}
+
+// The static scoring engine must give exactly the same scores as the virtual main loop
+void test_static_scoring(){
+    cerr << "Testing the static scoring engine" << endl;
+    
+    srand(1011);
+    for(int64_t i = 0; i < 40; i++){
+        string T = get_random_string(1 + rand() % 1000, 2 + rand() % 3);
+        vector<string> queries;
+        for(int64_t j = 0; j < 30; j++) queries.push_back(get_random_string(rand() % 100, 4));
+        bool rle = rand() % 2;
+        bool storedepth = rand() % 2;
+        bool entropy = rand() % 2;
+        int64_t iterator_type = rand() % 3;
+        BWT_Layout layout = rand() % 3 == 0 ? BWT_Layout::INTERLEAVED : BWT_Layout::DEFAULT;
+        
+        shared_ptr<Context_Callback> formula;
+        if(entropy) formula = make_shared<Entropy_Formula>(0.2);
+        else formula = make_shared<KL_Formula>(0.5);
+        shared_ptr<Iterator> slt_it, rev_st_it;
+        shared_ptr<Loop_Invariant_Updater> updater;
+        if(iterator_type == 0){
+            slt_it = make_shared<SLT_Iterator>();
+            rev_st_it = make_shared<Rev_ST_Iterator>();
+            updater = make_shared<Basic_Updater>();
+        } else if(iterator_type == 1){
+            slt_it = make_shared<SLT_Iterator>();
+            rev_st_it = make_shared<Rev_ST_Maxrep_Iterator>();
+            updater = make_shared<Maxrep_Pruned_Updater>();
+        } else{
+            slt_it = make_shared<Depth_Bounded_SLT_Iterator>(3);
+            rev_st_it = make_shared<Rev_ST_Depth_Bounded_Maxrep_Iterator>(3);
+            updater = make_shared<Maxrep_Pruned_Updater>();
+        }
+        
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rle;
+        options.compute_string_depths = storedepth;
+        options.bwt_layout = layout;
+        build_model(G, T, *formula, *slt_it, *rev_st_it, options);
+        
+        Basic_Scorer basic(0.05, entropy);
+        Recursive_Scorer recursive(0.05, entropy);
+        map<Scoring_Function*, vector<double>> expected;
+        for(bool compact : {false, true}){
+            // The compact BPRs must give the same scores as the sdsl supports
+            if(compact) compact_rev_st_bprs(G);
+            for(Scoring_Function* scorer : vector<Scoring_Function*>{&basic, &recursive}){
+                // The recursive fallback can fail an assertion on other models also in the virtual main loop
+                if(scorer == &recursive && (iterator_type != 1 || !entropy)) continue;
+                shared_ptr<Scoring_Engine> engine = make_scoring_engine(G, *scorer, *updater);
+                assert(dynamic_cast<Virtual_Scoring_Engine*>(engine.get()) == nullptr); // Every model that build_model makes has a static instantiation
+                
+                if(!compact)
+                    for(string& query : queries) expected[scorer].push_back(score_string(query, G, *scorer, *updater));
+                vector<double> results(queries.size());
+                engine->score_batch(queries, 0, queries.size(), results);
+                for(int64_t j = 0; j < queries.size(); j++){
+                    Input_Stream is(queries[j]);
+                    assert(engine->score(is) == expected[scorer][j]);
+                    assert(results[j] == expected[scorer][j]);
+                    if(compact) assert(score_string(queries[j], G, *scorer, *updater) == expected[scorer][j]);
+                }
+            }
+        }
+    }
+}
+
+// Scores with the context count table must be exactly the same as without it, also after
+// storing the model to disk and to a single file
+void test_context_count_table(){
+    cerr << "Testing the context count table" << endl;
+    
+    srand(1212);
+    for(int64_t i = 0; i < 30; i++){
+        int64_t sigma = 2 + rand() % 3;
+        string T = get_random_string(1 + rand() % 1000, sigma);
+        vector<string> queries; // Over the same alphabet, because the recursive fallback fails at the root otherwise
+        for(int64_t j = 0; j < 20; j++) queries.push_back(get_random_string(rand() % 100, sigma));
+        bool rle = rand() % 2;
+        bool entropy = rand() % 2;
+        bool maxreps = rand() % 2;
+        
+        shared_ptr<Context_Callback> formula;
+        if(entropy) formula = make_shared<Entropy_Formula>(0.2);
+        else formula = make_shared<KL_Formula>(0.5);
+        shared_ptr<Iterator> rev_st_it;
+        shared_ptr<Loop_Invariant_Updater> updater;
+        if(maxreps){
+            rev_st_it = make_shared<Rev_ST_Maxrep_Iterator>();
+            updater = make_shared<Maxrep_Pruned_Updater>();
+        } else{
+            rev_st_it = make_shared<Rev_ST_Iterator>();
+            updater = make_shared<Basic_Updater>();
+        }
+        SLT_Iterator slt_it;
+        
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rle;
+        build_model(G, T, *formula, slt_it, *rev_st_it, options);
+        
+        Basic_Scorer basic(0.05, entropy);
+        Recursive_Scorer recursive(0.05, entropy);
+        vector<Scoring_Function*> scorers = {&basic};
+        if(maxreps && entropy) scorers.push_back(&recursive); // See test_static_scoring
+        vector<vector<double>> expected(scorers.size());
+        for(int64_t k = 0; k < scorers.size(); k++)
+            for(string& S : queries) expected[k].push_back(score_string(S, G, *scorers[k], *updater));
+        
+        Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+        G.context_counts = make_shared<Context_Count_Table>();
+        G.context_counts->build(*G.revbwt, G.rev_st_bpr, G.rev_st_context_marks, mapper);
+        assert(G.context_counts->number_of_contexts() == G.rev_st_bpr_context_only->size() / 2);
+        
+        G.store_all_to_disk("models", "test");
+        G.store_all_to_container("models/test.model");
+        Global_Data G_disk, G_container;
+        G_disk.load_all_from_disk("models", "test", false);
+        G_container.load_all_from_container("models/test.model");
+        
+        for(Global_Data* model : {&G, &G_disk, &G_container}){
+            assert(model->context_counts != nullptr);
+            for(int64_t k = 0; k < scorers.size(); k++){
+                scorers[k]->use_context_counts(model->context_counts.get());
+                shared_ptr<Scoring_Engine> engine = make_scoring_engine(*model, *scorers[k], *updater);
+                for(int64_t j = 0; j < queries.size(); j++){
+                    Input_Stream is(queries[j]);
+                    assert(score_string(queries[j], *model, *scorers[k], *updater) == expected[k][j]);
+                    assert(engine->score(is) == expected[k][j]);
+                }
+                scorers[k]->use_context_counts(nullptr);
+            }
+        }
+    }
+    
+    // Other tests store models with the same prefix without a table
+    for(string suffix : {"_counts", "_totals", "_alphabet"}) remove(("models/test.context_counts" + suffix).c_str());
+}
+
+// Scores with the LMA pointer table must be exactly the same as without it, for every sample
+// rate, also after storing the model to disk and to a single file
+void test_lma_pointer_table(){
+    cerr << "Testing the LMA pointer table" << endl;
+    
+    srand(1414);
+    for(int64_t i = 0; i < 30; i++){
+        int64_t sigma = 2 + rand() % 3;
+        string T = get_random_string(1 + rand() % 1000, sigma);
+        vector<string> queries;
+        for(int64_t j = 0; j < 20; j++) queries.push_back(get_random_string(rand() % 100, sigma));
+        bool maxreps = rand() % 2;
+        bool compact = rand() % 2;
+        int64_t sample_shift = rand() % 4;
+        
+        Entropy_Formula formula(0.2);
+        shared_ptr<Iterator> rev_st_it;
+        shared_ptr<Loop_Invariant_Updater> updater;
+        if(maxreps){
+            rev_st_it = make_shared<Rev_ST_Maxrep_Iterator>();
+            updater = make_shared<Maxrep_Pruned_Updater>();
+        } else{
+            rev_st_it = make_shared<Rev_ST_Iterator>();
+            updater = make_shared<Basic_Updater>();
+        }
+        SLT_Iterator slt_it;
+        
+        Global_Data G;
+        build_model(G, T, formula, slt_it, *rev_st_it);
+        if(compact) compact_rev_st_bprs(G);
+        
+        Basic_Scorer scorer(0.05, true);
+        vector<double> expected;
+        for(string& S : queries) expected.push_back(score_string(S, G, scorer, *updater));
+        
+        build_lma_pointers(G, sample_shift);
+        G.store_all_to_disk("models", "test");
+        G.store_all_to_container("models/test.model");
+        Global_Data G_disk, G_container;
+        G_disk.load_all_from_disk("models", "test", false);
+        G_container.load_all_from_container("models/test.model");
+        
+        for(Global_Data* model : {&G, &G_disk, &G_container}){
+            assert(model->rev_st_lma_pointers != nullptr);
+            assert(model->rev_st_lma_pointers->sample_shift == sample_shift);
+            shared_ptr<Scoring_Engine> engine = make_scoring_engine(*model, scorer, *updater);
+            for(int64_t j = 0; j < queries.size(); j++){
+                Input_Stream is(queries[j]);
+                assert(score_string(queries[j], *model, scorer, *updater) == expected[j]);
+                assert(engine->score(is) == expected[j]);
+            }
+        }
+    }
+    
+    // Other tests store models with the same prefix without a table
+    for(string suffix : {"_info", "_pointers"}) remove(("models/test.rev_st_lma_pointers" + suffix).c_str());
+}
+
+// The mapper must find the same node whether or not the interval is inside one leaf
+void test_leaves_to_node(){
+    cerr << "Testing mapping colex intervals to topology nodes" << endl;
+    
+    srand(1515);
+    for(int64_t i = 0; i < 30; i++){
+        int64_t sigma = 2 + rand() % 3;
+        string T = get_random_string(1 + rand() % 1000, sigma);
+        bool maxreps = rand() % 2;
+        
+        Entropy_Formula formula(0.2);
+        shared_ptr<Iterator> rev_st_it;
+        if(maxreps) rev_st_it = make_shared<Rev_ST_Maxrep_Iterator>();
+        else rev_st_it = make_shared<Rev_ST_Iterator>();
+        SLT_Iterator slt_it;
+        Global_Data G;
+        build_model(G, T, formula, slt_it, *rev_st_it);
+        
+        // Random colex intervals inside the interval of every node, against the double_enclose of
+        // the leaves at the ends
+        Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+        for(int64_t node = 0; node < G.rev_st_bpr->size(); node++){
+            if(!G.rev_st_bpr->at(node)) continue;
+            Interval I = mapper.node_to_leaves(node);
+            assert(mapper.leaves_to_node(I) == node);
+            int64_t left = I.left + rand() % I.size();
+            Interval J(left, left + rand() % (I.right - left + 1));
+            int64_t leaf1 = G.rev_st_bpr->select_10(G.pruning_marks->rank(J.left+1)) - 1;
+            int64_t leaf2 = G.rev_st_bpr->select_10(G.pruning_marks->rank(J.right+1)) - 1;
+            assert(mapper.leaves_to_node(J) == (leaf1 == leaf2 ? leaf1 : G.rev_st_bpr->double_enclose(leaf1, leaf2)));
+        }
+    }
+}
+
+// The counting of Scoring_Instrumentation, and when the tests are compiled with VOMM_INSTRUMENT,
+// the counts of scoring
+void test_scoring_instrumentation(){
+    cerr << "Testing the scoring instrumentation" << endl;
+    
+    Scoring_Instrumentation A, B;
+    for(int64_t i = 0; i < 100; i++) assert(A.timed(Scoring_Instrumentation::LMA, [&](){ return i; }) == i);
+    A.escape(); A.escape(); A.end_character(); A.end_character(); A.single_leaf_mapping();
+    assert(A.calls[Scoring_Instrumentation::LMA] == 100);
+    assert(A.sampled[Scoring_Instrumentation::LMA] == (100 + Scoring_Instrumentation::SAMPLE_PERIOD - 1) / Scoring_Instrumentation::SAMPLE_PERIOD);
+    int64_t histogram_sum = 0;
+    for(int64_t k = 0; k < Scoring_Instrumentation::N_BUCKETS; k++) histogram_sum += A.ticks_histogram[Scoring_Instrumentation::LMA][k];
+    assert(histogram_sum == A.sampled[Scoring_Instrumentation::LMA]);
+    assert(A.characters == 2 && A.escapes == 2 && A.max_escapes == 2);
+    assert(A.escapes_histogram[0] == 1 && A.escapes_histogram[2] == 1);
+    B += A; B += A;
+    assert(B.calls[Scoring_Instrumentation::LMA] == 200 && B.characters == 4 && B.max_escapes == 2 && B.single_leaf == 2);
+    string json = B.to_json();
+    assert(json.find("\"characters\": 4") != string::npos);
+    assert(json.find("\"lma\": {\"calls\": 200") != string::npos);
+    assert(json.find("\"escapes_per_character_histogram\": [2, 0, 2]") != string::npos);
+    
+    if(!SCORING_INSTRUMENTATION_ENABLED) return;
+    srand(1616);
+    for(int64_t i = 0; i < 20; i++){
+        int64_t sigma = 2 + rand() % 3;
+        string T = get_random_string(1 + rand() % 1000, sigma);
+        string query = get_random_string(rand() % 1000, sigma);
+        Entropy_Formula formula(0.2);
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        SLT_Iterator slt_it;
+        Maxrep_Pruned_Updater updater;
+        Recursive_Scorer scorer(0.05, true);
+        Global_Data G;
+        build_model(G, T, formula, slt_it, rev_st_it);
+        
+        Scoring_Instrumentation& counts = Scoring_Instrumentation::local();
+        counts.reset();
+        Input_Stream is(query);
+        make_scoring_engine(G, scorer, updater)->score(is);
+        assert(counts.characters == (int64_t)query.size());
+        assert(counts.calls[Scoring_Instrumentation::LEAVES_TO_NODE] == (int64_t)query.size());
+        assert(counts.single_leaf <= counts.calls[Scoring_Instrumentation::LEAVES_TO_NODE]);
+        assert(counts.calls[Scoring_Instrumentation::LMA] >= (int64_t)query.size());
+        assert(counts.calls[Scoring_Instrumentation::BWT_SEARCH] >= 2 * (int64_t)query.size()); // One by the scorer and at least one by the updater
+    }
+}
+
+// Contexts marked from the scores of one traversal must be the same as the contexts of a
+// traversal with each threshold, and score the same as a model built with that threshold
+void test_context_sweep(){
+    cerr << "Testing context marking with many thresholds" << endl;
+    
+    srand(1919);
+    for(int64_t i = 0; i < 30; i++){
+        string T = get_random_string(1 + rand() % 1000, 2 + rand() % 3);
+        vector<string> queries;
+        for(int64_t j = 0; j < 20; j++) queries.push_back(get_random_string(rand() % 100, 4));
+        int64_t formula_type = rand() % 3;
+        int64_t p = 1 + rand() % 3;
+        auto make_formula = [&](double threshold) -> shared_ptr<Context_Callback> {
+            if(formula_type == 0) return make_shared<Entropy_Formula>(threshold);
+            if(formula_type == 1) return make_shared<KL_Formula>(threshold);
+            return make_shared<pnorm_Formula>(p, threshold);
+        };
+        vector<double> thresholds;
+        for(int64_t j = 0; j < 4; j++) thresholds.push_back((rand() % 100) / 20.0);
+        double min_threshold = *min_element(thresholds.begin(), thresholds.end());
+        
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Maxrep_Pruned_Updater updater;
+        Basic_Scorer scorer(0.05, formula_type == 0);
+        Global_Data G;
+        shared_ptr<Context_Callback> formula = make_formula(thresholds[0]);
+        build_model(G, T, *formula, slt_it, rev_st_it);
+        if(rand() % 2) build_context_counts(G);
+        if(rand() % 2) build_lma_pointers(G, rand() % 3);
+        
+        // Scores with the smallest threshold, in parallel to exercise merging the local copies
+        Pruned_Topology_Mapper mapper(G.rev_st_bpr, G.pruning_marks);
+        Stats_writer wr;
+        shared_ptr<Context_Callback> scoring_formula = make_formula(1e9);
+        assert(keep_context_scores(*scoring_formula, min_threshold));
+        scoring_formula->init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
+        SLT_Iterator it(G.bibwt.get());
+        iterate_with_callbacks_parallel(it, scoring_formula.get(), 1 + rand() % 4);
+        Context_Scores scores = *get_context_scores(*scoring_formula);
+        scores.finish();
+        scores.serialize("models/test.context_scores");
+        scores = Context_Scores();
+        scores.load("models/test.context_scores");
+        assert(scores.min_threshold == min_threshold);
+        
+        for(double t : thresholds){
+            shared_ptr<Context_Callback> F = make_formula(t);
+            F->init(G.bibwt.get(), G.rev_st_bpr->size(), mapper, &wr);
+            iterate_with_callback(it, F.get());
+            assert(scores.get_marks(*G.rev_st_bpr, t) == F->get_result());
+            
+            set_context_marks(G, scores.get_marks(*G.rev_st_bpr, t));
+            G.store_contexts_to_disk("models", "test.contexts");
+            G.load_contexts_from_disk("models", "test.contexts");
+            for(string suffix : {"_counts", "_totals", "_alphabet"}) remove(("models/test.contexts.context_counts" + suffix).c_str()); // See test_context_count_table
+            for(string suffix : {"_info", "_pointers"}) remove(("models/test.contexts.rev_st_lma_pointers" + suffix).c_str());
+            
+            Global_Data G_t;
+            shared_ptr<Context_Callback> F_t = make_formula(t);
+            build_model(G_t, T, *F_t, slt_it, rev_st_it);
+            scorer.use_context_counts(G.context_counts.get());
+            for(string& S : queries) assert(score_string(S, G, scorer, updater) == score_string(S, G_t, scorer, updater));
+            scorer.use_context_counts(nullptr);
+        }
+    }
+}
+
+// Scoring a raw query in chunks in parallel must give exactly the same score as scoring it sequentially
+void test_chunked_scoring(){
+    cerr << "Testing chunked scoring of a raw query" << endl;
+    
+    srand(1313);
+    for(int64_t i = 0; i < 30; i++){
+        int64_t sigma = 2 + rand() % 3;
+        string T = get_random_string(1 + rand() % 1000, sigma);
+        string S = get_random_string(rand() % 3000, sigma);
+        if(rand() % 2) S += T.substr(0, rand() % (T.size() + 1)) + S; // Long matches cross the chunk boundaries
+        bool entropy = rand() % 2;
+        
+        shared_ptr<Context_Callback> formula;
+        if(entropy) formula = make_shared<Entropy_Formula>(0.2);
+        else formula = make_shared<KL_Formula>(0.5);
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rand() % 2;
+        build_model(G, T, *formula, slt_it, rev_st_it, options);
+        Basic_Scorer scorer(0.05, entropy);
+        Maxrep_Pruned_Updater updater;
+        
+        double expected = score_string(S, G, scorer, updater);
+        
+        string path = "models/test_query.raw";
+        ofstream out(path, ios::binary);
+        out << S;
+        out.close();
+        
+        int64_t n_threads = 1 + rand() % 4;
+        int64_t chunk_length = 1 + rand() % 500;
+        int64_t overlap = rand() % 3 == 0 ? 0 : rand() % 100; // No overlap: every chunk needs to be synchronized
+        int64_t n_recorded_states = 1 + rand() % 50;
+        Chunked_Raw_Scorer chunked(G, scorer, updater, n_threads, chunk_length, overlap, n_recorded_states);
+        assert(chunked.score_file(path) == expected);
+    }
+}
+
+// The block readers must give the same characters through getchar and next_block, with and without the memory mapping
+void test_query_readers(){
+    cerr << "Testing query readers" << endl;
+    
+    srand(1414);
+    string path = "models/test_queries.fna";
+    for(int64_t i = 0; i < 200; i++){
+        // Random multi-FASTA with random line breaks, empty lines and CRLF line endings
+        vector<string> expected;
+        string file;
+        int64_t n_queries = (i == 0) ? 2 : rand() % 5;
+        for(int64_t q = 0; q < n_queries; q++){
+            string query = get_random_string(i == 0 ? (3 << 20) : rand() % 200, 4); // The first file is larger than the read buffer
+            expected.push_back(query);
+            file += ">read " + to_string(q) + (rand() % 2 ? "\r\n" : "\n");
+            for(char c : query){
+                file += c;
+                if(rand() % 30 == 0) file += (rand() % 2 ? "\r\n" : "\n");
+            }
+            if(rand() % 5 != 0) file += "\n";
+        }
+        ofstream out(path, ios::binary);
+        out << file;
+        out.close();
+        
+        for(bool map_to_memory : {true, false}){
+            // Whole queries
+            FASTA_reader fr(path, map_to_memory);
+            vector<string> queries;
+            string query;
+            while(fr.get_next_query(query)) queries.push_back(query);
+            if(n_queries == 0) assert(queries.size() <= 1 && (queries.size() == 0 || queries[0] == ""));
+            else assert(queries == expected);
+            
+            // One character at a time
+            FASTA_reader fr2(path, map_to_memory);
+            for(int64_t q = 0; q < n_queries; q++){
+                assert(!fr2.done());
+                Read_stream rs = fr2.get_next_query_stream();
+                string S;
+                char c;
+                while(rs.getchar(c)) S += c;
+                assert(S == expected[q]);
+            }
+            
+        }
+        
+        // Raw query
+        string raw_path = "models/test_query.raw";
+        string raw_query = get_random_string(rand() % 3000, 20);
+        out.open(raw_path, ios::binary);
+        out << raw_query;
+        out.close();
+        for(bool map_to_memory : {true, false}){
+            Raw_file_stream raw(raw_path, map_to_memory);
+            string S;
+            const char* begin; const char* end;
+            while(raw.next_block(begin, end)) S.append(begin, end);
+            assert(S == raw_query);
+            
+            Raw_file_stream raw2(raw_path, map_to_memory);
+            string S2;
+            char c;
+            while(raw2.getchar(c)) S2 += c;
+            assert(S2 == raw_query);
+        }
+    }
+}
+
+// Every element pushed to the queue by many threads must be popped exactly once
+void test_bounded_queue(){
+    cerr << "Testing the bounded queue" << endl;
+    
+    for(int64_t n_threads : {1, 2, 4}){
+        Bounded_Queue<int64_t> queue(1 + n_threads);
+        const int64_t n = 20000;
+        vector<std::thread> producers, consumers;
+        vector<int64_t> sums(n_threads, 0), counts(n_threads, 0);
+        for(int64_t t = 0; t < n_threads; t++){
+            producers.push_back(std::thread([&queue, t, n_threads](){
+                for(int64_t x = t; x < n; x += n_threads) queue.push(x);
+            }));
+            consumers.push_back(std::thread([&queue, &sums, &counts, t](){
+                int64_t x;
+                while(queue.pop(x)){ sums[t] += x; counts[t]++; }
+            }));
+        }
+        for(std::thread& T : producers) T.join();
+        queue.close();
+        for(std::thread& T : consumers) T.join();
+        int64_t sum = 0, count = 0;
+        for(int64_t t = 0; t < n_threads; t++){ sum += sums[t]; count += counts[t]; }
+        assert(count == n && sum == n * (n - 1) / 2);
+    }
+}
+
+// The pipeline must write the same scores in the same order as scoring the queries one by one
+void test_scoring_pipeline(){
+    cerr << "Testing the scoring pipeline" << endl;
+    
+    srand(1515);
+    string path = "models/test_queries.fna";
+    for(int64_t i = 0; i < 20; i++){
+        string T = get_random_string(1 + rand() % 1000, 4);
+        vector<string> queries;
+        int64_t n_queries = 1 + rand() % 300; // An empty file is read as one empty query
+        ofstream out(path);
+        for(int64_t j = 0; j < n_queries; j++){
+            queries.push_back(get_random_string(rand() % 100, 4));
+            out << ">" << j << "\n" << queries.back() << "\n";
+        }
+        out.close();
+        
+        Entropy_Formula formula(0.2);
+        SLT_Iterator slt_it;
+        Rev_ST_Maxrep_Iterator rev_st_it;
+        Global_Data G;
+        Build_Options options;
+        options.run_length_coding = rand() % 2;
+        build_model(G, T, formula, slt_it, rev_st_it, options);
+        Basic_Scorer scorer(0.05, true);
+        Maxrep_Pruned_Updater updater;
+        bool lin = rand() % 2;
+        
+        stringstream expected;
+        for(string& S : queries){
+            Input_Stream is(S);
+            expected << (lin ? score_string_lin(is, G) : score_string(S, G, scorer, updater)) << "\n";
+        }
+        
+        Scoring_Pipeline pipeline(G, scorer, updater, lin, 1 + rand() % 4, 1 + rand() % 20);
+        stringstream result;
+        pipeline.run(path, result);
+        assert(result.str() == expected.str());
+        assert(pipeline.parser_counters.items == n_queries);
+        assert(pipeline.scorer_counters.items == n_queries);
+        assert(pipeline.writer_counters.items == n_queries);
+    }
+}
+
+// The word-level bit vector kernels against bit-by-bit versions
+void test_bit_kernels(){
+    cerr << "Testing word-level bit vector kernels" << endl;
+    
+    srand(1616);
+    for(int64_t i = 0; i < 300; i++){
+        int64_t n = rand() % 1000;
+        int64_t density = 1 + rand() % 10; // Ones in the mask are 1/density of the positions on average
+        sdsl::bit_vector bits(n), mask(n);
+        for(int64_t j = 0; j < n; j++){
+            bits[j] = rand() % 2;
+            mask[j] = (rand() % density == 0);
+        }
+        
+        string expected;
+        for(int64_t j = 0; j < n; j++) if(mask[j]) expected += '0' + bits[j];
+        sdsl::bit_vector compacted = compact_under_mask(bits, mask);
+        string result;
+        for(int64_t j = 0; j < compacted.size(); j++) result += '0' + compacted[j];
+        assert(result == expected);
+        
+        // Counters to BPR
+        Basic_Counters counters;
+        counters.init(1 + rand() % 100);
+        for(int64_t j = 0; j < counters.size(); j++){
+            int64_t opens = rand() % 4 == 0 ? rand() % 200 : rand() % 3;
+            int64_t closes = rand() % 4 == 0 ? rand() % 200 : rand() % 3;
+            for(int64_t k = 0; k < opens; k++) counters.increment_open(j);
+            for(int64_t k = 0; k < closes; k++) counters.increment_close(j);
+        }
+        expected = "";
+        for(int64_t j = 0; j < counters.size(); j++) expected += string(counters.get_open(j), '1') + string(counters.get_close(j), '0');
+        sdsl::bit_vector bpr = counters_to_bpr(counters);
+        result = "";
+        for(int64_t j = 0; j < bpr.size(); j++) result += '0' + bpr[j];
+        assert(result == expected);
+    }
+}
+
 void test_recursive_scoring(){
     cerr << "Testing recursive scoring" << endl;
     srand(1337);
@@ -296,7 +1737,7 @@ void test_recursive_scoring(){
 
             KL_Formula formula(threshold);
             Global_Data G;
-            build_model(G, T, formula, slt_it, rev_st_it, false, false);
+            build_model(G, T, formula, slt_it, rev_st_it);
             Recursive_Scorer scorer(escape, false);
             Maxrep_Pruned_Updater updater;
             double nonbrute = score_string(S, G, scorer, updater);
@@ -311,7 +1752,7 @@ void test_recursive_scoring(){
 
             Entropy_Formula formula(threshold);
             Global_Data G;
-            build_model(G, T, formula, slt_it, rev_st_it, false, false);
+            build_model(G, T, formula, slt_it, rev_st_it);
             Recursive_Scorer scorer(escape, true);
             Maxrep_Pruned_Updater updater;
             double nonbrute = score_string(S, G, scorer, updater);
@@ -348,7 +1789,9 @@ void score_string_random_tests(int64_t number){
             Entropy_Formula formula(threshold,depth_bound);
             
             Global_Data G; 
-            build_model(G, T, formula, slt_it, rev_st_it, true, false);
+            Build_Options options;
+            options.run_length_coding = true;
+            build_model(G, T, formula, slt_it, rev_st_it, options);
                                 
             Basic_Scorer scorer(escape, true);
             Maxrep_Pruned_Updater updater;
@@ -372,7 +1815,9 @@ void score_string_random_tests(int64_t number){
             KL_Formula formula(threshold,depth_bound);
             
             Global_Data G;
-            build_model(G, T, formula, slt_it, rev_st_it, true, false);
+            Build_Options options;
+            options.run_length_coding = true;
+            build_model(G, T, formula, slt_it, rev_st_it, options);
                 
             Basic_Scorer scorer(escape, false);
             Maxrep_Pruned_Updater updater;
@@ -396,7 +1841,9 @@ void score_string_random_tests(int64_t number){
             EQ234_Formula formula(t1,t2,t3,t4);
             
             Global_Data G; 
-            build_model(G, T, formula, slt_it, rev_st_it, true, false);
+            Build_Options options;
+            options.run_length_coding = true;
+            build_model(G, T, formula, slt_it, rev_st_it, options);
 
             Basic_Scorer scorer(escape, false);
             Maxrep_Pruned_Updater updater;
@@ -420,7 +1867,9 @@ void score_string_random_tests(int64_t number){
             KL_Formula formula(threshold);
             
             Global_Data G; 
-            build_model(G, T, formula, slt_it, rev_st_it, true, false);
+            Build_Options options;
+            options.run_length_coding = true;
+            build_model(G, T, formula, slt_it, rev_st_it, options);
 
             Basic_Scorer scorer(escape, false);
             Maxrep_Pruned_Updater updater;
@@ -443,7 +1892,9 @@ void score_string_random_tests(int64_t number){
             pnorm_Formula formula(p,threshold);
             
             Global_Data G;
-            build_model(G, T, formula, slt_it, rev_st_it, true, false);
+            Build_Options options;
+            options.run_length_coding = true;
+            build_model(G, T, formula, slt_it, rev_st_it, options);
 
             Basic_Scorer scorer(escape, false);
             Maxrep_Pruned_Updater updater;
@@ -0,0 +1,176 @@
+#ifndef SCORING_INSTRUMENTATION_HH
+#define SCORING_INSTRUMENTATION_HH
+
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Opt-in counters of the operations of the scoring hot path. The updaters, the scorers, the
+// topologies and the main loops mark their operations with the macros at the end of this file,
+// which compile to nothing unless VOMM_INSTRUMENT is defined (make score_string_instrumented).
+// Every thread counts into its own instance, so the counts of a query are the difference of the
+// counts of the scoring thread before and after it.
+//
+// Every operation is counted, and every SAMPLE_PERIOD-th call of each operation type is timed
+// with the time stamp counter (or in nanoseconds on other than x86). The timings go to a
+// histogram with power-of-two buckets. An escape is a character that was not found after a
+// context. The number of escapes of a character is the depth of the recursion of
+// Recursive_Scorer. The leaves_to_node calls whose interval is inside one leaf of the topology
+// take the cheap path of Pruned_Topology_Mapper_Template, and the rest take a double_enclose.
+class Scoring_Instrumentation{
+
+public:
+
+    enum Operation {BWT_SEARCH, LEAVES_TO_NODE, NODE_TO_LEAVES, PARENT, LMA, STRING_DEPTH, CONTEXT_RANK, N_OPERATIONS};
+
+    static const int64_t SAMPLE_PERIOD = 16; // Power of two
+    static const int64_t N_BUCKETS = 64;
+
+    int64_t calls[N_OPERATIONS];
+    int64_t sampled[N_OPERATIONS];
+    int64_t sampled_ticks[N_OPERATIONS];
+    int64_t ticks_histogram[N_OPERATIONS][N_BUCKETS]; // Bucket k: [2^k, 2^(k+1)) ticks, and 0 ticks in bucket 0
+    int64_t characters;
+    int64_t escapes;
+    int64_t max_escapes; // In one character
+    int64_t escapes_histogram[N_BUCKETS]; // Number of characters by escapes, the last bucket for N_BUCKETS-1 or more
+    int64_t escapes_of_character; // So far in the current character
+    int64_t single_leaf; // leaves_to_node calls where the interval is inside one leaf
+
+    Scoring_Instrumentation() {
+        reset();
+    }
+
+    void reset(){
+        std::fill(calls, calls + N_OPERATIONS, 0);
+        std::fill(sampled, sampled + N_OPERATIONS, 0);
+        std::fill(sampled_ticks, sampled_ticks + N_OPERATIONS, 0);
+        std::fill(&ticks_histogram[0][0], &ticks_histogram[0][0] + N_OPERATIONS * N_BUCKETS, 0);
+        std::fill(escapes_histogram, escapes_histogram + N_BUCKETS, 0);
+        characters = escapes = max_escapes = escapes_of_character = single_leaf = 0;
+    }
+
+    static const char* operation_name(int64_t op){
+        static const char* names[] = {"bwt_search", "leaves_to_node", "node_to_leaves", "parent", "lma", "string_depth", "context_rank"};
+        return names[op];
+    }
+
+    static uint64_t ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    static const char* tick_unit(){
+#if defined(__x86_64__) || defined(__i386__)
+        return "cycles";
+#else
+        return "ns";
+#endif
+    }
+
+    // Counts op and returns f(), timing it if the call is sampled
+    template<typename F>
+    auto timed(Operation op, F f) -> decltype(f()){
+        if((calls[op]++ & (SAMPLE_PERIOD - 1)) != 0) return f();
+        uint64_t start = ticks();
+        auto result = f();
+        int64_t t = ticks() - start;
+        sampled[op]++;
+        sampled_ticks[op] += t;
+        ticks_histogram[op][t <= 0 ? 0 : 63 - __builtin_clzll(t)]++;
+        return result;
+    }
+
+    void escape(){
+        escapes++;
+        escapes_of_character++;
+    }
+
+    void end_character(){
+        characters++;
+        max_escapes = std::max(max_escapes, escapes_of_character);
+        escapes_histogram[std::min(escapes_of_character, N_BUCKETS - 1)]++;
+        escapes_of_character = 0;
+    }
+
+    void single_leaf_mapping(){
+        single_leaf++;
+    }
+
+    Scoring_Instrumentation& operator+=(const Scoring_Instrumentation& other){
+        for(int64_t op = 0; op < N_OPERATIONS; op++){
+            calls[op] += other.calls[op];
+            sampled[op] += other.sampled[op];
+            sampled_ticks[op] += other.sampled_ticks[op];
+            for(int64_t k = 0; k < N_BUCKETS; k++) ticks_histogram[op][k] += other.ticks_histogram[op][k];
+        }
+        for(int64_t k = 0; k < N_BUCKETS; k++) escapes_histogram[k] += other.escapes_histogram[k];
+        characters += other.characters;
+        escapes += other.escapes;
+        max_escapes = std::max(max_escapes, other.max_escapes);
+        single_leaf += other.single_leaf;
+        return *this;
+    }
+
+    // One line. The histograms are cut after their last nonzero bucket.
+    std::string to_json() const{
+        std::stringstream ss;
+        ss << "{\"characters\": " << characters << ", \"escapes\": " << escapes << ", \"max_escapes_per_character\": " << max_escapes
+           << ", \"escapes_per_character_histogram\": " << histogram_to_json(escapes_histogram)
+           << ", \"leaves_to_node_single_leaf\": " << single_leaf
+           << ", \"tick_unit\": \"" << tick_unit() << "\", \"sample_period\": " << SAMPLE_PERIOD << ", \"operations\": {";
+        for(int64_t op = 0; op < N_OPERATIONS; op++){
+            if(op > 0) ss << ", ";
+            ss << "\"" << operation_name(op) << "\": {\"calls\": " << calls[op]
+               << ", \"calls_per_character\": " << (characters == 0 ? 0.0 : (double)calls[op] / characters)
+               << ", \"sampled\": " << sampled[op]
+               << ", \"mean_ticks\": " << (sampled[op] == 0 ? 0.0 : (double)sampled_ticks[op] / sampled[op])
+               << ", \"estimated_total_ticks\": " << (sampled[op] == 0 ? 0.0 : (double)sampled_ticks[op] / sampled[op] * calls[op])
+               << ", \"ticks_log2_histogram\": " << histogram_to_json(ticks_histogram[op]) << "}";
+        }
+        ss << "}}";
+        return ss.str();
+    }
+
+    // The instance of the calling thread
+    static Scoring_Instrumentation& local(){
+        static thread_local Scoring_Instrumentation instance;
+        return instance;
+    }
+
+private:
+
+    static std::string histogram_to_json(const int64_t* histogram){
+        int64_t end = N_BUCKETS;
+        while(end > 0 && histogram[end-1] == 0) end--;
+        std::stringstream ss;
+        ss << "[";
+        for(int64_t k = 0; k < end; k++) ss << (k > 0 ? ", " : "") << histogram[k];
+        ss << "]";
+        return ss.str();
+    }
+};
+
+#ifdef VOMM_INSTRUMENT
+const bool SCORING_INSTRUMENTATION_ENABLED = true;
+#define INSTRUMENTED(op, expr) Scoring_Instrumentation::local().timed(Scoring_Instrumentation::op, [&](){ return (expr); })
+#define INSTRUMENT_ESCAPE() Scoring_Instrumentation::local().escape()
+#define INSTRUMENT_END_CHARACTER() Scoring_Instrumentation::local().end_character()
+#define INSTRUMENT_SINGLE_LEAF() Scoring_Instrumentation::local().single_leaf_mapping()
+#else
+const bool SCORING_INSTRUMENTATION_ENABLED = false;
+#define INSTRUMENTED(op, expr) (expr)
+#define INSTRUMENT_ESCAPE()
+#define INSTRUMENT_END_CHARACTER()
+#define INSTRUMENT_SINGLE_LEAF()
+#endif
+
+#endif
@@ -434,6 +434,28 @@ class int_vector
             return m_data;
         }
 
+        //! Points the int_vector to words that it does not own, for example in a read-only memory mapping.
+        /*! \param data         The words. They must stay valid while the int_vector uses them.
+            \param size_in_bits Number of bits in the int_vector.
+            \param int_width    The width of each integer.
+            \pre The int_vector must be detached with detach() before it is destroyed,
+                 resized or assigned to, so that it does not free the words.
+         */
+        void attach(const uint64_t* data, size_type size_in_bits, uint8_t int_width = t_width)
+        {
+            memory_manager::clear(*this);
+            m_data = const_cast<uint64_t*>(data);
+            m_size = size_in_bits;
+            width(int_width);
+        }
+
+        //! Forgets the words given to attach(). The int_vector is empty afterwards.
+        void detach()
+        {
+            m_data = nullptr;
+            m_size = 0;
+        }
+
         //! Get the integer value of the binary string of length len starting at position idx in the int_vector.
         /*! \param idx Starting index of the binary representation of the integer.
             \param len Length of the binary representation of the integer. Default value is 64.
@@ -0,0 +1,153 @@
+#ifndef SEMI_EXTERNAL_BWT_HH
+#define SEMI_EXTERNAL_BWT_HH
+
+#include "BD_BWT_index/include/BD_BWT_index.hh"
+#include "sdsl/construct.hpp"
+#include "sdsl/int_vector_buffer.hpp"
+#include "logging.hh"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+// Semi-external construction of the BiBWT for references that do not fit in memory together
+// with the in-memory construction. The text and its reverse are written to scratch files, their
+// suffix arrays are built on disk with the semi-external SA-IS of sdsl, and the BWTs are streamed
+// from the suffix arrays to the wavelet trees. The largest things in memory are one copy of the
+// text while the BWT is streamed, and the wavelet tree under construction. The result is the same
+// index as BD_BWT_index(const uint8_t*) gives.
+
+// Writes the text into a scratch file that is given to build_bibwt_semi_external. Can be used as
+// the sink of Reference_Reader.
+class Text_File_Writer{
+
+private:
+
+    Text_File_Writer(const Text_File_Writer&); // Prevent copy-construction
+    Text_File_Writer& operator=(const Text_File_Writer&);  // Prevent assignment
+
+    sdsl::int_vector_buffer<8> buf;
+
+public:
+
+    Text_File_Writer(std::string path) : buf(path, std::ios::out) {}
+
+    void push_back(char c){
+        uint8_t x = c;
+        if(x == 0 || x == BD_BWT_index<>::END)
+            throw std::runtime_error("Input string contains forbidden byte " + std::to_string(x));
+        buf.push_back(x);
+    }
+
+    void append(const char* s, size_t n){
+        for(size_t i = 0; i < n; i++) push_back(s[i]);
+    }
+
+    int64_t size(){
+        return buf.size();
+    }
+
+    void close(){
+        buf.close();
+    }
+};
+
+// Writes the reverse of the text in text_path to reverse_path
+void write_reverse_text(std::string text_path, std::string reverse_path){
+    sdsl::int_vector_buffer<8> text(text_path, std::ios::in);
+    sdsl::int_vector_buffer<8> reverse(reverse_path, std::ios::out);
+    for(int64_t i = (int64_t)text.size() - 1; i >= 0; i--) reverse.push_back(text[i]);
+}
+
+// Builds the BWT of the text in text_path followed by END and writes it to bwt_path as plain
+// bytes. Adds the counts of the symbols in the BWT to counts. Deletes the text file.
+void build_bwt_semi_external(std::string text_path, std::string scratch_dir, std::string bwt_path, std::vector<int64_t>& counts){
+    {
+        // The suffix array construction of sdsl needs a zero byte at the end, which takes the place of END
+        sdsl::int_vector_buffer<8> text(text_path, std::ios::in | std::ios::out);
+        text.push_back(0);
+    }
+
+    sdsl::cache_config config(true, scratch_dir, sdsl::util::to_string(sdsl::util::pid()) + "_" + sdsl::util::to_string(sdsl::util::id()));
+    config.file_map[sdsl::conf::KEY_TEXT] = text_path;
+
+    sdsl::construct_sa_se(config);
+
+    sdsl::construct_bwt<8>(config);
+
+    {
+        sdsl::int_vector_buffer<8> bwt(sdsl::cache_file_name(sdsl::conf::KEY_BWT, config), std::ios::in);
+        std::ofstream out(bwt_path, std::ios::binary);
+        std::vector<char> block;
+        for(int64_t i = 0; i < (int64_t)bwt.size(); i++){
+            uint8_t c = bwt[i];
+            if(c == 0) c = BD_BWT_index<>::END;
+            counts[c]++;
+            block.push_back(c);
+            if(block.size() == (1 << 20) || i == (int64_t)bwt.size() - 1){
+                out.write(block.data(), block.size());
+                block.clear();
+            }
+        }
+        if(!out.good()) throw std::runtime_error("Error writing to disk: " + bwt_path);
+    }
+
+    sdsl::util::delete_all_files(config.file_map); // Also the text
+}
+
+// Builds the wavelet tree of the BWT in bwt_path in the same way as BD_BWT_index and stores it
+// to wt_path. Deletes the BWT file.
+void build_bwt_wavelet_tree(std::string bwt_path, std::string wt_path){
+    sdsl::wt_hutu<sdsl::bit_vector> wt;
+    sdsl::construct(wt, bwt_path, 1);
+    if(!sdsl::store_to_file(wt, wt_path)) throw std::runtime_error("Error writing to disk: " + wt_path);
+    std::remove(bwt_path.c_str());
+}
+
+// Builds the BiBWT of the text that was written to text_path with Text_File_Writer, using
+// scratch_dir for temporary files. Deletes the text file.
+void build_bibwt_semi_external(BD_BWT_index<>& index, std::string text_path, std::string scratch_dir){
+    std::string prefix = "vomm_scratch_" + sdsl::util::to_string(sdsl::util::pid()) + "_" + sdsl::util::to_string(sdsl::util::id());
+    std::string path = scratch_dir + "/" + prefix;
+
+    {
+        sdsl::int_vector_buffer<8> text(text_path, std::ios::in);
+        if(text.size() == 0) throw std::runtime_error("Tried to construct BD_BWT_index for an empty string");
+    }
+
+    write_log("Writing the reverse text to scratch space");
+    write_reverse_text(text_path, path + "_reverse_text");
+
+    std::vector<int64_t> counts(256, 0);
+    write_log("Building the forward BWT in scratch space");
+    build_bwt_semi_external(text_path, scratch_dir, path + "_forward_bwt_plain", counts);
+    build_bwt_wavelet_tree(path + "_forward_bwt_plain", path + "_forward_bwt.dat");
+
+    write_log("Building the reverse BWT in scratch space");
+    std::vector<int64_t> reverse_counts(256, 0); // Same as counts
+    build_bwt_semi_external(path + "_reverse_text", scratch_dir, path + "_reverse_bwt_plain", reverse_counts);
+    build_bwt_wavelet_tree(path + "_reverse_bwt_plain", path + "_reverse_bwt.dat");
+
+    // Alphabet and the global C-array like in BD_BWT_index
+    sdsl::int_vector<64> global_c_array(256, 0);
+    std::vector<uint8_t> alphabet;
+    int64_t cumulative = 0;
+    for(int64_t c = 0; c < 256; c++){
+        if(counts[c] == 0) continue;
+        alphabet.push_back(c);
+        global_c_array[c] = cumulative;
+        cumulative += counts[c];
+    }
+    sdsl::int_vector<8> alphabet_sdsl(alphabet.size());
+    for(int64_t i = 0; i < (int64_t)alphabet.size(); i++) alphabet_sdsl[i] = alphabet[i];
+    if(!sdsl::store_to_file(global_c_array, path + "_gca.dat") || !sdsl::store_to_file(alphabet_sdsl, path + "_alphabet.dat"))
+        throw std::runtime_error("Error writing to disk: " + path);
+
+    index.load_from_disk(scratch_dir, prefix);
+
+    for(std::string suffix : {"_forward_bwt.dat", "_reverse_bwt.dat", "_gca.dat", "_alphabet.dat"})
+        std::remove((path + suffix).c_str());
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef STATIC_SCORING_HH
+#define STATIC_SCORING_HH
+
+#include "score_string.hh"
+#include "batch_scoring.hh"
+#include "input_reading.hh"
+#include "globals.hh"
+#include "Interfaces.hh"
+#include <memory>
+#include <vector>
+#include <string>
+
+// Scoring without virtual calls in the main loop. main_loop goes through the abstract
+// Scoring_Function, Loop_Invariant_Updater, Topology, BWT and Bitvector classes, so every
+// character costs many virtual calls that can not be inlined. Static_Scoring_Engine is a
+// template on the concrete scorer, updater, BWT and topology bit vector types, which are all final,
+// so the compiler sees through every call. make_scoring_engine checks the dynamic types of the
+// model once and picks the matching instantiation. Models with other types fall back to the
+// virtual main loop. The scores are identical either way.
+//
+// The string depth support stays behind its interface, because it is called rarely compared
+// to the other structures, and templating on it too would triple the number of instantiations.
+
+class Scoring_Engine{
+public:
+    virtual double score(Input_Stream& S) = 0;
+    virtual double score(Raw_file_stream& S) = 0;
+    virtual double score(Read_stream& S) = 0;
+
+    // Scores queries[begin..end) into results[begin..end)
+    virtual void score_batch(const vector<string>& queries, int64_t begin, int64_t end, vector<double>& results) = 0;
+
+    // Continues from state over the n characters of S and writes the log-probability of S[i] to logprobs[i]
+    virtual void score_range(const char* S, int64_t n, Main_Loop_State& state, double* logprobs) = 0;
+
+    virtual ~Scoring_Engine() {} // https://stackoverflow.com/questions/8764353/what-does-has-virtual-method-but-non-virtual-destructor-warning-mean-durin
+};
+
+// The same operations as Topology_Algorithms, without virtual calls except for the string depth.
+// bpr_t is the type of rev_st_bpr and rev_st_bpr_context_only, and pruning_t the type of the
+// pruning marks. The maximal marks and the context marks are Basic_bitvectors.
+template<typename bpr_t, typename pruning_t>
+class Static_Topology{
+
+public:
+
+    typedef int64_t node_t;
+
+    std::shared_ptr<Basic_bitvector> rev_st_maximal_marks;
+    Pruned_Topology_Mapper_Template<bpr_t, pruning_t> mapper;
+    Parent_Support_Template<bpr_t> PS;
+    LMA_Support_Template<Basic_bitvector, bpr_t> LMAS;
+    std::shared_ptr<String_Depth_Support> SDS;
+
+    // The types must have been checked with has_static_topology
+    Static_Topology(Global_Data& G) :
+        rev_st_maximal_marks(std::static_pointer_cast<Basic_bitvector>(G.rev_st_maximal_marks)),
+        mapper(std::static_pointer_cast<bpr_t>(G.rev_st_bpr), std::static_pointer_cast<pruning_t>(G.pruning_marks)),
+        PS(std::static_pointer_cast<bpr_t>(G.rev_st_bpr)),
+        LMAS(std::static_pointer_cast<Basic_bitvector>(G.rev_st_context_marks), std::static_pointer_cast<bpr_t>(G.rev_st_bpr_context_only), G.rev_st_lma_pointers) {
+
+        // String_Depth_Support_SLT_Template stores rev_st_bpr with the type of the maximal marks but
+        // does not use it, so it is null if the BPR is of another type
+        std::shared_ptr<Basic_bitvector> rev_st_bpr = std::dynamic_pointer_cast<Basic_bitvector>(G.rev_st_bpr);
+        if(!G.have_slt())
+            SDS = make_shared<String_Depth_Support_Store_All_Template<Basic_bitvector>>(G.string_depths, rev_st_maximal_marks);
+        else if(dynamic_cast<Basic_bitvector*>(G.slt_bpr.get()) && dynamic_cast<Basic_bitvector*>(G.slt_maximal_marks.get()))
+            SDS = make_shared<String_Depth_Support_SLT_Template<Basic_bitvector, Basic_bitvector>>(rev_st_bpr,
+                    std::static_pointer_cast<Basic_bitvector>(G.slt_bpr), rev_st_maximal_marks, std::static_pointer_cast<Basic_bitvector>(G.slt_maximal_marks));
+        else if(dynamic_cast<RLE_bitvector*>(G.slt_bpr.get()) && dynamic_cast<RLE_bitvector*>(G.slt_maximal_marks.get()))
+            SDS = make_shared<String_Depth_Support_SLT_Template<Basic_bitvector, RLE_bitvector>>(rev_st_bpr,
+                    std::static_pointer_cast<RLE_bitvector>(G.slt_bpr), rev_st_maximal_marks, std::static_pointer_cast<RLE_bitvector>(G.slt_maximal_marks));
+        else
+            SDS = make_shared<String_Depth_Support_SLT>(G.rev_st_bpr, G.slt_bpr, G.rev_st_maximal_marks, G.slt_maximal_marks);
+    }
+
+    int64_t rev_st_string_depth(node_t node){
+        return INSTRUMENTED(STRING_DEPTH, SDS->string_depth(node));
+    }
+
+    node_t rev_st_parent(node_t node){
+        return INSTRUMENTED(PARENT, PS.parent(node));
+    }
+
+    node_t rev_st_lma(node_t node){
+        return INSTRUMENTED(LMA, LMAS.LMA(node));
+    }
+
+    bool rev_st_is_maxrep(node_t node){
+        return rev_st_maximal_marks->at(node);
+    }
+
+    int64_t rev_st_context_rank(node_t node){
+        return INSTRUMENTED(CONTEXT_RANK, LMAS.marked_preorder_rank(node));
+    }
+
+    node_t leaves_to_node(Interval I){
+        return INSTRUMENTED(LEAVES_TO_NODE, mapper.leaves_to_node(I));
+    }
+
+    Interval node_to_leaves(node_t node){
+        return INSTRUMENTED(NODE_TO_LEAVES, mapper.node_to_leaves(node));
+    }
+};
+
+// Whether both BPRs of the reverse suffix tree are of type bpr_t
+template<typename bpr_t>
+bool has_bprs_of_type(Global_Data& G){
+    return dynamic_cast<bpr_t*>(G.rev_st_bpr.get()) && dynamic_cast<bpr_t*>(G.rev_st_bpr_context_only.get());
+}
+
+// Whether the bit vectors of the reverse suffix tree other than the pruning marks are of the types that Static_Topology expects
+bool has_static_topology(Global_Data& G){
+    for(Bitvector* v : {G.rev_st_maximal_marks.get(), G.rev_st_context_marks.get()})
+        if(dynamic_cast<Basic_bitvector*>(v) == nullptr) return false;
+    return has_bprs_of_type<Basic_bitvector>(G) || has_bprs_of_type<Compact_BPR_bitvector>(G);
+}
+
+// topology_t is a Static_Topology
+template<typename bwt_t, typename topology_t, typename scorer_t, typename updater_t>
+class Static_Scoring_Engine : public Scoring_Engine{
+
+private:
+
+    Static_Scoring_Engine(const Static_Scoring_Engine&); // Prevent copy-construction
+    Static_Scoring_Engine& operator=(const Static_Scoring_Engine&);  // Prevent assignment
+
+    Global_Data& G;
+    bwt_t& index;
+    topology_t topology;
+    scorer_t& scorer;
+    updater_t& updater;
+
+    // The same as main_loop_step
+    inline double step(Main_Loop_State& state, char c){
+        int64_t node = topology.leaves_to_node(state.I);
+        state.node = node;
+
+        double logprob = scorer.score_impl(node, state.string_depth, c, topology, index);
+        state.logprob += logprob;
+
+        pair<Interval, int64_t> new_values = updater.update_impl(state.I, node, state.string_depth, c, topology, index);
+        state.I = new_values.first;
+        state.string_depth = new_values.second;
+        INSTRUMENT_END_CHARACTER();
+        return logprob;
+    }
+
+    template<typename input_stream_t>
+    double score_stream(input_stream_t& S){
+        Main_Loop_State state(G);
+        const char* begin; const char* end;
+        while(S.next_block(begin, end))
+            for(const char* p = begin; p != end; p++) step(state, *p);
+        return state.logprob;
+    }
+
+public:
+
+    Static_Scoring_Engine(Global_Data& G, bwt_t& index, scorer_t& scorer, updater_t& updater)
+        : G(G), index(index), topology(G), scorer(scorer), updater(updater) {}
+
+    double score(Input_Stream& S){ return score_stream(S); }
+    double score(Raw_file_stream& S){ return score_stream(S); }
+    double score(Read_stream& S){ return score_stream(S); }
+
+    void score_batch(const vector<string>& queries, int64_t begin, int64_t end, vector<double>& results){
+        for(int64_t i = begin; i < end; i++){
+            Main_Loop_State state(G);
+            for(char c : queries[i]) step(state, c);
+            results[i] = state.logprob;
+        }
+    }
+
+    void score_range(const char* S, int64_t n, Main_Loop_State& state, double* logprobs){
+        for(int64_t i = 0; i < n; i++) logprobs[i] = step(state, S[i]);
+    }
+};
+
+// The virtual main loop, for models that have no static instantiation
+class Virtual_Scoring_Engine : public Scoring_Engine{
+
+private:
+
+    Virtual_Scoring_Engine(const Virtual_Scoring_Engine&); // Prevent copy-construction
+    Virtual_Scoring_Engine& operator=(const Virtual_Scoring_Engine&);  // Prevent assignment
+
+    Global_Data& G;
+    Topology_Supports supports;
+    Scoring_Function& scorer;
+    Loop_Invariant_Updater& updater;
+
+public:
+
+    Virtual_Scoring_Engine(Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater)
+        : G(G), supports(G), scorer(scorer), updater(updater) {}
+
+    double score(Input_Stream& S){ return score_string(S, G, supports, scorer, updater); }
+    double score(Raw_file_stream& S){ return score_string(S, G, supports, scorer, updater); }
+    double score(Read_stream& S){ return score_string(S, G, supports, scorer, updater); }
+
+    void score_batch(const vector<string>& queries, int64_t begin, int64_t end, vector<double>& results){
+        score_strings_batched(queries, begin, end, results, G, *supports.topology, scorer, updater);
+    }
+
+    void score_range(const char* S, int64_t n, Main_Loop_State& state, double* logprobs){
+        for(int64_t i = 0; i < n; i++) logprobs[i] = main_loop_step(state, S[i], G, *supports.topology, scorer, updater);
+    }
+};
+
+// Dispatch on one type at a time. Each function returns nullptr if no type matches.
+
+template<typename bwt_t, typename topology_t, typename scorer_t>
+std::shared_ptr<Scoring_Engine> make_static_engine_for_updater(Global_Data& G, bwt_t& index, scorer_t& scorer, Loop_Invariant_Updater& updater){
+    if(Basic_Updater* U = dynamic_cast<Basic_Updater*>(&updater))
+        return make_shared<Static_Scoring_Engine<bwt_t, topology_t, scorer_t, Basic_Updater>>(G, index, scorer, *U);
+    if(Maxrep_Pruned_Updater* U = dynamic_cast<Maxrep_Pruned_Updater*>(&updater))
+        return make_shared<Static_Scoring_Engine<bwt_t, topology_t, scorer_t, Maxrep_Pruned_Updater>>(G, index, scorer, *U);
+    return nullptr;
+}
+
+template<typename bwt_t, typename topology_t>
+std::shared_ptr<Scoring_Engine> make_static_engine_for_scorer(Global_Data& G, bwt_t& index, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    if(Basic_Scorer* S = dynamic_cast<Basic_Scorer*>(&scorer))
+        return make_static_engine_for_updater<bwt_t, topology_t>(G, index, *S, updater);
+    if(Recursive_Scorer* S = dynamic_cast<Recursive_Scorer*>(&scorer))
+        return make_static_engine_for_updater<bwt_t, topology_t>(G, index, *S, updater);
+    return nullptr;
+}
+
+template<typename bwt_t, typename bpr_t>
+std::shared_ptr<Scoring_Engine> make_static_engine_for_pruning(Global_Data& G, bwt_t& index, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    Bitvector* pruning_marks = G.pruning_marks.get();
+    if(dynamic_cast<All_Ones_Bitvector*>(pruning_marks))
+        return make_static_engine_for_scorer<bwt_t, Static_Topology<bpr_t, All_Ones_Bitvector>>(G, index, scorer, updater);
+    if(dynamic_cast<Basic_bitvector*>(pruning_marks))
+        return make_static_engine_for_scorer<bwt_t, Static_Topology<bpr_t, Basic_bitvector>>(G, index, scorer, updater);
+    if(dynamic_cast<RLE_bitvector*>(pruning_marks))
+        return make_static_engine_for_scorer<bwt_t, Static_Topology<bpr_t, RLE_bitvector>>(G, index, scorer, updater);
+    return nullptr;
+}
+
+template<typename bwt_t>
+std::shared_ptr<Scoring_Engine> make_static_engine_for_bprs(Global_Data& G, bwt_t& index, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    if(has_bprs_of_type<Basic_bitvector>(G))
+        return make_static_engine_for_pruning<bwt_t, Basic_bitvector>(G, index, scorer, updater);
+    if(has_bprs_of_type<Compact_BPR_bitvector>(G))
+        return make_static_engine_for_pruning<bwt_t, Compact_BPR_bitvector>(G, index, scorer, updater);
+    return nullptr;
+}
+
+// Returns an engine for scoring queries against the model in G on one thread. The engine keeps
+// references to G, scorer and updater.
+std::shared_ptr<Scoring_Engine> make_scoring_engine(Global_Data& G, Scoring_Function& scorer, Loop_Invariant_Updater& updater){
+    std::shared_ptr<Scoring_Engine> engine;
+    if(has_static_topology(G)){
+        BWT* index = G.revbwt.get();
+        if(Basic_BWT<>* B = dynamic_cast<Basic_BWT<>*>(index)) engine = make_static_engine_for_bprs(G, *B, scorer, updater);
+        else if(RLEBWT<>* B = dynamic_cast<RLEBWT<>*>(index)) engine = make_static_engine_for_bprs(G, *B, scorer, updater);
+        else if(Interleaved_BWT* B = dynamic_cast<Interleaved_BWT*>(index)) engine = make_static_engine_for_bprs(G, *B, scorer, updater);
+    }
+    if(engine == nullptr) engine = make_shared<Virtual_Scoring_Engine>(G, scorer, updater);
+    return engine;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SYNTHETIC_INPUTS_HH
+#define SYNTHETIC_INPUTS_HH
+
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+
+// Synthetic inputs for the benchmarks. The generators use only the raw output of the Mersenne
+// twister, so that the same seed gives the same input with every standard library.
+
+// In [0,1)
+double uniform(std::mt19937_64& rng){
+    return (rng() >> 11) / 9007199254740992.0; // 2^53
+}
+
+// Appends to S a copy of an earlier substring of S of length [min_length, max_length], changing
+// each character with the given probability
+void append_mutated_copy(std::string& S, const std::string& alphabet, double mutation_rate, int64_t min_length, int64_t max_length, std::mt19937_64& rng){
+    int64_t length = std::min((int64_t)S.size(), min_length + (int64_t)(rng() % (max_length - min_length + 1)));
+    int64_t start = rng() % (S.size() - length + 1);
+    for(int64_t i = 0; i < length; i++){
+        char c = S[start + i];
+        if(uniform(rng) < mutation_rate) c = alphabet[rng() % alphabet.size()];
+        S += c;
+    }
+}
+
+// Random segments and mutated copies of earlier segments, like a genome with repeats
+std::string generate_dna(int64_t n, std::mt19937_64& rng){
+    std::string alphabet = "ACGT";
+    std::string S;
+    while((int64_t)S.size() < n){
+        if(S.size() > 10000 && rng() % 2 == 0) append_mutated_copy(S, alphabet, 0.01, 50, 2000, rng);
+        else{
+            int64_t length = 50 + rng() % 1951;
+            for(int64_t i = 0; i < length; i++) S += alphabet[rng() % 4];
+        }
+    }
+    S.resize(n);
+    return S;
+}
+
+// Amino acids with their background frequencies, and mutated copies of earlier segments like
+// the domains of a protein family
+std::string generate_protein(int64_t n, std::mt19937_64& rng){
+    std::string alphabet = "ARNDCQEGHILKMFPSTWYV";
+    double frequencies[] = {8.25, 5.53, 4.06, 5.45, 1.37, 3.93, 6.75, 7.07, 2.27, 5.96, 9.66, 5.84, 2.42, 3.86, 4.70, 6.56, 5.34, 1.08, 2.92, 6.87};
+    std::vector<double> cumulative;
+    double total = 0;
+    for(double f : frequencies) cumulative.push_back(total += f);
+
+    std::string S;
+    while((int64_t)S.size() < n){
+        if(S.size() > 10000 && rng() % 10 < 3) append_mutated_copy(S, alphabet, 0.05, 50, 500, rng);
+        else{
+            int64_t length = 50 + rng() % 451;
+            for(int64_t i = 0; i < length; i++){
+                double x = uniform(rng) * total;
+                S += alphabet[std::lower_bound(cumulative.begin(), cumulative.end(), x) - cumulative.begin()];
+            }
+        }
+    }
+    S.resize(n);
+    return S;
+}
+
+// Words from a random vocabulary drawn from a Zipf distribution, in sentences
+std::string generate_text(int64_t n, std::mt19937_64& rng){
+    std::string letters = "abcdefghijklmnopqrstuvwxyz";
+    int64_t vocabulary_size = 10000;
+    std::vector<std::string> vocabulary;
+    std::vector<double> cumulative;
+    double total = 0;
+    for(int64_t i = 0; i < vocabulary_size; i++){
+        std::string word;
+        int64_t length = 1 + rng() % 4;
+        length += rng() % 6;
+        for(int64_t j = 0; j < length; j++) word += letters[rng() % letters.size()];
+        vocabulary.push_back(word);
+        cumulative.push_back(total += 1.0 / (i + 1));
+    }
+
+    std::string S;
+    while((int64_t)S.size() < n){
+        int64_t sentence_length = 5 + rng() % 20;
+        for(int64_t i = 0; i < sentence_length; i++){
+            double x = uniform(rng) * total;
+            S += vocabulary[std::lower_bound(cumulative.begin(), cumulative.end(), x) - cumulative.begin()];
+            S += (i == sentence_length - 1) ? ". " : " ";
+        }
+    }
+    S.resize(n);
+    return S;
+}
+
+// The generator of the given name (dna, protein or text), or an empty string for other names
+std::string generate_input(const std::string& name, int64_t n, std::mt19937_64& rng){
+    if(name == "dna") return generate_dna(n, rng);
+    if(name == "protein") return generate_protein(n, rng);
+    if(name == "text") return generate_text(n, rng);
+    return "";
+}
+
+#endif
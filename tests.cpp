@@ -22,6 +22,7 @@ int main(int argc, char** argv){
     String_Depth_Support_tests();
     test_precomputed_depths();
     test_serialization();
+    test_corrupt_models();
     test_recursive_scoring();
     test_mark_contexts_entropy_all();
     test_mark_contexts_p_norm_all();
@@ -33,6 +34,30 @@ int main(int argc, char** argv){
     test_maxrep_depth_bounded_rev_st_bpr_building();
     Maxreps_tests();
     test_RLE();
+    test_RLE_bitvector();
+    test_compact_BPR_bitvector();
+    test_interleaved_bwt();
+    test_parallel_scoring();
+    test_batched_scoring();
+    test_parallel_build();
+    test_fused_build();
+    test_reference_reading();
+    test_semi_external_bibwt();
+    test_score_server();
+    test_score_server_connections();
+    test_model_profiles();
+    test_per_position_output();
+    test_static_scoring();
+    test_context_count_table();
+    test_lma_pointer_table();
+    test_leaves_to_node();
+    test_scoring_instrumentation();
+    test_context_sweep();
+    test_chunked_scoring();
+    test_query_readers();
+    test_bounded_queue();
+    test_scoring_pipeline();
+    test_bit_kernels();
     LMA_Support_Tests();
     MS_Enumerator_tests();
     Parent_Support_Tests();